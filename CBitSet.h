@@ -0,0 +1,74 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <vtkType.h>
+
+// *****
+// Dynamic bitset over the ids [0, Size()), one bit per id.
+// *****
+class CBitSet
+{
+public:
+	CBitSet()
+		: m_size(0)
+	{
+	}
+
+	void Resize(vtkIdType n)
+	{
+		m_size = n;
+		m_words.resize(static_cast<std::size_t>((n + 63) / 64), 0);
+	}
+
+	vtkIdType Size() const
+	{
+		return m_size;
+	}
+
+	void Clear()
+	{
+		std::fill(m_words.begin(), m_words.end(), 0);
+	}
+
+	void Set(vtkIdType id)
+	{
+		m_words[id >> 6] |= Bit(id);
+	}
+
+	void Reset(vtkIdType id)
+	{
+		m_words[id >> 6] &= ~Bit(id);
+	}
+
+	bool Test(vtkIdType id) const
+	{
+		return (m_words[id >> 6] & Bit(id)) != 0;
+	}
+
+	// return true if id was not set yet
+	bool TestAndSet(vtkIdType id)
+	{
+		std::uint64_t& word = m_words[id >> 6];
+		const std::uint64_t bit = Bit(id);
+		if(word & bit)
+			return false;
+		word |= bit;
+		return true;
+	}
+
+	std::size_t MemorySize() const
+	{
+		return m_words.capacity() * sizeof(std::uint64_t);
+	}
+
+private:
+	static std::uint64_t Bit(vtkIdType id)
+	{
+		return std::uint64_t(1) << (id & 63);
+	}
+
+private:
+	std::vector<std::uint64_t> m_words;
+	vtkIdType m_size;
+};
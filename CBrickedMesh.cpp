@@ -0,0 +1,1085 @@
+#include "CBrickedMesh.h"
+#include "CMappedFile.h"
+#include "CContourChainer.h"
+#include "CStlReader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+#include <vtkPolyData.h>
+#include <vtkPoints.h>
+#include <vtkFloatArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkCellArray.h>
+#include <vtkIdList.h>
+#include <vtkSMPTools.h>
+
+namespace
+{
+const std::uint64_t StlHeaderSize = 84;
+const std::uint64_t StlRecordSize = 50;
+const vtkIdType NumStripes = 64;//contiguous triangle ranges scanned in parallel, merged in order
+const int CoarseGrid = 16;//per axis, finds the halo candidates of a triangle
+const std::uint64_t BytesPerTriangle = 96;//gathered id, welded points and connectivity of an owned or halo triangle
+const std::uint32_t NoBrick = std::numeric_limits<std::uint32_t>::max();
+const char* HeaderSection = "header";
+const char* BricksSection = "bricks";
+static_assert(sizeof(CBrickedMesh::Header) == 64, "the header layout is part of the file format");
+static_assert(sizeof(CBrickedMesh::BrickInfo) == 120, "the brick layout is part of the file format");
+
+// the nine coordinates of a STL record, -0 becomes 0 so that the bits identify a vertex
+void recordVertices(const char* records, std::uint64_t triangle, float v[9])
+{
+	std::memcpy(v, records + StlRecordSize * triangle + 12, 9 * sizeof(float));
+	for(int j = 0; j < 9; ++j)
+		v[j] = v[j] == 0.0f ? 0.0f : v[j];
+}
+
+void emptyBounds(double bounds[6])
+{
+	for(int j = 0; j < 3; ++j)
+	{
+		bounds[2*j] = std::numeric_limits<double>::max();
+		bounds[2*j+1] = -std::numeric_limits<double>::max();
+	}
+}
+
+void addToBounds(const float* x, double bounds[6])
+{
+	for(int j = 0; j < 3; ++j)
+	{
+		bounds[2*j] = std::min(bounds[2*j], static_cast<double>(x[j]));
+		bounds[2*j+1] = std::max(bounds[2*j+1], static_cast<double>(x[j]));
+	}
+}
+
+void mergeBounds(const double other[6], double bounds[6])
+{
+	for(int j = 0; j < 3; ++j)
+	{
+		bounds[2*j] = std::min(bounds[2*j], other[2*j]);
+		bounds[2*j+1] = std::max(bounds[2*j+1], other[2*j+1]);
+	}
+}
+
+// closed intervals, a triangle touching the owned bounds by a single vertex is a halo triangle
+bool boundsIntersect(const double a[6], const double b[6])
+{
+	for(int j = 0; j < 3; ++j)
+	{
+		if(a[2*j] > b[2*j+1] || b[2*j] > a[2*j+1])
+			return false;
+	}
+	return true;
+}
+
+std::string brickSectionName(char kind, std::uint32_t brick)
+{
+	return kind + std::to_string(brick);
+}
+
+// cell of x on a grid of cells per axis over bounds
+std::array<int, 3> gridCoord(const double x[3], const double bounds[6], int cells)
+{
+	std::array<int, 3> ret;
+	for(int j = 0; j < 3; ++j)
+	{
+		const double extent = bounds[2*j+1] - bounds[2*j];
+		const int c = extent > 0.0 ? static_cast<int>((x[j] - bounds[2*j]) / extent * cells) : 0;
+		ret[j] = std::min(std::max(c, 0), cells - 1);
+	}
+	return ret;
+}
+
+struct FloatPointHash
+{
+	std::size_t operator()(const std::array<std::uint32_t, 3>& key) const
+	{
+		std::uint64_t h = key[0] * 0x9E3779B185EBCA87ULL;
+		h = (h ^ key[1]) * 0xC2B2AE3D27D4EB4FULL;
+		h = (h ^ key[2]) * 0x9E3779B185EBCA87ULL;
+		return static_cast<std::size_t>(h ^ (h >> 29));
+	}
+};
+
+// stripe s covers the triangles [count * s / NumStripes, count * (s + 1) / NumStripes)
+template<class Functor>
+void forStripes(std::uint64_t count, bool parallel, Functor&& functor)
+{
+	auto stripes = [count, &functor](vtkIdType begin, vtkIdType end)
+	{
+		for(vtkIdType s = begin; s < end; ++s)
+			functor(s, count * s / NumStripes, count * (s + 1) / NumStripes);
+	};
+	if(parallel)
+		vtkSMPTools::For(0, NumStripes, 1, stripes);
+	else
+		stripes(0, NumStripes);
+}
+
+// coordinates (x first) decide the direction of an edge, both bricks of the edge interpolate it the same way
+bool pointLess(const float* a, const float* b)
+{
+	return std::lexicographical_compare(a, a + 3, b, b + 3);
+}
+}
+
+CBrickedMeshWriter::CBrickedMeshWriter()
+	: m_maxTrianglesPerBrick(vtkIdType(1) << 20)
+	, m_memoryBudget(std::uint64_t(1) << 30)
+	, m_gridLevels(7)
+	, m_bParallel(true)
+	, m_brickCount(0)
+	, m_passCount(0)
+	, m_dWriteTime(0.0)
+{
+}
+
+void CBrickedMeshWriter::SetMaxTrianglesPerBrick(vtkIdType count)
+{
+	m_maxTrianglesPerBrick = std::max<vtkIdType>(1, count);
+}
+
+void CBrickedMeshWriter::SetMemoryBudget(std::uint64_t bytes)
+{
+	m_memoryBudget = bytes;
+}
+
+void CBrickedMeshWriter::SetGridLevels(int levels)
+{
+	m_gridLevels = std::min(std::max(levels, 1), 8);
+}
+
+void CBrickedMeshWriter::SetParallel(bool parallel)
+{
+	m_bParallel = parallel;
+}
+
+bool CBrickedMeshWriter::Write(const std::string& stlPath, const std::string& path)
+{
+	const auto startTime = std::chrono::steady_clock::now();
+	m_errorMessage.clear();
+	m_brickCount = 0;
+	m_passCount = 0;
+	m_dWriteTime = 0.0;
+
+	CMappedFile file;
+	if(!file.Open(stlPath))
+	{
+		m_errorMessage = "cannot open " + stlPath;
+		return false;
+	}
+	// the detection of CStlReader, trailing bytes and a wrong header count are accepted. A "solid" file whose
+	// records are not text is taken as binary without trying it as ASCII first
+	std::uint64_t numTriangles(0);
+	const CStlReader::Format format = CStlReader::DetectFormat(file.Data(), file.Size(), numTriangles);
+	if((format != CStlReader::Format::Binary && format != CStlReader::Format::AsciiOrBinary) || numTriangles == 0)
+	{
+		// an ASCII file would have to be parsed on every pass, CStlReader and a binary copy are the way
+		m_errorMessage = stlPath + " is not a binary STL file with triangles";
+		return false;
+	}
+	const char* records = file.Data() + StlHeaderSize;
+
+	// bounds
+	CBrickedMesh::Header header = {};
+	header.triangleCount = numTriangles;
+	header.gridLevels = static_cast<std::uint32_t>(m_gridLevels);
+	{
+		std::vector<std::array<double, 6>> stripeBounds(NumStripes);
+		forStripes(numTriangles, m_bParallel, [records, &stripeBounds](vtkIdType s, std::uint64_t begin, std::uint64_t end)
+		{
+			emptyBounds(stripeBounds[s].data());
+			float v[9];
+			for(std::uint64_t t = begin; t < end; ++t)
+			{
+				recordVertices(records, t, v);
+				for(int k = 0; k < 3; ++k)
+					addToBounds(v + 3 * k, stripeBounds[s].data());
+			}
+		});
+		emptyBounds(header.bounds);
+		for(const auto& bounds : stripeBounds)
+			mergeBounds(bounds.data(), header.bounds);
+		++m_passCount;
+	}
+
+	// centroid histogram on the finest grid and its pyramid up to the octree root
+	const int levels = m_gridLevels;
+	const int cells = 1 << levels;
+	auto centroidCell = [&header, cells](const float v[9])
+	{
+		const double centroid[3] = {(double(v[0]) + v[3] + v[6]) / 3.0, (double(v[1]) + v[4] + v[7]) / 3.0, (double(v[2]) + v[5] + v[8]) / 3.0};
+		const auto c = gridCoord(centroid, header.bounds, cells);
+		return (static_cast<std::size_t>(c[2]) * cells + c[1]) * cells + c[0];
+	};
+	std::vector<std::vector<std::uint64_t>> pyramid(levels + 1);
+	{
+		std::vector<std::atomic<std::uint64_t>> histogram(static_cast<std::size_t>(cells) * cells * cells);
+		forStripes(numTriangles, m_bParallel, [records, &centroidCell, &histogram](vtkIdType, std::uint64_t begin, std::uint64_t end)
+		{
+			float v[9];
+			for(std::uint64_t t = begin; t < end; ++t)
+			{
+				recordVertices(records, t, v);
+				histogram[centroidCell(v)].fetch_add(1, std::memory_order_relaxed);
+			}
+		});
+		++m_passCount;
+		pyramid[levels].resize(histogram.size());
+		for(std::size_t i = 0; i < histogram.size(); ++i)
+			pyramid[levels][i] = histogram[i].load(std::memory_order_relaxed);
+	}
+	for(int l = levels - 1; l >= 0; --l)
+	{
+		const int n = 1 << l;
+		pyramid[l].assign(static_cast<std::size_t>(n) * n * n, 0);
+		for(int z = 0; z < 2 * n; ++z)
+			for(int y = 0; y < 2 * n; ++y)
+				for(int x = 0; x < 2 * n; ++x)
+					pyramid[l][(static_cast<std::size_t>(z / 2) * n + y / 2) * n + x / 2] += pyramid[l+1][(static_cast<std::size_t>(z) * 2 * n + y) * 2 * n + x];
+	}
+
+	// octree split, depth first so that consecutive bricks are neighbours
+	std::vector<CBrickedMesh::BrickInfo> bricks;
+	std::vector<std::uint32_t> cellToBrick(pyramid[levels].size(), NoBrick);
+	{
+		std::vector<std::array<int, 4>> stack = {{0, 0, 0, 0}};//level, x, y, z
+		while(!stack.empty())
+		{
+			const auto node = stack.back();
+			stack.pop_back();
+			const int l = node[0];
+			const int n = 1 << l;
+			const std::uint64_t nodeCount = pyramid[l][(static_cast<std::size_t>(node[3]) * n + node[2]) * n + node[1]];
+			if(nodeCount == 0)
+				continue;
+			if(nodeCount > static_cast<std::uint64_t>(m_maxTrianglesPerBrick) && l < levels)
+			{
+				for(int child = 7; child >= 0; --child)
+					stack.push_back({l + 1, 2 * node[1] + (child & 1), 2 * node[2] + ((child >> 1) & 1), 2 * node[3] + (child >> 2)});
+				continue;
+			}
+			CBrickedMesh::BrickInfo brick = {};
+			const int shift = levels - l;
+			for(int j = 0; j < 3; ++j)
+			{
+				const double extent = header.bounds[2*j+1] - header.bounds[2*j];
+				brick.box[2*j] = header.bounds[2*j] + extent * node[j+1] / n;
+				brick.box[2*j+1] = header.bounds[2*j] + extent * (node[j+1] + 1) / n;
+			}
+			emptyBounds(brick.ownedBounds);
+			brick.ownedCount = nodeCount;
+			const std::uint32_t brickId = static_cast<std::uint32_t>(bricks.size());
+			for(int z = node[3] << shift; z < (node[3] + 1) << shift; ++z)
+				for(int y = node[2] << shift; y < (node[2] + 1) << shift; ++y)
+					for(int x = node[1] << shift; x < (node[1] + 1) << shift; ++x)
+						cellToBrick[(static_cast<std::size_t>(z) * cells + y) * cells + x] = brickId;
+			bricks.push_back(brick);
+		}
+		pyramid.clear();
+	}
+	header.brickCount = static_cast<std::uint32_t>(bricks.size());
+	const std::uint32_t numBricks = header.brickCount;
+
+	// owned bounds
+	{
+		std::vector<std::vector<double>> stripeBounds(NumStripes);
+		forStripes(numTriangles, m_bParallel, [&](vtkIdType s, std::uint64_t begin, std::uint64_t end)
+		{
+			std::vector<double>& bounds = stripeBounds[s];
+			bounds.resize(6 * static_cast<std::size_t>(numBricks));
+			for(std::uint32_t b = 0; b < numBricks; ++b)
+				emptyBounds(bounds.data() + 6 * b);
+			float v[9];
+			for(std::uint64_t t = begin; t < end; ++t)
+			{
+				recordVertices(records, t, v);
+				double* brickBounds = bounds.data() + 6 * cellToBrick[centroidCell(v)];
+				for(int k = 0; k < 3; ++k)
+					addToBounds(v + 3 * k, brickBounds);
+			}
+		});
+		for(const auto& bounds : stripeBounds)
+			for(std::uint32_t b = 0; b < numBricks; ++b)
+				mergeBounds(bounds.data() + 6 * b, bricks[b].ownedBounds);
+		++m_passCount;
+	}
+
+	// coarse cells listing the bricks of [first, last) whose owned bounds overlap them
+	auto coarseGrid = [&header, &bricks](std::uint32_t first, std::uint32_t last)
+	{
+		std::vector<std::vector<std::uint32_t>> coarseBricks(CoarseGrid * CoarseGrid * CoarseGrid);
+		for(std::uint32_t b = first; b < last; ++b)
+		{
+			const double upperCorner[3] = {bricks[b].ownedBounds[1], bricks[b].ownedBounds[3], bricks[b].ownedBounds[5]};
+			const double lowerCorner[3] = {bricks[b].ownedBounds[0], bricks[b].ownedBounds[2], bricks[b].ownedBounds[4]};
+			const auto lowerCell = gridCoord(lowerCorner, header.bounds, CoarseGrid);
+			const auto upperCell = gridCoord(upperCorner, header.bounds, CoarseGrid);
+			for(int z = lowerCell[2]; z <= upperCell[2]; ++z)
+				for(int y = lowerCell[1]; y <= upperCell[1]; ++y)
+					for(int x = lowerCell[0]; x <= upperCell[0]; ++x)
+						coarseBricks[(z * CoarseGrid + y) * CoarseGrid + x].push_back(b);
+		}
+		return coarseBricks;
+	};
+	// calls visit once for every brick of coarseBricks other than owner whose owned bounds the triangle v overlaps
+	auto forHaloBricks = [&header, &bricks](const float v[9], std::uint32_t owner, const std::vector<std::vector<std::uint32_t>>& coarseBricks,
+		std::vector<std::uint32_t>& added, auto&& visit)
+	{
+		double bounds[6];
+		emptyBounds(bounds);
+		for(int k = 0; k < 3; ++k)
+			addToBounds(v + 3 * k, bounds);
+		const double lowerCorner[3] = {bounds[0], bounds[2], bounds[4]};
+		const double upperCorner[3] = {bounds[1], bounds[3], bounds[5]};
+		const auto lowerCell = gridCoord(lowerCorner, header.bounds, CoarseGrid);
+		const auto upperCell = gridCoord(upperCorner, header.bounds, CoarseGrid);
+		added.clear();
+		for(int z = lowerCell[2]; z <= upperCell[2]; ++z)
+			for(int y = lowerCell[1]; y <= upperCell[1]; ++y)
+				for(int x = lowerCell[0]; x <= upperCell[0]; ++x)
+				{
+					for(const auto b : coarseBricks[(z * CoarseGrid + y) * CoarseGrid + x])
+					{
+						if(b == owner || std::find(added.cbegin(), added.cend(), b) != added.cend() || !boundsIntersect(bounds, bricks[b].ownedBounds))
+							continue;
+						added.push_back(b);
+						visit(b);
+					}
+				}
+	};
+
+	// halo counts, so that a group of bricks is sized by everything it gathers
+	{
+		const auto coarseBricks = coarseGrid(0, numBricks);
+		std::vector<std::vector<std::uint64_t>> stripeHalo(NumStripes);
+		forStripes(numTriangles, m_bParallel, [&](vtkIdType s, std::uint64_t begin, std::uint64_t end)
+		{
+			std::vector<std::uint64_t>& halo = stripeHalo[s];
+			halo.assign(numBricks, 0);
+			std::vector<std::uint32_t> added;
+			float v[9];
+			for(std::uint64_t t = begin; t < end; ++t)
+			{
+				recordVertices(records, t, v);
+				forHaloBricks(v, cellToBrick[centroidCell(v)], coarseBricks, added, [&halo](std::uint32_t b) { ++halo[b]; });
+			}
+		});
+		for(const auto& halo : stripeHalo)
+			for(std::uint32_t b = 0; b < numBricks; ++b)
+				bricks[b].haloCount += halo[b];
+		++m_passCount;
+	}
+
+	CMeshFileWriter writer;
+	if(!writer.Open(path))
+	{
+		m_errorMessage = "cannot write " + path;
+		return false;
+	}
+
+	// gather, weld and write the bricks, one scan of the STL per group of bricks fitting in the budget
+	auto brickBytes = [&bricks](std::uint32_t b) { return (bricks[b].ownedCount + bricks[b].haloCount) * BytesPerTriangle; };
+	std::vector<std::int32_t> groupOf(numBricks, -1);
+	for(std::uint32_t groupBegin = 0; groupBegin < numBricks;)
+	{
+		std::uint32_t groupEnd = groupBegin + 1;
+		std::uint64_t groupBytes = brickBytes(groupBegin);
+		while(groupEnd < numBricks && groupBytes + brickBytes(groupEnd) <= m_memoryBudget)
+			groupBytes += brickBytes(groupEnd++);
+		const std::uint32_t groupSize = groupEnd - groupBegin;
+		for(std::uint32_t b = groupBegin; b < groupEnd; ++b)
+			groupOf[b] = static_cast<std::int32_t>(b - groupBegin);
+
+		const auto coarseBricks = coarseGrid(groupBegin, groupEnd);
+
+		// [stripe][brick of the group] owned then halo global ids, in file order once the stripes are joined
+		std::vector<std::vector<std::vector<std::uint64_t>>> stripeOwned(NumStripes), stripeHalo(NumStripes);
+		forStripes(numTriangles, m_bParallel, [&](vtkIdType s, std::uint64_t begin, std::uint64_t end)
+		{
+			auto& owned = stripeOwned[s];
+			auto& halo = stripeHalo[s];
+			owned.resize(groupSize);
+			halo.resize(groupSize);
+			std::vector<std::uint32_t> added;
+			float v[9];
+			for(std::uint64_t t = begin; t < end; ++t)
+			{
+				recordVertices(records, t, v);
+				const std::uint32_t owner = cellToBrick[centroidCell(v)];
+				if(groupOf[owner] >= 0)
+					owned[groupOf[owner]].push_back(t);
+				forHaloBricks(v, owner, coarseBricks, added, [&halo, &groupOf, t](std::uint32_t b) { halo[groupOf[b]].push_back(t); });
+			}
+		});
+		++m_passCount;
+
+		// weld the bricks of the group exactly, owned triangles first
+		std::vector<CBrickedMeshReader::Brick> built(groupSize);
+		auto weld = [&](vtkIdType begin, vtkIdType end)
+		{
+			for(vtkIdType g = begin; g < end; ++g)
+			{
+				CBrickedMeshReader::Brick& brick = built[g];
+				for(const auto& stripe : stripeOwned)
+					brick.globalIds.insert(brick.globalIds.end(), stripe[g].cbegin(), stripe[g].cend());
+				brick.ownedCount = brick.globalIds.size();
+				for(const auto& stripe : stripeHalo)
+					brick.globalIds.insert(brick.globalIds.end(), stripe[g].cbegin(), stripe[g].cend());
+
+				std::unordered_map<std::array<std::uint32_t, 3>, std::uint32_t, FloatPointHash> pointIds;
+				pointIds.reserve(brick.globalIds.size());
+				brick.triangles.resize(3 * brick.globalIds.size());
+				brick.points.reserve(3 * brick.globalIds.size() / 2);
+				float v[9];
+				for(std::size_t i = 0; i < brick.globalIds.size(); ++i)
+				{
+					recordVertices(records, brick.globalIds[i], v);
+					for(int k = 0; k < 3; ++k)
+					{
+						std::array<std::uint32_t, 3> key;
+						std::memcpy(key.data(), v + 3 * k, sizeof(key));
+						const auto inserted = pointIds.emplace(key, static_cast<std::uint32_t>(brick.points.size() / 3));
+						if(inserted.second)
+							brick.points.insert(brick.points.end(), v + 3 * k, v + 3 * k + 3);
+						brick.triangles[3 * i + k] = inserted.first->second;
+					}
+				}
+			}
+		};
+		if(m_bParallel)
+			vtkSMPTools::For(0, groupSize, 1, weld);
+		else
+			weld(0, groupSize);
+		stripeOwned.clear();
+		stripeHalo.clear();
+
+		for(std::uint32_t g = 0; g < groupSize; ++g)
+		{
+			const std::uint32_t b = groupBegin + g;
+			const CBrickedMeshReader::Brick& brick = built[g];
+			bricks[b].pointCount = brick.points.size() / 3;
+			writer.WriteBlob(brickSectionName('p', b), brick.points.data(), brick.points.size() * sizeof(float));
+			writer.WriteBlob(brickSectionName('t', b), brick.triangles.data(), brick.triangles.size() * sizeof(std::uint32_t));
+			writer.WriteBlob(brickSectionName('g', b), brick.globalIds.data(), brick.globalIds.size() * sizeof(std::uint64_t));
+			groupOf[b] = -1;
+		}
+		groupBegin = groupEnd;
+	}
+
+	const bool ret = writer.WriteBlob(HeaderSection, &header, sizeof(header))
+		&& writer.WriteBlob(BricksSection, bricks.data(), bricks.size() * sizeof(CBrickedMesh::BrickInfo))
+		&& writer.Close();
+	if(!ret)
+		m_errorMessage = "cannot write " + path;
+	m_brickCount = numBricks;
+	m_dWriteTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	return ret;
+}
+
+const std::string& CBrickedMeshWriter::ErrorMessage() const
+{
+	return m_errorMessage;
+}
+
+std::uint32_t CBrickedMeshWriter::BrickCount() const
+{
+	return m_brickCount;
+}
+
+int CBrickedMeshWriter::PassCount() const
+{
+	return m_passCount;
+}
+
+double CBrickedMeshWriter::WriteTime() const
+{
+	return m_dWriteTime;
+}
+
+std::size_t CBrickedMeshReader::Brick::MemorySize() const
+{
+	return sizeof(*this) + points.capacity() * sizeof(float) + triangles.capacity() * sizeof(std::uint32_t)
+		+ globalIds.capacity() * sizeof(std::uint64_t);
+}
+
+CBrickedMeshReader::CBrickedMeshReader()
+	: m_header()
+	, m_bParallel(true)
+	, m_cacheBudget(std::uint64_t(512) << 20)
+	, m_cacheSize(0)
+	, m_loadCount(0)
+	, m_corruptCount(0)
+{
+}
+
+bool CBrickedMeshReader::Open(const std::string& path)
+{
+	Close();
+	if(!m_file.Open(path))
+		return false;
+	const auto headerSection = m_file.FindSection(CMeshFile::BLOB, HeaderSection);
+	const auto bricksSection = m_file.FindSection(CMeshFile::BLOB, BricksSection);
+	if(!headerSection || headerSection->size != sizeof(CBrickedMesh::Header) || !bricksSection)
+	{
+		Close();
+		return false;
+	}
+	std::memcpy(&m_header, m_file.SectionData(*headerSection), sizeof(m_header));
+	if(bricksSection->size != std::uint64_t(m_header.brickCount) * sizeof(CBrickedMesh::BrickInfo))
+	{
+		Close();
+		return false;
+	}
+	m_bricks.resize(m_header.brickCount);
+	std::memcpy(m_bricks.data(), m_file.SectionData(*bricksSection), bricksSection->size);
+
+	// one pass over the section table instead of a lookup by name per brick
+	m_brickSections.assign(m_header.brickCount, {nullptr, nullptr, nullptr});
+	const char kinds[3] = {'p', 't', 'g'};
+	for(const auto& section : m_file.Sections())
+	{
+		const char* name = section.name;
+		const char* kind = std::find(kinds, kinds + 3, name[0]);
+		if(section.kind != CMeshFile::BLOB || kind == kinds + 3 || name[1] < '0' || name[1] > '9')
+			continue;
+		const std::uint64_t brick = std::strtoull(name + 1, nullptr, 10);
+		if(brick < m_header.brickCount)
+			m_brickSections[brick][kind - kinds] = &section;
+	}
+	for(std::uint32_t b = 0; b < m_header.brickCount; ++b)
+	{
+		const auto& info = m_bricks[b];
+		const auto& sections = m_brickSections[b];
+		const std::uint64_t numTriangles = info.ownedCount + info.haloCount;
+		if(!sections[0] || !sections[1] || !sections[2]
+			|| sections[0]->size != info.pointCount * 3 * sizeof(float)
+			|| sections[1]->size != numTriangles * 3 * sizeof(std::uint32_t)
+			|| sections[2]->size != numTriangles * sizeof(std::uint64_t))
+		{
+			Close();
+			return false;
+		}
+	}
+	return true;
+}
+
+void CBrickedMeshReader::Close()
+{
+	std::lock_guard<std::mutex> lock(m_cacheMutex);
+	m_file.Close();
+	m_header = CBrickedMesh::Header();
+	m_bricks.clear();
+	m_brickSections.clear();
+	m_lru.clear();
+	m_cache.clear();
+	m_cacheSize = 0;
+	m_loadCount = 0;
+	m_corruptCount = 0;
+}
+
+bool CBrickedMeshReader::IsOpen() const
+{
+	return m_file.IsOpen();
+}
+
+const CBrickedMesh::Header& CBrickedMeshReader::Header() const
+{
+	return m_header;
+}
+
+const std::vector<CBrickedMesh::BrickInfo>& CBrickedMeshReader::Bricks() const
+{
+	return m_bricks;
+}
+
+void CBrickedMeshReader::SetCacheBudget(std::uint64_t bytes)
+{
+	std::lock_guard<std::mutex> lock(m_cacheMutex);
+	m_cacheBudget = bytes;
+	while(m_cacheSize > m_cacheBudget && !m_lru.empty())
+	{
+		const auto iter = m_cache.find(m_lru.back());
+		m_cacheSize -= iter->second.first->MemorySize();
+		m_cache.erase(iter);
+		m_lru.pop_back();
+	}
+}
+
+std::uint64_t CBrickedMeshReader::CacheSize() const
+{
+	std::lock_guard<std::mutex> lock(m_cacheMutex);
+	return m_cacheSize;
+}
+
+vtkIdType CBrickedMeshReader::BrickLoadCount() const
+{
+	std::lock_guard<std::mutex> lock(m_cacheMutex);
+	return m_loadCount;
+}
+
+vtkIdType CBrickedMeshReader::CorruptBrickCount() const
+{
+	std::lock_guard<std::mutex> lock(m_cacheMutex);
+	return m_corruptCount;
+}
+
+void CBrickedMeshReader::SetParallel(bool parallel)
+{
+	m_bParallel = parallel;
+}
+
+std::shared_ptr<const CBrickedMeshReader::Brick> CBrickedMeshReader::LoadBrick(std::uint32_t index)
+{
+	if(index >= m_bricks.size())
+		return nullptr;
+	{
+		std::lock_guard<std::mutex> lock(m_cacheMutex);
+		const auto iter = m_cache.find(index);
+		if(iter != m_cache.end())
+		{
+			m_lru.splice(m_lru.begin(), m_lru, iter->second.second);
+			return iter->second.first;
+		}
+	}
+
+	// decoded outside the lock, two threads asking for the same brick may both decode it
+	auto brick = std::make_shared<Brick>();
+	const auto& sections = m_brickSections[index];
+	brick->points.resize(static_cast<std::size_t>(sections[0]->size / sizeof(float)));
+	brick->triangles.resize(static_cast<std::size_t>(sections[1]->size / sizeof(std::uint32_t)));
+	brick->globalIds.resize(static_cast<std::size_t>(sections[2]->size / sizeof(std::uint64_t)));
+	std::memcpy(brick->points.data(), m_file.SectionData(*sections[0]), sections[0]->size);
+	std::memcpy(brick->triangles.data(), m_file.SectionData(*sections[1]), sections[1]->size);
+	std::memcpy(brick->globalIds.data(), m_file.SectionData(*sections[2]), sections[2]->size);
+	brick->ownedCount = m_bricks[index].ownedCount;
+	// Open() checked the section sizes, the ids themselves are only seen here
+	const std::uint32_t numPoints = static_cast<std::uint32_t>(brick->points.size() / 3);
+	const std::uint64_t numTriangles = m_header.triangleCount;
+	if(std::any_of(brick->triangles.cbegin(), brick->triangles.cend(), [numPoints](std::uint32_t id) { return id >= numPoints; })
+		|| std::any_of(brick->globalIds.cbegin(), brick->globalIds.cend(), [numTriangles](std::uint64_t id) { return id >= numTriangles; }))
+	{
+		std::lock_guard<std::mutex> lock(m_cacheMutex);
+		++m_corruptCount;
+		return nullptr;
+	}
+
+	std::lock_guard<std::mutex> lock(m_cacheMutex);
+	++m_loadCount;
+	const auto iter = m_cache.find(index);
+	if(iter != m_cache.end())
+		return iter->second.first;
+	m_lru.push_front(index);
+	m_cache.emplace(index, std::make_pair(std::shared_ptr<const Brick>(brick), m_lru.begin()));
+	m_cacheSize += brick->MemorySize();
+	while(m_cacheSize > m_cacheBudget && m_lru.size() > 1)
+	{
+		const auto evicted = m_cache.find(m_lru.back());
+		m_cacheSize -= evicted->second.first->MemorySize();
+		m_cache.erase(evicted);
+		m_lru.pop_back();
+	}
+	return brick;
+}
+
+vtkSmartPointer<vtkPolyData> CBrickedMeshReader::BrickPolyData(std::uint32_t index, bool withHalo)
+{
+	const auto brick = LoadBrick(index);
+	if(!brick)
+		return nullptr;
+	const vtkIdType numPoints = static_cast<vtkIdType>(brick->points.size() / 3);
+	const vtkIdType numTriangles = static_cast<vtkIdType>(withHalo ? brick->globalIds.size() : brick->ownedCount);
+	auto points = vtkSmartPointer<vtkPoints>::New();
+	points->SetDataTypeToFloat();
+	points->SetNumberOfPoints(numPoints);
+	std::copy(brick->points.cbegin(), brick->points.cend(), vtkFloatArray::SafeDownCast(points->GetData())->GetPointer(0));
+	auto connectivity = vtkSmartPointer<vtkIdTypeArray>::New();
+	connectivity->SetNumberOfValues(4 * numTriangles);
+	vtkIdType* ids = connectivity->GetPointer(0);
+	for(vtkIdType t = 0; t < numTriangles; ++t)
+	{
+		ids[4*t] = 3;
+		for(int k = 0; k < 3; ++k)
+			ids[4*t+1+k] = brick->triangles[3*t+k];
+	}
+	auto polys = vtkSmartPointer<vtkCellArray>::New();
+	polys->SetCells(numTriangles, connectivity);
+	auto ret = vtkSmartPointer<vtkPolyData>::New();
+	ret->SetPoints(points);
+	ret->SetPolys(polys);
+	return ret;
+}
+
+std::vector<std::uint32_t> CBrickedMeshReader::BricksInBox(const double box[6]) const
+{
+	std::vector<std::uint32_t> ret;
+	for(std::uint32_t b = 0; b < m_bricks.size(); ++b)
+	{
+		if(m_bricks[b].ownedCount > 0 && boundsIntersect(box, m_bricks[b].ownedBounds))
+			ret.push_back(b);
+	}
+	return ret;
+}
+
+// functor(i, brick) for the i-th brick of bricks, the bricks are loaded through the cache, corrupt ones are skipped
+template<class Functor>
+void CBrickedMeshReader::ForEachBrick(const std::vector<std::uint32_t>& bricks, Functor&& functor)
+{
+	auto visit = [this, &bricks, &functor](vtkIdType begin, vtkIdType end)
+	{
+		for(vtkIdType i = begin; i < end; ++i)
+		{
+			const auto brick = LoadBrick(bricks[i]);
+			if(brick)
+				functor(i, *brick);
+		}
+	};
+	const vtkIdType count = static_cast<vtkIdType>(bricks.size());
+	if(m_bParallel)
+		vtkSMPTools::For(0, count, 1, visit);
+	else
+		visit(0, count);
+}
+
+std::vector<CMeshSlicer::Layer> CBrickedMeshReader::Slice(const std::array<double, 3>& normal, const std::vector<double>& offsets)
+{
+	std::vector<CMeshSlicer::Layer> ret(offsets.size());
+	for(std::size_t i = 0; i < offsets.size(); ++i)
+		ret[i].offset = offsets[i];
+	const double length = std::sqrt(normal[0]*normal[0] + normal[1]*normal[1] + normal[2]*normal[2]);
+	if(!IsOpen() || offsets.empty() || length == 0.0)
+		return ret;
+	const std::array<double, 3> unitNormal = {normal[0] / length, normal[1] / length, normal[2] / length};
+	std::vector<std::size_t> order(offsets.size());
+	for(std::size_t i = 0; i < order.size(); ++i)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&offsets](std::size_t a, std::size_t b) { return offsets[a] < offsets[b]; });
+	std::vector<double> sortedOffsets(offsets.size());
+	for(std::size_t i = 0; i < order.size(); ++i)
+		sortedOffsets[i] = offsets[order[i]];
+
+	// bricks whose height range along the normal holds an offset
+	std::vector<std::uint32_t> bricks;
+	for(std::uint32_t b = 0; b < m_bricks.size(); ++b)
+	{
+		const double* bounds = m_bricks[b].ownedBounds;
+		double lower(0.0), upper(0.0);
+		for(int j = 0; j < 3; ++j)
+		{
+			lower += unitNormal[j] * (unitNormal[j] >= 0.0 ? bounds[2*j] : bounds[2*j+1]);
+			upper += unitNormal[j] * (unitNormal[j] >= 0.0 ? bounds[2*j+1] : bounds[2*j]);
+		}
+		const auto first = std::lower_bound(sortedOffsets.cbegin(), sortedOffsets.cend(), lower);
+		if(m_bricks[b].ownedCount > 0 && first != sortedOffsets.cend() && *first <= upper)
+			bricks.push_back(b);
+	}
+
+	// segments of the owned triangles, [brick][sorted layer] two points per segment
+	using Segments = std::vector<std::array<double, 3>>;
+	std::vector<std::vector<Segments>> brickSegments(bricks.size());
+	ForEachBrick(bricks, [&](vtkIdType i, const Brick& brick)
+	{
+		auto& segments = brickSegments[i];
+		segments.resize(sortedOffsets.size());
+		const float* points = brick.points.data();
+		std::vector<double> heights(brick.points.size() / 3);
+		for(std::size_t p = 0; p < heights.size(); ++p)
+			heights[p] = points[3*p] * unitNormal[0] + points[3*p+1] * unitNormal[1] + points[3*p+2] * unitNormal[2];
+		for(std::uint64_t t = 0; t < brick.ownedCount; ++t)
+		{
+			const std::uint32_t* triangle = brick.triangles.data() + 3 * t;
+			const double lowest = std::min({heights[triangle[0]], heights[triangle[1]], heights[triangle[2]]});
+			const double highest = std::max({heights[triangle[0]], heights[triangle[1]], heights[triangle[2]]});
+			// a vertex at height >= offset is above the plane, like CMeshSlicer
+			for(auto l = std::upper_bound(sortedOffsets.cbegin(), sortedOffsets.cend(), lowest); l != sortedOffsets.cend() && *l <= highest; ++l)
+			{
+				const double offset = *l;
+				std::array<double, 3> segment[2];
+				int found(0);
+				for(int k = 0; k < 3; ++k)
+				{
+					std::uint32_t a = triangle[k];
+					std::uint32_t b = triangle[(k + 1) % 3];
+					if((heights[a] >= offset) == (heights[b] >= offset))
+						continue;
+					if(pointLess(points + 3 * b, points + 3 * a))
+						std::swap(a, b);
+					const double da = heights[a] - offset;
+					const double db = heights[b] - offset;
+					const double s = da / (da - db);
+					for(int j = 0; j < 3; ++j)
+						segment[found][j] = points[3*a+j] + s * (static_cast<double>(points[3*b+j]) - points[3*a+j]);
+					++found;
+				}
+				if(found == 2)
+				{
+					Segments& layer = segments[l - sortedOffsets.cbegin()];
+					layer.push_back(segment[0]);
+					layer.push_back(segment[1]);
+				}
+			}
+		}
+	});
+
+	// stitch the layers across the bricks
+	auto chain = [&](vtkIdType begin, vtkIdType end)
+	{
+		CContourChainer chainer;
+		for(vtkIdType l = begin; l < end; ++l)
+		{
+			chainer.Clear();
+			for(const auto& segments : brickSegments)
+			{
+				const Segments& layer = segments[l];
+				for(std::size_t s = 0; s + 1 < layer.size(); s += 2)
+					chainer.AddSegment(layer[s], layer[s+1]);
+			}
+			ret[order[l]].contours = chainer.Chain(unitNormal);
+		}
+	};
+	const vtkIdType numLayers = static_cast<vtkIdType>(sortedOffsets.size());
+	if(m_bParallel)
+		vtkSMPTools::For(0, numLayers, 1, chain);
+	else
+		chain(0, numLayers);
+	return ret;
+}
+
+vtkSmartPointer<vtkIdList> CBrickedMeshReader::SelectRegion(const std::vector<std::array<double, 3>>& centers, double radius)
+{
+	auto ret = vtkSmartPointer<vtkIdList>::New();
+	if(!IsOpen() || centers.empty() || radius <= 0.0)
+		return ret;
+	// in double like the per brick test below, rounding the corners to float could shrink the box
+	double box[6];
+	emptyBounds(box);
+	for(const auto& center : centers)
+	{
+		for(int j = 0; j < 3; ++j)
+		{
+			box[2*j] = std::min(box[2*j], center[j] - radius);
+			box[2*j+1] = std::max(box[2*j+1], center[j] + radius);
+		}
+	}
+	const auto bricks = BricksInBox(box);
+	const double radius2 = radius * radius;
+
+	std::vector<std::vector<std::uint64_t>> brickIds(bricks.size());
+	ForEachBrick(bricks, [&](vtkIdType i, const Brick& brick)
+	{
+		// the spheres reaching the owned bounds of this brick
+		const double* owned = m_bricks[bricks[i]].ownedBounds;
+		std::vector<std::array<double, 3>> reaching;
+		for(const auto& center : centers)
+		{
+			const double sphere[6] = {center[0] - radius, center[0] + radius, center[1] - radius, center[1] + radius, center[2] - radius, center[2] + radius};
+			if(boundsIntersect(sphere, owned))
+				reaching.push_back(center);
+		}
+		std::vector<signed char> inside(brick.points.size() / 3, -1);//unknown, 0 or 1
+		auto isInside = [&](std::uint32_t p)
+		{
+			if(inside[p] < 0)
+			{
+				inside[p] = 0;
+				const float* x = brick.points.data() + 3 * p;
+				for(const auto& center : reaching)
+				{
+					const double d[3] = {x[0] - center[0], x[1] - center[1], x[2] - center[2]};
+					if(d[0]*d[0] + d[1]*d[1] + d[2]*d[2] <= radius2)
+					{
+						inside[p] = 1;
+						break;
+					}
+				}
+			}
+			return inside[p] == 1;
+		};
+		for(std::uint64_t t = 0; t < brick.ownedCount; ++t)
+		{
+			const std::uint32_t* triangle = brick.triangles.data() + 3 * t;
+			if(isInside(triangle[0]) && isInside(triangle[1]) && isInside(triangle[2]))
+				brickIds[i].push_back(brick.globalIds[t]);
+		}
+	});
+
+	std::size_t total(0);
+	for(const auto& ids : brickIds)
+		total += ids.size();
+	ret->SetNumberOfIds(static_cast<vtkIdType>(total));
+	vtkIdType* out = ret->GetPointer(0);
+	for(const auto& ids : brickIds)
+		out = std::copy(ids.cbegin(), ids.cend(), out);
+	std::sort(ret->GetPointer(0), ret->GetPointer(0) + total);
+	return ret;
+}
+
+CBrickedMeshReader::TopologyReport CBrickedMeshReader::Topology()
+{
+	TopologyReport ret = {};
+	if(!IsOpen())
+		return ret;
+	std::vector<std::uint32_t> bricks;
+	for(std::uint32_t b = 0; b < m_bricks.size(); ++b)
+	{
+		if(m_bricks[b].ownedCount > 0)
+			bricks.push_back(b);
+	}
+
+	std::vector<TopologyReport> brickReports(bricks.size(), TopologyReport());
+	ForEachBrick(bricks, [&](vtkIdType i, const Brick& brick)
+	{
+		TopologyReport& report = brickReports[i];
+		const std::uint32_t* triangles = brick.triangles.data();
+		const std::size_t numTriangles = brick.globalIds.size();
+		const std::size_t numPoints = brick.points.size() / 3;
+		auto degenerate = [triangles](std::size_t t)
+		{
+			const std::uint32_t* v = triangles + 3 * t;
+			return v[0] == v[1] || v[1] == v[2] || v[0] == v[2];
+		};
+
+		// point -> triangles incidence, owned and halo
+		std::vector<std::uint32_t> fanOffsets(numPoints + 1, 0);
+		for(std::size_t t = 0; t < numTriangles; ++t)
+		{
+			if(!degenerate(t))
+				for(int k = 0; k < 3; ++k)
+					++fanOffsets[triangles[3*t+k] + 1];
+		}
+		for(std::size_t p = 0; p < numPoints; ++p)
+			fanOffsets[p+1] += fanOffsets[p];
+		std::vector<std::uint32_t> fans(fanOffsets[numPoints]);
+		{
+			std::vector<std::uint32_t> insertPos(fanOffsets.cbegin(), fanOffsets.cend() - 1);
+			for(std::size_t t = 0; t < numTriangles; ++t)
+			{
+				if(!degenerate(t))
+					for(int k = 0; k < 3; ++k)
+						fans[insertPos[triangles[3*t+k]]++] = static_cast<std::uint32_t>(t);
+			}
+		}
+		auto contains = [triangles](std::uint32_t t, std::uint32_t p)
+		{
+			return triangles[3*t] == p || triangles[3*t+1] == p || triangles[3*t+2] == p;
+		};
+		// does triangle t go from a to b
+		auto forward = [triangles](std::uint32_t t, std::uint32_t a, std::uint32_t b)
+		{
+			for(int k = 0; k < 3; ++k)
+			{
+				if(triangles[3*t+k] == a && triangles[3*t+(k+1)%3] == b)
+					return true;
+			}
+			return false;
+		};
+
+		std::vector<std::uint32_t> edgeFan, pointFan, parent;
+		std::vector<std::pair<std::uint32_t, std::uint32_t>> links;//(other vertex, fan index)
+		for(std::uint32_t t = 0; t < brick.ownedCount; ++t)
+		{
+			if(degenerate(t))
+				continue;
+			++report.numFaces;
+			const std::uint64_t id = brick.globalIds[t];
+			for(int k = 0; k < 3; ++k)
+			{
+				const std::uint32_t a = triangles[3*t+k];
+				const std::uint32_t b = triangles[3*t+(k+1)%3];
+				edgeFan.clear();
+				std::uint64_t smallest(id);
+				for(std::uint32_t f = fanOffsets[a]; f < fanOffsets[a+1]; ++f)
+				{
+					if(contains(fans[f], b))
+					{
+						edgeFan.push_back(fans[f]);
+						smallest = std::min(smallest, brick.globalIds[fans[f]]);
+					}
+				}
+				// the edge is counted by its smallest triangle, in the brick that owns it
+				if(smallest != id)
+					continue;
+				++report.numEdges;
+				if(edgeFan.size() == 1)
+					++report.numBoundaryEdges;
+				else if(edgeFan.size() > 2)
+					++report.numNonManifoldEdges;
+				else
+				{
+					const std::uint32_t other = edgeFan[0] == t ? edgeFan[1] : edgeFan[0];
+					if(forward(other, a, b))
+						++report.numInconsistentEdges;
+				}
+			}
+
+			for(int k = 0; k < 3; ++k)
+			{
+				const std::uint32_t p = triangles[3*t+k];
+				std::uint64_t smallest(id);
+				for(std::uint32_t f = fanOffsets[p]; f < fanOffsets[p+1]; ++f)
+					smallest = std::min(smallest, brick.globalIds[fans[f]]);
+				if(smallest != id)
+					continue;
+				++report.numPoints;
+				// the triangles around p form a single fan when they are connected through edges at p
+				pointFan.assign(fans.cbegin() + fanOffsets[p], fans.cbegin() + fanOffsets[p+1]);
+				parent.resize(pointFan.size());
+				for(std::size_t f = 0; f < parent.size(); ++f)
+					parent[f] = static_cast<std::uint32_t>(f);
+				auto root = [&parent](std::uint32_t f)
+				{
+					while(parent[f] != f)
+						f = parent[f] = parent[parent[f]];
+					return f;
+				};
+				// two triangles share an edge at p when they share its other vertex, sorted by that vertex
+				// the triangles of an edge are consecutive
+				links.clear();
+				for(std::size_t f = 0; f < pointFan.size(); ++f)
+				{
+					for(int m = 0; m < 3; ++m)
+					{
+						const std::uint32_t q = triangles[3*pointFan[f]+m];
+						if(q != p)
+							links.emplace_back(q, static_cast<std::uint32_t>(f));
+					}
+				}
+				std::sort(links.begin(), links.end());
+				std::size_t groups = pointFan.size();
+				for(std::size_t l = 1; l < links.size(); ++l)
+				{
+					if(links[l].first != links[l-1].first)
+						continue;
+					const std::uint32_t rf = root(links[l-1].second);
+					const std::uint32_t rg = root(links[l].second);
+					if(rf != rg)
+					{
+						parent[rg] = rf;
+						--groups;
+					}
+				}
+				if(groups > 1)
+					++report.numNonManifoldPoints;
+			}
+		}
+	});
+
+	for(const auto& report : brickReports)
+	{
+		ret.numPoints += report.numPoints;
+		ret.numEdges += report.numEdges;
+		ret.numFaces += report.numFaces;
+		ret.numBoundaryEdges += report.numBoundaryEdges;
+		ret.numInconsistentEdges += report.numInconsistentEdges;
+		ret.numNonManifoldEdges += report.numNonManifoldEdges;
+		ret.numNonManifoldPoints += report.numNonManifoldPoints;
+	}
+	ret.eulerCharacteristic = static_cast<std::int64_t>(ret.numPoints) - static_cast<std::int64_t>(ret.numEdges) + static_cast<std::int64_t>(ret.numFaces);
+	return ret;
+}
@@ -0,0 +1,168 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <vtkSmartPointer.h>
+#include <vtkType.h>
+#include "CMeshFile.h"
+#include "CMeshSlicer.h"
+
+class vtkPolyData;
+class vtkIdList;
+
+// *****
+// Out-of-core mesh for scans larger than memory: the triangles are partitioned into octree bricks stored in a
+// CMeshFile. A triangle is owned by the brick whose octree node holds its centroid. A brick also stores as halo
+// every other triangle whose box touches the bounds of its owned triangles. That includes every triangle sharing
+// a vertex with an owned triangle, so edge and vertex neighbourhoods are complete inside a single brick.
+// The points of a brick are welded exactly. A vertex keeps its float coordinates in every brick, which is what
+// identifies it across bricks. Triangles are identified by their index in the source STL file (the global id).
+// *****
+class CBrickedMesh
+{
+public:
+	struct Header
+	{
+		std::uint64_t triangleCount;
+		std::uint32_t brickCount;
+		std::uint32_t gridLevels;//octree depth limit, the grid has 2^levels cells per axis
+		double bounds[6];
+	};
+
+	struct BrickInfo
+	{
+		double box[6];//octree node
+		double ownedBounds[6];//of the vertices of the owned triangles, the halo reaches up to them
+		std::uint64_t ownedCount;
+		std::uint64_t haloCount;
+		std::uint64_t pointCount;
+	};
+
+	static const std::uint32_t Version = 1;
+};
+
+// *****
+// Builds a bricked mesh from a binary STL (detected like CStlReader does) without loading it: the mapped file is
+// scanned once for the bounds, once for a histogram of the centroids on the finest grid (from which the octree is
+// split until a node holds at most maxTrianglesPerBrick triangles), once for the owned bounds, once to count the
+// halo of every brick, and then once per group of bricks whose owned and halo triangles fit in the memory budget
+// to gather, weld and write them. A brick larger than the budget is gathered alone.
+// *****
+class CBrickedMeshWriter
+{
+public:
+	CBrickedMeshWriter();
+
+	void SetMaxTrianglesPerBrick(vtkIdType count);
+	void SetMemoryBudget(std::uint64_t bytes);//triangles gathered per pass
+	void SetGridLevels(int levels);//1 to 8, 7 by default
+	void SetParallel(bool parallel);
+
+	bool Write(const std::string& stlPath, const std::string& path);
+
+	const std::string& ErrorMessage() const;
+	std::uint32_t BrickCount() const;
+	int PassCount() const;//scans of the STL file in the last Write()
+	double WriteTime() const;//seconds
+
+private:
+	vtkIdType m_maxTrianglesPerBrick;
+	std::uint64_t m_memoryBudget;
+	int m_gridLevels;
+	bool m_bParallel;
+	std::string m_errorMessage;
+	std::uint32_t m_brickCount;
+	int m_passCount;
+	double m_dWriteTime;
+};
+
+// *****
+// Streams the bricks of a bricked mesh through a least recently used cache bounded in bytes.
+// The operations visit only the bricks whose owned bounds can contribute, and each one does its work on the
+// owned triangles only, so every triangle is counted once. The results are stitched at the brick boundaries:
+// slice segments are cut from edges ordered by coordinates, so the two bricks of an edge produce bit identical
+// end points and CContourChainer joins them. A topology element belongs to the brick that owns its smallest
+// incident triangle, and the halo holds all of its incident triangles.
+// Bricks in use stay alive while they are processed even when evicted, so the peak is the budget plus one
+// brick per thread.
+// *****
+class CBrickedMeshReader
+{
+public:
+	struct Brick
+	{
+		std::vector<float> points;
+		std::vector<std::uint32_t> triangles;//three local point ids per triangle, owned triangles first
+		std::vector<std::uint64_t> globalIds;
+		std::uint64_t ownedCount;
+
+		std::size_t MemorySize() const;
+	};
+
+	struct TopologyReport
+	{
+		std::uint64_t numPoints;
+		std::uint64_t numEdges;
+		std::uint64_t numFaces;//non degenerate triangles
+		std::uint64_t numBoundaryEdges;
+		std::uint64_t numInconsistentEdges;
+		std::uint64_t numNonManifoldEdges;
+		std::uint64_t numNonManifoldPoints;
+		std::int64_t eulerCharacteristic;
+
+		bool IsManifold() const { return numNonManifoldEdges == 0 && numNonManifoldPoints == 0; }
+		bool IsClosed() const { return numBoundaryEdges == 0; }
+	};
+
+	CBrickedMeshReader();
+
+	bool Open(const std::string& path);
+	void Close();
+	bool IsOpen() const;
+
+	const CBrickedMesh::Header& Header() const;
+	const std::vector<CBrickedMesh::BrickInfo>& Bricks() const;
+
+	void SetCacheBudget(std::uint64_t bytes);
+	std::uint64_t CacheSize() const;//bytes of the cached bricks
+	vtkIdType BrickLoadCount() const;//bricks decoded from the file since Open()
+	vtkIdType CorruptBrickCount() const;//loads that failed since Open(), the operations skip those bricks
+	void SetParallel(bool parallel);
+
+	// nullptr when a local point id or a global id of the brick is out of range
+	std::shared_ptr<const Brick> LoadBrick(std::uint32_t index);
+	// the brick as a triangle polydata, to run the in-memory helpers on it
+	vtkSmartPointer<vtkPolyData> BrickPolyData(std::uint32_t index, bool withHalo = false);
+
+	// same layers as CMeshSlicer::Slice() on the whole mesh
+	std::vector<CMeshSlicer::Layer> Slice(const std::array<double, 3>& normal, const std::vector<double>& offsets);
+	// global ids (sorted) of the triangles whose vertices are all inside the union of the spheres, like vtkAppendableSelection
+	vtkSmartPointer<vtkIdList> SelectRegion(const std::vector<std::array<double, 3>>& centers, double radius);
+	TopologyReport Topology();
+
+private:
+	// indices of the bricks whose owned bounds intersect box
+	std::vector<std::uint32_t> BricksInBox(const double box[6]) const;
+	template<class Functor>
+	void ForEachBrick(const std::vector<std::uint32_t>& bricks, Functor&& functor);
+
+private:
+	CMeshFileReader m_file;
+	CBrickedMesh::Header m_header;
+	std::vector<CBrickedMesh::BrickInfo> m_bricks;
+	std::vector<std::array<const CMeshFile::Section*, 3>> m_brickSections;//points, triangles, global ids
+	bool m_bParallel;
+
+	mutable std::mutex m_cacheMutex;
+	std::list<std::uint32_t> m_lru;//most recently used first
+	std::unordered_map<std::uint32_t, std::pair<std::shared_ptr<const Brick>, std::list<std::uint32_t>::iterator>> m_cache;
+	std::uint64_t m_cacheBudget;
+	std::uint64_t m_cacheSize;
+	vtkIdType m_loadCount;
+	vtkIdType m_corruptCount;
+};
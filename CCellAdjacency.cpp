@@ -0,0 +1,139 @@
+#include "CCellAdjacency.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include <vtkPolyData.h>
+#include <vtkSMPTools.h>
+
+namespace
+{
+// visits the cells sharing an edge with each cell through the point links.
+// Without output it counts them into counts[cellId + 1], otherwise it writes them from offsets[cellId].
+class EdgeNeighborsFunctor
+{
+public:
+	EdgeNeighborsFunctor(vtkPolyData* polydata, vtkIdType* counts, const vtkIdType* offsets, vtkIdType* output)
+		: m_polydata(polydata)
+		, m_counts(counts)
+		, m_offsets(offsets)
+		, m_output(output)
+	{
+	}
+
+	void operator()(vtkIdType begin, vtkIdType end) const
+	{
+		vtkIdType nPoints(0);
+		vtkIdType* pts(nullptr);
+		vtkIdType nOtherPoints(0);
+		vtkIdType* otherPts(nullptr);
+		unsigned short cellCount(0);
+		vtkIdType* cells(nullptr);
+		for(vtkIdType cellId = begin; cellId < end; ++cellId)
+		{
+			vtkIdType count(0);
+			m_polydata->GetCellPoints(cellId, nPoints, pts);
+			for(vtkIdType k = 0; nPoints >= 3 && k < nPoints; ++k)
+			{
+				const vtkIdType a = pts[k];
+				const vtkIdType b = pts[(k + 1) % nPoints];
+				m_polydata->GetPointCells(a, cellCount, cells);
+				for(unsigned short j = 0; j < cellCount; ++j)
+				{
+					if(cells[j] == cellId)
+						continue;
+					m_polydata->GetCellPoints(cells[j], nOtherPoints, otherPts);
+					if(nOtherPoints >= 3 && std::find(otherPts, otherPts + nOtherPoints, b) != otherPts + nOtherPoints)
+					{
+						if(m_output)
+							m_output[m_offsets[cellId] + count] = cells[j];
+						++count;
+					}
+				}
+			}
+			if(!m_output)
+				m_counts[cellId + 1] = count;
+		}
+	}
+
+private:
+	vtkPolyData* m_polydata;
+	vtkIdType* m_counts;
+	const vtkIdType* m_offsets;
+	vtkIdType* m_output;
+};
+}
+
+CCellAdjacency::CCellAdjacency()
+	: m_polydata(nullptr)
+	, m_dBuildTime(0.0)
+{
+}
+
+// two passes over the cells, the first counts the neighbours and the second writes them
+// into the rows, both passes are independent per cell and run with vtkSMPTools
+void CCellAdjacency::Build(vtkSmartPointer<vtkPolyData> polydata, bool parallel)
+{
+	const auto startTime = std::chrono::steady_clock::now();
+	Clear();
+	if(!polydata || polydata->GetNumberOfCells() == 0)
+		return;
+	m_polydata = polydata;
+
+	const vtkIdType numCells = polydata->GetNumberOfCells();
+	m_offsets.assign(numCells + 1, 0);
+	EdgeNeighborsFunctor counter(polydata, m_offsets.data(), nullptr, nullptr);
+	if(parallel)
+		vtkSMPTools::For(0, numCells, counter);
+	else
+		counter(0, numCells);
+	for(vtkIdType i = 0; i < numCells; ++i)
+		m_offsets[i+1] += m_offsets[i];
+
+	m_neighbors.resize(m_offsets[numCells]);
+	EdgeNeighborsFunctor writer(polydata, nullptr, m_offsets.data(), m_neighbors.data());
+	if(parallel)
+		vtkSMPTools::For(0, numCells, writer);
+	else
+		writer(0, numCells);
+
+	m_dBuildTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void CCellAdjacency::Clear()
+{
+	m_polydata = nullptr;
+	m_offsets.clear();
+	m_offsets.shrink_to_fit();
+	m_neighbors.clear();
+	m_neighbors.shrink_to_fit();
+	m_dBuildTime = 0.0;
+}
+
+bool CCellAdjacency::IsBuilt() const
+{
+	return m_polydata != nullptr;
+}
+
+vtkPolyData* CCellAdjacency::PolyData() const
+{
+	return m_polydata;
+}
+
+const vtkIdType* CCellAdjacency::GetNeighbors(vtkIdType cellId, vtkIdType& count) const
+{
+	count = m_offsets[cellId+1] - m_offsets[cellId];
+	return m_neighbors.data() + m_offsets[cellId];
+}
+
+double CCellAdjacency::BuildTime() const
+{
+	return m_dBuildTime;
+}
+
+std::size_t CCellAdjacency::MemorySize() const
+{
+	return sizeof(*this)
+		+ m_offsets.capacity() * sizeof(vtkIdType)
+		+ m_neighbors.capacity() * sizeof(vtkIdType);
+}
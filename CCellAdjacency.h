@@ -0,0 +1,35 @@
+#pragma once
+#include <vector>
+#include <vtkSmartPointer.h>
+#include <vtkType.h>
+
+class vtkPolyData;
+
+// *****
+// Edge adjacency of the cells of a polydata in compressed rows (CSR).
+// The neighbours of cell i are m_neighbors[m_offsets[i], m_offsets[i+1]), the cells sharing an edge with it.
+// Cells with less than three points have no edges, a non-manifold edge gives all the cells around it.
+// The point links of the polydata must be built (BuildLinks()) before Build().
+// *****
+class CCellAdjacency
+{
+public:
+	CCellAdjacency();
+
+	void Build(vtkSmartPointer<vtkPolyData> polydata, bool parallel = true);
+	void Clear();
+	bool IsBuilt() const;
+	vtkPolyData* PolyData() const;
+
+	// like vtkPolyData::GetCellPoints(), the pointer stays valid until the next Build() or Clear()
+	const vtkIdType* GetNeighbors(vtkIdType cellId, vtkIdType& count) const;
+
+	double BuildTime() const;
+	std::size_t MemorySize() const;
+
+private:
+	vtkSmartPointer<vtkPolyData> m_polydata;
+	std::vector<vtkIdType> m_offsets;
+	std::vector<vtkIdType> m_neighbors;
+	double m_dBuildTime;//seconds
+};
@@ -0,0 +1,182 @@
+#include "CCellBVH.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+#include <vtkPolyData.h>
+#include <vtkPoints.h>
+
+namespace
+{
+float FloatBelow(double x)
+{
+	float f = static_cast<float>(x);
+	return static_cast<double>(f) > x ? std::nextafter(f, -std::numeric_limits<float>::infinity()) : f;
+}
+
+float FloatAbove(double x)
+{
+	float f = static_cast<float>(x);
+	return static_cast<double>(f) < x ? std::nextafter(f, std::numeric_limits<float>::infinity()) : f;
+}
+}
+
+CCellBVH::CCellBVH()
+	: m_polydata(nullptr)
+	, m_dBuildTime(0.0)
+{
+}
+
+void CCellBVH::Build(vtkSmartPointer<vtkPolyData> polydata, int cellsPerLeaf)
+{
+	const auto startTime = std::chrono::steady_clock::now();
+	Clear();
+	if(!polydata || polydata->GetNumberOfCells() == 0 || !polydata->GetPoints())
+		return;
+	m_polydata = polydata;
+
+	const vtkIdType numCells = polydata->GetNumberOfCells();
+	std::vector<float> centers(3 * numCells);
+	std::vector<float> cellBounds(6 * numCells);
+	vtkPoints* points = polydata->GetPoints();
+	vtkIdType nPoints(0);
+	vtkIdType* pts(nullptr);
+	double x[3];
+	for(vtkIdType i = 0; i < numCells; ++i)
+	{
+		double bounds[6] = {VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX, VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX, VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX};
+		polydata->GetCellPoints(i, nPoints, pts);
+		for(vtkIdType k = 0; k < nPoints; ++k)
+		{
+			points->GetPoint(pts[k], x);
+			for(int j = 0; j < 3; ++j)
+			{
+				bounds[2*j] = std::min(bounds[2*j], x[j]);
+				bounds[2*j+1] = std::max(bounds[2*j+1], x[j]);
+			}
+		}
+		if(nPoints == 0)
+			std::fill(bounds, bounds + 6, 0.0);
+		for(int j = 0; j < 3; ++j)
+		{
+			cellBounds[6*i+2*j] = FloatBelow(bounds[2*j]);
+			cellBounds[6*i+2*j+1] = FloatAbove(bounds[2*j+1]);
+			centers[3*i+j] = static_cast<float>(0.5 * (bounds[2*j] + bounds[2*j+1]));
+		}
+	}
+
+	m_cellIds.resize(numCells);
+	std::iota(m_cellIds.begin(), m_cellIds.end(), 0);
+	m_nodes.reserve(static_cast<std::size_t>(2 * numCells / std::max(1, cellsPerLeaf) + 1));
+	BuildNode(0, numCells, std::max(1, cellsPerLeaf), centers, cellBounds);
+	m_nodes.shrink_to_fit();
+
+	m_dBuildTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+// split the range at the median center along the longest axis of the centers, return the node index
+vtkIdType CCellBVH::BuildNode(vtkIdType first, vtkIdType count, int cellsPerLeaf, const std::vector<float>& centers, const std::vector<float>& cellBounds)
+{
+	const vtkIdType nodeId = static_cast<vtkIdType>(m_nodes.size());
+	m_nodes.push_back(Node());
+	Node node;
+	node.first = first;
+	node.count = count;
+	node.right = -1;
+	float centerLower[3], centerUpper[3];
+	for(int j = 0; j < 3; ++j)
+	{
+		node.lower[j] = centerLower[j] = std::numeric_limits<float>::max();
+		node.upper[j] = centerUpper[j] = -std::numeric_limits<float>::max();
+	}
+	for(vtkIdType i = first; i < first + count; ++i)
+	{
+		const vtkIdType cellId = m_cellIds[i];
+		for(int j = 0; j < 3; ++j)
+		{
+			node.lower[j] = std::min(node.lower[j], cellBounds[6*cellId+2*j]);
+			node.upper[j] = std::max(node.upper[j], cellBounds[6*cellId+2*j+1]);
+			centerLower[j] = std::min(centerLower[j], centers[3*cellId+j]);
+			centerUpper[j] = std::max(centerUpper[j], centers[3*cellId+j]);
+		}
+	}
+
+	if(count > cellsPerLeaf)
+	{
+		int axis(0);
+		for(int j = 1; j < 3; ++j)
+		{
+			if(centerUpper[j] - centerLower[j] > centerUpper[axis] - centerLower[axis])
+				axis = j;
+		}
+		const vtkIdType half = count / 2;
+		std::nth_element(m_cellIds.begin() + first, m_cellIds.begin() + first + half, m_cellIds.begin() + first + count,
+			[&centers, axis](vtkIdType a, vtkIdType b) { return centers[3*a+axis] < centers[3*b+axis]; });
+		BuildNode(first, half, cellsPerLeaf, centers, cellBounds);
+		node.right = BuildNode(first + half, count - half, cellsPerLeaf, centers, cellBounds);
+	}
+	m_nodes[nodeId] = node;
+	return nodeId;
+}
+
+void CCellBVH::Clear()
+{
+	m_polydata = nullptr;
+	m_nodes.clear();
+	m_nodes.shrink_to_fit();
+	m_cellIds.clear();
+	m_cellIds.shrink_to_fit();
+	m_dBuildTime = 0.0;
+}
+
+bool CCellBVH::IsBuilt() const
+{
+	return m_polydata != nullptr;
+}
+
+vtkPolyData* CCellBVH::PolyData() const
+{
+	return m_polydata;
+}
+
+double CCellBVH::BuildTime() const
+{
+	return m_dBuildTime;
+}
+
+std::size_t CCellBVH::MemorySize() const
+{
+	return sizeof(*this)
+		+ m_nodes.capacity() * sizeof(Node)
+		+ m_cellIds.capacity() * sizeof(vtkIdType);
+}
+
+const std::vector<vtkIdType>& CCellBVH::OrderedCellIds() const
+{
+	return m_cellIds;
+}
+
+CCellBVH::Overlap CCellBVH::BoxOverlapPlanes(const double bounds[6], const std::vector<std::array<double, 4>>& planes)
+{
+	Overlap ret = Overlap::Inside;
+	for(const auto& plane : planes)
+	{
+		// the corners of the box farthest along and against the plane normal
+		double farthest = plane[3], nearest = plane[3];
+		for(int j = 0; j < 3; ++j)
+		{
+			const double lo = plane[j] * bounds[2*j];
+			const double hi = plane[j] * bounds[2*j+1];
+			farthest += std::max(lo, hi);
+			nearest += std::min(lo, hi);
+		}
+		if(farthest < 0.0)
+			return Overlap::Outside;
+		if(nearest < 0.0)
+			ret = Overlap::Partial;
+	}
+	return ret;
+}
@@ -0,0 +1,185 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+#include <vtkSmartPointer.h>
+#include <vtkType.h>
+
+class vtkPolyData;
+
+// *****
+// Bounding volume hierarchy over the cells of a polydata.
+// The nodes are stored in depth first order: the left child of node i is i+1 and every node
+// covers a contiguous range of m_cellIds, so a whole subtree can be accepted by copying its range.
+// Node bounds are kept in float and rounded outward, the tests against them stay conservative.
+// Rays traverse the nodes front to back and stop descending past the closest hit found so far.
+// *****
+class CCellBVH
+{
+public:
+	enum class Overlap
+	{
+		Outside,
+		Partial,
+		Inside
+	};
+
+	CCellBVH();
+
+	void Build(vtkSmartPointer<vtkPolyData> polydata, int cellsPerLeaf = 8);
+	void Clear();
+	bool IsBuilt() const;
+	vtkPolyData* PolyData() const;
+
+	double BuildTime() const;
+	std::size_t MemorySize() const;
+
+	// boxTest(const double bounds[6]) returns an Overlap for a node,
+	// cellTest(vtkIdType cellId) decides the cells of the partially covered leaves
+	template<class BoxTest, class CellTest>
+	void FindCells(BoxTest&& boxTest, CellTest&& cellTest, std::vector<vtkIdType>& outIds) const;
+
+	// the cells in leaf order, every leaf covers a contiguous range of it
+	const std::vector<vtkIdType>& OrderedCellIds() const;
+
+	// visits the leaves crossed by the ray origin + t * direction for t in [0, tMax), nearest entry first,
+	// leafHit(first, count, tMax) tests OrderedCellIds()[first, first + count) and lowers tMax on a closer hit,
+	// the leaves entered beyond tMax are skipped
+	template<class LeafHit>
+	void RayTraverse(const double origin[3], const double direction[3], double& tMax, LeafHit&& leafHit) const;
+
+	// planes are (a, b, c, d) with the inside at a*x+b*y+c*z+d >= 0
+	static Overlap BoxOverlapPlanes(const double bounds[6], const std::vector<std::array<double, 4>>& planes);
+
+private:
+	struct Node
+	{
+		float lower[3];
+		float upper[3];
+		vtkIdType first;
+		vtkIdType count;
+		vtkIdType right;//-1 for a leaf
+	};
+
+	// entry distance of the ray into the node, -1 when it misses the node before tMax
+	static double RayEntry(const Node& node, const double origin[3], const double inverse[3], double tMax);
+	vtkIdType BuildNode(vtkIdType first, vtkIdType count, int cellsPerLeaf, const std::vector<float>& centers, const std::vector<float>& cellBounds);
+
+private:
+	vtkSmartPointer<vtkPolyData> m_polydata;
+	std::vector<Node> m_nodes;
+	std::vector<vtkIdType> m_cellIds;
+	double m_dBuildTime;//seconds
+};
+
+template<class BoxTest, class CellTest>
+void CCellBVH::FindCells(BoxTest&& boxTest, CellTest&& cellTest, std::vector<vtkIdType>& outIds) const
+{
+	if(m_nodes.empty())
+		return;
+	std::vector<vtkIdType> stack;
+	stack.reserve(64);
+	stack.push_back(0);
+	double bounds[6];
+	while(!stack.empty())
+	{
+		const Node& node = m_nodes[stack.back()];
+		const vtkIdType nodeId = stack.back();
+		stack.pop_back();
+		for(int i = 0; i < 3; ++i)
+		{
+			bounds[2*i] = node.lower[i];
+			bounds[2*i+1] = node.upper[i];
+		}
+		const Overlap overlap = boxTest(static_cast<const double*>(bounds));
+		if(overlap == Overlap::Outside)
+			continue;
+		if(overlap == Overlap::Inside)
+		{
+			outIds.insert(outIds.end(), m_cellIds.cbegin() + node.first, m_cellIds.cbegin() + node.first + node.count);
+		}
+		else if(node.right < 0)
+		{
+			for(vtkIdType i = node.first; i < node.first + node.count; ++i)
+			{
+				if(cellTest(m_cellIds[i]))
+					outIds.push_back(m_cellIds[i]);
+			}
+		}
+		else
+		{
+			stack.push_back(node.right);
+			stack.push_back(nodeId + 1);
+		}
+	}
+}
+
+inline double CCellBVH::RayEntry(const Node& node, const double origin[3], const double inverse[3], double tMax)
+{
+	double tNear(0.0), tFar(tMax);
+	for(int j = 0; j < 3; ++j)
+	{
+		double t0 = (node.lower[j] - origin[j]) * inverse[j];
+		double t1 = (node.upper[j] - origin[j]) * inverse[j];
+		if(t0 > t1)
+			std::swap(t0, t1);
+		tNear = std::max(tNear, t0);
+		tFar = std::min(tFar, t1);
+	}
+	return tNear <= tFar ? tNear : -1.0;
+}
+
+template<class LeafHit>
+void CCellBVH::RayTraverse(const double origin[3], const double direction[3], double& tMax, LeafHit&& leafHit) const
+{
+	if(m_nodes.empty())
+		return;
+	// a huge finite inverse instead of infinity, 0 * inverse must not give NaN on a slab boundary
+	double inverse[3];
+	for(int j = 0; j < 3; ++j)
+		inverse[j] = direction[j] != 0.0 ? 1.0 / direction[j] : std::copysign(1e300, direction[j]);
+
+	// median splits keep the depth below 64 for any vtkIdType count of cells
+	vtkIdType stack[64];
+	double stackEntry[64];
+	int size(0);
+	const double rootEntry = RayEntry(m_nodes[0], origin, inverse, tMax);
+	if(rootEntry < 0.0)
+		return;
+	stack[size] = 0;
+	stackEntry[size++] = rootEntry;
+	while(size > 0)
+	{
+		--size;
+		const vtkIdType nodeId = stack[size];
+		if(stackEntry[size] > tMax)
+			continue;
+		const Node& node = m_nodes[nodeId];
+		if(node.right < 0)
+		{
+			leafHit(node.first, node.count, tMax);
+			continue;
+		}
+		const vtkIdType left = nodeId + 1;
+		vtkIdType nearChild = left, farChild = node.right;
+		double nearEntry = RayEntry(m_nodes[left], origin, inverse, tMax);
+		double farEntry = RayEntry(m_nodes[node.right], origin, inverse, tMax);
+		if(farEntry >= 0.0 && (nearEntry < 0.0 || farEntry < nearEntry))
+		{
+			std::swap(nearChild, farChild);
+			std::swap(nearEntry, farEntry);
+		}
+		// the farther child goes below the nearer one on the stack
+		if(farEntry >= 0.0)
+		{
+			stack[size] = farChild;
+			stackEntry[size++] = farEntry;
+		}
+		if(nearEntry >= 0.0)
+		{
+			stack[size] = nearChild;
+			stackEntry[size++] = nearEntry;
+		}
+	}
+}
@@ -0,0 +1,100 @@
+#include "CCenterMarkerLayer.h"
+
+#include <vtkPolyData.h>
+#include <vtkPoints.h>
+#include <vtkFloatArray.h>
+#include <vtkPointData.h>
+#include <vtkSphereSource.h>
+#include <vtkGlyph3DMapper.h>
+#include <vtkActor.h>
+#include <vtkProperty.h>
+
+CCenterMarkerLayer::CCenterMarkerLayer()
+	: m_points(vtkSmartPointer<vtkPoints>::New())
+	, m_scales(vtkSmartPointer<vtkFloatArray>::New())
+	, m_centers(vtkSmartPointer<vtkPolyData>::New())
+	, m_sphere(vtkSmartPointer<vtkSphereSource>::New())
+	, m_mapper(vtkSmartPointer<vtkGlyph3DMapper>::New())
+	, m_actor(vtkSmartPointer<vtkActor>::New())
+{
+	m_points->SetDataTypeToDouble();
+	m_scales->SetName("scales");
+	m_centers->SetPoints(m_points);
+	m_centers->GetPointData()->AddArray(m_scales);
+
+	// the vtkSphereSource default that createMultiPointsData() glyphs, the scale of a marker is its diameter
+	m_sphere->SetRadius(0.5);
+	SetResolution(12);
+
+	m_mapper->SetInputData(m_centers);
+	m_mapper->SetSourceConnection(m_sphere->GetOutputPort());
+	m_mapper->SetScaleArray("scales");
+	m_mapper->SetScaleModeToScaleByMagnitude();
+	m_mapper->SetScaleFactor(1.0);
+	m_mapper->ScalingOn();
+	m_mapper->OrientOff();
+	m_mapper->ScalarVisibilityOff();
+	m_actor->SetMapper(m_mapper);
+	m_actor->PickableOff();
+}
+
+vtkSmartPointer<vtkActor> CCenterMarkerLayer::Actor() const
+{
+	return m_actor;
+}
+
+vtkSmartPointer<vtkPolyData> CCenterMarkerLayer::Centers() const
+{
+	return m_centers;
+}
+
+void CCenterMarkerLayer::SetResolution(int resolution)
+{
+	m_sphere->SetThetaResolution(resolution);
+	m_sphere->SetPhiResolution(resolution);
+}
+
+void CCenterMarkerLayer::SetColor(double r, double g, double b)
+{
+	m_actor->GetProperty()->SetColor(r, g, b);
+}
+
+vtkIdType CCenterMarkerLayer::Append(const std::array<double, 3>& center, double scale)
+{
+	const vtkIdType ret = m_points->InsertNextPoint(center.data());
+	m_scales->InsertNextValue(static_cast<float>(scale));
+	Modified();
+	return ret;
+}
+
+void CCenterMarkerLayer::Assign(const std::vector<std::array<double, 3>>& centers, double scale)
+{
+	const vtkIdType count = static_cast<vtkIdType>(centers.size());
+	m_points->SetNumberOfPoints(count);
+	m_scales->SetNumberOfValues(count);
+	for(vtkIdType i = 0; i < count; ++i)
+	{
+		m_points->SetPoint(i, centers[i].data());
+		m_scales->SetValue(i, static_cast<float>(scale));
+	}
+	Modified();
+}
+
+void CCenterMarkerLayer::Clear()
+{
+	m_points->Reset();
+	m_scales->Reset();
+	Modified();
+}
+
+vtkIdType CCenterMarkerLayer::Count() const
+{
+	return m_points->GetNumberOfPoints();
+}
+
+void CCenterMarkerLayer::Modified()
+{
+	m_points->Modified();
+	m_scales->Modified();
+	m_centers->Modified();
+}
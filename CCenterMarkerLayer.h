@@ -0,0 +1,49 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <vtkSmartPointer.h>
+#include <vtkType.h>
+
+class vtkPolyData;
+class vtkPoints;
+class vtkFloatArray;
+class vtkSphereSource;
+class vtkGlyph3DMapper;
+class vtkActor;
+
+// *****
+// Sphere markers of the selection centers, drawn by a vtkGlyph3DMapper.
+// Only the centers and their scales are stored (one point and one float per marker), the sphere is uploaded
+// once and instanced on the GPU, so appending a marker appends a point instead of regenerating the merged
+// geometry of every marker like vtkGlyph3D does. A marker is drawn at the size createMultiPointsData() gives
+// it: a sphere of diameter scale. Add Actor() to a renderer once, the markers are not pickable.
+// *****
+class CCenterMarkerLayer
+{
+public:
+	CCenterMarkerLayer();
+
+	vtkSmartPointer<vtkActor> Actor() const;
+	vtkSmartPointer<vtkPolyData> Centers() const;//the instanced points, with the "scales" point data
+
+	void SetResolution(int resolution);//of the sphere, 12 by default
+	void SetColor(double r, double g, double b);
+
+	// amortized O(1), returns the marker index. scale is the diameter, twice the radius of a selection sphere
+	vtkIdType Append(const std::array<double, 3>& center, double scale);
+	// replaces every marker, e.g. by vtkAppendableSelection::SelectedCenters()
+	void Assign(const std::vector<std::array<double, 3>>& centers, double scale);
+	void Clear();
+	vtkIdType Count() const;
+
+private:
+	void Modified();
+
+private:
+	vtkSmartPointer<vtkPoints> m_points;
+	vtkSmartPointer<vtkFloatArray> m_scales;
+	vtkSmartPointer<vtkPolyData> m_centers;
+	vtkSmartPointer<vtkSphereSource> m_sphere;
+	vtkSmartPointer<vtkGlyph3DMapper> m_mapper;
+	vtkSmartPointer<vtkActor> m_actor;
+};
@@ -0,0 +1,333 @@
+#include "CContourChainer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace
+{
+std::size_t HashKey(const std::array<long long, 3>& key)
+{
+	std::uint64_t h = static_cast<std::uint64_t>(key[0]) * 0x9E3779B97F4A7C15ull;
+	h ^= static_cast<std::uint64_t>(key[1]) * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2);
+	h ^= static_cast<std::uint64_t>(key[2]) * 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+	h ^= h >> 29;
+	return static_cast<std::size_t>(h);
+}
+
+bool IsInsidePolygon(const std::vector<std::array<double, 2>>& polygon, double px, double py)
+{
+	bool inside(false);
+	const std::size_t n = polygon.size();
+	for(std::size_t i = 0, j = n - 1; i < n; j = i++)
+	{
+		const auto& a = polygon[i];
+		const auto& b = polygon[j];
+		if(((a[1] > py) != (b[1] > py)) && (px < (b[0] - a[0]) * (py - a[1]) / (b[1] - a[1]) + a[0]))
+			inside = !inside;
+	}
+	return inside;
+}
+}
+
+CContourChainer::CContourChainer()
+	: m_dTolerance(0.0)
+	, m_origin({0.0, 0.0, 0.0})
+{
+}
+
+void CContourChainer::SetTolerance(double tolerance)
+{
+	m_dTolerance = std::max(0.0, tolerance);
+}
+
+double CContourChainer::GetTolerance() const
+{
+	return m_dTolerance;
+}
+
+void CContourChainer::Reserve(std::size_t numSegments)
+{
+	m_segmentPoints.reserve(2 * numSegments);
+}
+
+void CContourChainer::AddSegment(const std::array<double, 3>& a, const std::array<double, 3>& b)
+{
+	m_segmentPoints.push_back(a);
+	m_segmentPoints.push_back(b);
+}
+
+std::size_t CContourChainer::NumberOfSegments() const
+{
+	return m_segmentPoints.size() / 2;
+}
+
+void CContourChainer::Clear()
+{
+	m_segmentPoints.clear();
+}
+
+vtkIdType CContourChainer::Lookup(const std::array<long long, 3>& key, std::size_t& slot) const
+{
+	const std::size_t mask = m_table.size() - 1;
+	for(slot = HashKey(key) & mask; m_table[slot] >= 0; slot = (slot + 1) & mask)
+	{
+		if(m_pointKeys[m_table[slot]] == key)
+			return m_table[slot];
+	}
+	return -1;
+}
+
+// the own cell of the point merges without distance test, the 26 neighbour cells only within tolerance
+vtkIdType CContourChainer::FindOrInsertPoint(const std::array<double, 3>& x, double tolerance)
+{
+	std::array<long long, 3> key;
+	for(int j = 0; j < 3; ++j)
+		key[j] = static_cast<long long>(std::floor((x[j] - m_origin[j]) / tolerance));
+	std::size_t slot(0);
+	const vtkIdType found = Lookup(key, slot);
+	if(found >= 0)
+		return found;
+
+	const double tolerance2 = tolerance * tolerance;
+	std::size_t neighborSlot(0);
+	for(int dz = -1; dz <= 1; ++dz)
+	{
+		for(int dy = -1; dy <= 1; ++dy)
+		{
+			for(int dx = -1; dx <= 1; ++dx)
+			{
+				if(dx == 0 && dy == 0 && dz == 0)
+					continue;
+				const vtkIdType neighbor = Lookup({key[0] + dx, key[1] + dy, key[2] + dz}, neighborSlot);
+				if(neighbor < 0)
+					continue;
+				const auto& y = m_points[neighbor];
+				if((x[0]-y[0])*(x[0]-y[0]) + (x[1]-y[1])*(x[1]-y[1]) + (x[2]-y[2])*(x[2]-y[2]) <= tolerance2)
+					return neighbor;
+			}
+		}
+	}
+
+	const vtkIdType ret = static_cast<vtkIdType>(m_points.size());
+	m_points.push_back(x);
+	m_pointKeys.push_back(key);
+	m_table[slot] = ret;
+	return ret;
+}
+
+std::vector<CContourChainer::Contour> CContourChainer::Chain(const std::array<double, 3>& normal)
+{
+	std::vector<Contour> ret;
+	const std::size_t numSegments = NumberOfSegments();
+	if(numSegments == 0)
+		return ret;
+
+	// quantization grid
+	std::array<double, 3> lower = m_segmentPoints.front(), upper = m_segmentPoints.front();
+	for(const auto& x : m_segmentPoints)
+	{
+		for(int j = 0; j < 3; ++j)
+		{
+			lower[j] = std::min(lower[j], x[j]);
+			upper[j] = std::max(upper[j], x[j]);
+		}
+	}
+	const double diagonal = std::sqrt((upper[0]-lower[0])*(upper[0]-lower[0]) + (upper[1]-lower[1])*(upper[1]-lower[1]) + (upper[2]-lower[2])*(upper[2]-lower[2]));
+	double tolerance = m_dTolerance > 0.0 ? m_dTolerance : 1e-9 * diagonal;
+	if(tolerance <= 0.0)
+		tolerance = 1.0;
+	m_origin = lower;
+	std::size_t tableSize(16);
+	while(tableSize < 4 * numSegments)
+		tableSize <<= 1;
+	m_table.assign(tableSize, -1);
+	m_points.clear();
+	m_pointKeys.clear();
+	m_points.reserve(numSegments + 1);
+	m_pointKeys.reserve(numSegments + 1);
+
+	std::vector<std::array<vtkIdType, 2>> segments;
+	segments.reserve(numSegments);
+	for(std::size_t s = 0; s < numSegments; ++s)
+	{
+		const vtkIdType a = FindOrInsertPoint(m_segmentPoints[2*s], tolerance);
+		const vtkIdType b = FindOrInsertPoint(m_segmentPoints[2*s+1], tolerance);
+		if(a != b)
+			segments.push_back({a, b});
+	}
+
+	// incident segments of every point in compressed rows
+	const vtkIdType numPoints = static_cast<vtkIdType>(m_points.size());
+	std::vector<vtkIdType> offsets(numPoints + 1, 0);
+	for(const auto& segment : segments)
+	{
+		++offsets[segment[0]+1];
+		++offsets[segment[1]+1];
+	}
+	for(vtkIdType p = 0; p < numPoints; ++p)
+		offsets[p+1] += offsets[p];
+	std::vector<vtkIdType> incident(offsets.back());
+	std::vector<vtkIdType> cursor(offsets.cbegin(), offsets.cend() - 1);
+	for(std::size_t s = 0; s < segments.size(); ++s)
+	{
+		incident[cursor[segments[s][0]]++] = static_cast<vtkIdType>(s);
+		incident[cursor[segments[s][1]]++] = static_cast<vtkIdType>(s);
+	}
+
+	// every segment is used once and the cursors only move forward, so the walks are linear in total
+	std::vector<char> used(segments.size(), 0);
+	cursor.assign(offsets.cbegin(), offsets.cend() - 1);
+	auto nextSegment = [&](vtkIdType p) -> vtkIdType
+	{
+		while(cursor[p] < offsets[p+1] && used[incident[cursor[p]]])
+			++cursor[p];
+		return cursor[p] < offsets[p+1] ? incident[cursor[p]] : -1;
+	};
+	auto walk = [&](vtkIdType start)
+	{
+		Contour contour;
+		contour.closed = false;
+		contour.hole = false;
+		contour.depth = 0;
+		contour.area = 0.0;
+		contour.points.push_back(m_points[start]);
+		vtkIdType p = start;
+		vtkIdType s(-1);
+		while((s = nextSegment(p)) >= 0)
+		{
+			used[s] = 1;
+			p = segments[s][0] == p ? segments[s][1] : segments[s][0];
+			if(p == start)
+			{
+				contour.closed = true;
+				break;
+			}
+			contour.points.push_back(m_points[p]);
+		}
+		if(contour.closed && contour.points.size() < 3)
+			return;//two segments between the same points
+		ret.push_back(std::move(contour));
+	};
+
+	// open polylines start and end at points of odd degree, what remains afterwards are closed loops
+	for(vtkIdType p = 0; p < numPoints; ++p)
+	{
+		if((offsets[p+1] - offsets[p]) % 2 == 1)
+		{
+			while(nextSegment(p) >= 0)
+				walk(p);
+		}
+	}
+	for(vtkIdType p = 0; p < numPoints; ++p)
+	{
+		while(nextSegment(p) >= 0)
+			walk(p);
+	}
+
+	Orient(ret, normal);
+	return ret;
+}
+
+// the depth of a loop is the number of other loops containing its first point,
+// tested against the bounding box of each loop before the point in polygon test
+void CContourChainer::Orient(std::vector<Contour>& contours, std::array<double, 3> normal) const
+{
+	if(normal[0] == 0.0 && normal[1] == 0.0 && normal[2] == 0.0)
+	{
+		for(const auto& contour : contours)
+		{
+			const std::size_t n = contour.points.size();
+			for(std::size_t i = 0; contour.closed && i < n; ++i)
+			{
+				const auto& a = contour.points[i];
+				const auto& b = contour.points[(i + 1) % n];
+				normal[0] += (a[1] - b[1]) * (a[2] + b[2]);
+				normal[1] += (a[2] - b[2]) * (a[0] + b[0]);
+				normal[2] += (a[0] - b[0]) * (a[1] + b[1]);
+			}
+		}
+		if(normal[0] == 0.0 && normal[1] == 0.0 && normal[2] == 0.0)
+			normal = {0.0, 0.0, 1.0};
+	}
+	const double length = std::sqrt(normal[0]*normal[0] + normal[1]*normal[1] + normal[2]*normal[2]);
+	for(auto& iter : normal)
+		iter /= length;
+
+	// in plane basis u, v with u x v = normal
+	int minAxis(0);
+	for(int j = 1; j < 3; ++j)
+	{
+		if(std::abs(normal[j]) < std::abs(normal[minAxis]))
+			minAxis = j;
+	}
+	std::array<double, 3> axis = {0.0, 0.0, 0.0};
+	axis[minAxis] = 1.0;
+	std::array<double, 3> u = {normal[1]*axis[2] - normal[2]*axis[1], normal[2]*axis[0] - normal[0]*axis[2], normal[0]*axis[1] - normal[1]*axis[0]};
+	const double uLength = std::sqrt(u[0]*u[0] + u[1]*u[1] + u[2]*u[2]);
+	for(auto& iter : u)
+		iter /= uLength;
+	const std::array<double, 3> v = {normal[1]*u[2] - normal[2]*u[1], normal[2]*u[0] - normal[0]*u[2], normal[0]*u[1] - normal[1]*u[0]};
+
+	const std::size_t numContours = contours.size();
+	std::vector<std::vector<std::array<double, 2>>> polygons(numContours);
+	std::vector<std::array<double, 4>> bounds(numContours);
+	std::vector<double> signedArea(numContours, 0.0);
+	for(std::size_t c = 0; c < numContours; ++c)
+	{
+		if(!contours[c].closed)
+			continue;
+		auto& polygon = polygons[c];
+		polygon.reserve(contours[c].points.size());
+		bounds[c] = {VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX, VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX};
+		for(const auto& x : contours[c].points)
+		{
+			const std::array<double, 2> p = {u[0]*x[0] + u[1]*x[1] + u[2]*x[2], v[0]*x[0] + v[1]*x[1] + v[2]*x[2]};
+			bounds[c] = {std::min(bounds[c][0], p[0]), std::max(bounds[c][1], p[0]), std::min(bounds[c][2], p[1]), std::max(bounds[c][3], p[1])};
+			polygon.push_back(p);
+		}
+		const std::size_t n = polygon.size();
+		for(std::size_t i = 0; i < n; ++i)
+		{
+			const auto& a = polygon[i];
+			const auto& b = polygon[(i + 1) % n];
+			signedArea[c] += a[0] * b[1] - b[0] * a[1];
+		}
+		signedArea[c] *= 0.5;
+	}
+
+	for(std::size_t c = 0; c < numContours; ++c)
+	{
+		if(!contours[c].closed)
+			continue;
+		const auto& p = polygons[c].front();
+		int depth(0);
+		for(std::size_t other = 0; other < numContours; ++other)
+		{
+			if(other == c || !contours[other].closed)
+				continue;
+			const auto& b = bounds[other];
+			if(p[0] < b[0] || p[0] > b[1] || p[1] < b[2] || p[1] > b[3])
+				continue;
+			if(IsInsidePolygon(polygons[other], p[0], p[1]))
+				++depth;
+		}
+		contours[c].depth = depth;
+		contours[c].hole = depth % 2 == 1;
+		contours[c].area = std::abs(signedArea[c]);
+		if(signedArea[c] != 0.0 && (signedArea[c] > 0.0) == contours[c].hole)
+			std::reverse(contours[c].points.begin(), contours[c].points.end());
+	}
+}
+
+const CContourChainer::Contour* CContourChainer::LargestContour(const std::vector<Contour>& contours)
+{
+	const Contour* ret(nullptr);
+	for(const auto& contour : contours)
+	{
+		if(!ret || (contour.closed && !ret->closed)
+			|| (contour.closed == ret->closed && (contour.closed ? contour.area > ret->area : contour.points.size() > ret->points.size())))
+			ret = &contour;
+	}
+	return ret;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <vtkType.h>
+
+// *****
+// Chains unordered line segments into closed loops and open polylines in O(segments).
+// End points are merged through a flat hash of their coordinates quantized to the tolerance
+// (neighbour cells included), so coincident end points of different segments join without a cleaning pass.
+// The direction of the input segments does not matter. Every closed loop gets its nesting depth among the
+// other loops: even depths are outer loops returned counter clockwise seen from the normal, odd depths are holes
+// returned clockwise.
+// *****
+class CContourChainer
+{
+public:
+	struct Contour
+	{
+		std::vector<std::array<double, 3>> points;//the first point is not repeated at the end of a closed contour
+		bool closed;
+		bool hole;
+		int depth;//number of closed loops around this one, 0 for open polylines
+		double area;//enclosed area of a closed loop, 0 for open polylines
+	};
+
+	CContourChainer();
+
+	// absolute merge distance of the end points, 0 uses 1e-9 of the diagonal of the segments bounds
+	void SetTolerance(double tolerance);
+	double GetTolerance() const;
+
+	void Reserve(std::size_t numSegments);
+	void AddSegment(const std::array<double, 3>& a, const std::array<double, 3>& b);
+	std::size_t NumberOfSegments() const;
+	void Clear();
+
+	// normal orients the loops, a zero normal uses the Newell normal of all the loops
+	std::vector<Contour> Chain(const std::array<double, 3>& normal = {0.0, 0.0, 0.0});
+
+	// the closed loop of largest area, or the longest open polyline when nothing is closed
+	static const Contour* LargestContour(const std::vector<Contour>& contours);
+
+private:
+	vtkIdType Lookup(const std::array<long long, 3>& key, std::size_t& slot) const;
+	vtkIdType FindOrInsertPoint(const std::array<double, 3>& x, double tolerance);
+	void Orient(std::vector<Contour>& contours, std::array<double, 3> normal) const;
+
+private:
+	double m_dTolerance;
+	std::array<double, 3> m_origin;//of the quantization grid
+	std::vector<std::array<double, 3>> m_segmentPoints;//two per segment
+	std::vector<std::array<double, 3>> m_points;
+	std::vector<std::array<long long, 3>> m_pointKeys;
+	std::vector<vtkIdType> m_table;//open addressing, point index or -1
+};
@@ -0,0 +1,70 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <vtkType.h>
+
+// *****
+// Reusable membership mask over the ids [0, Size()).
+// Each mark is stamped with the current epoch, so NextEpoch() empties the whole mask in O(1).
+// The stamps are only rewritten when the epoch counter wraps around.
+// *****
+class CEpochMask
+{
+public:
+	CEpochMask()
+		: m_epoch(1)
+	{
+	}
+
+	void Resize(vtkIdType n)
+	{
+		m_stamps.resize(static_cast<std::size_t>(n), 0);
+	}
+
+	vtkIdType Size() const
+	{
+		return static_cast<vtkIdType>(m_stamps.size());
+	}
+
+	void NextEpoch()
+	{
+		if(++m_epoch == 0)
+		{
+			std::fill(m_stamps.begin(), m_stamps.end(), 0);
+			m_epoch = 1;
+		}
+	}
+
+	void Mark(vtkIdType id)
+	{
+		m_stamps[id] = m_epoch;
+	}
+
+	void Unmark(vtkIdType id)
+	{
+		m_stamps[id] = 0;
+	}
+
+	bool IsMarked(vtkIdType id) const
+	{
+		return m_stamps[id] == m_epoch;
+	}
+
+	// return true if id was not marked yet
+	bool TestAndMark(vtkIdType id)
+	{
+		if(m_stamps[id] == m_epoch)
+			return false;
+		m_stamps[id] = m_epoch;
+		return true;
+	}
+
+	std::size_t MemorySize() const
+	{
+		return m_stamps.capacity() * sizeof(unsigned int);
+	}
+
+private:
+	std::vector<unsigned int> m_stamps;
+	unsigned int m_epoch;
+};
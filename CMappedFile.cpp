@@ -0,0 +1,131 @@
+#include "CMappedFile.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+CMappedFile::CMappedFile()
+#ifdef _WIN32
+	: m_file(INVALID_HANDLE_VALUE)
+	, m_mapping(nullptr)
+#else
+	: m_file(-1)
+#endif
+	, m_data(nullptr)
+	, m_size(0)
+	, m_bOpen(false)
+{
+}
+
+CMappedFile::~CMappedFile()
+{
+	Close();
+}
+
+bool CMappedFile::Open(const std::string& path)
+{
+	Close();
+#ifdef _WIN32
+	const int length = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+	std::wstring widePath(length > 0 ? length : 1, L'\0');
+	MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &widePath[0], length);
+	m_file = CreateFileW(widePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if(m_file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	if(!GetFileSizeEx(m_file, &size))
+	{
+		Close();
+		return false;
+	}
+	m_size = static_cast<std::uint64_t>(size.QuadPart);
+	if(m_size > 0)
+	{
+		m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if(!m_mapping)
+		{
+			Close();
+			return false;
+		}
+		m_data = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+		if(!m_data)
+		{
+			Close();
+			return false;
+		}
+	}
+#else
+	m_file = ::open(path.c_str(), O_RDONLY);
+	if(m_file < 0)
+		return false;
+	struct stat status;
+	if(::fstat(m_file, &status) != 0)
+	{
+		Close();
+		return false;
+	}
+	m_size = static_cast<std::uint64_t>(status.st_size);
+	if(m_size > 0)
+	{
+		void* data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_file, 0);
+		if(data == MAP_FAILED)
+		{
+			Close();
+			return false;
+		}
+		::madvise(data, m_size, MADV_SEQUENTIAL);
+		m_data = static_cast<const char*>(data);
+	}
+#endif
+	m_bOpen = true;
+	return true;
+}
+
+void CMappedFile::Close()
+{
+#ifdef _WIN32
+	if(m_data)
+		UnmapViewOfFile(m_data);
+	if(m_mapping)
+		CloseHandle(m_mapping);
+	if(m_file != INVALID_HANDLE_VALUE)
+		CloseHandle(m_file);
+	m_mapping = nullptr;
+	m_file = INVALID_HANDLE_VALUE;
+#else
+	if(m_data)
+		::munmap(const_cast<char*>(m_data), m_size);
+	if(m_file >= 0)
+		::close(m_file);
+	m_file = -1;
+#endif
+	m_data = nullptr;
+	m_size = 0;
+	m_bOpen = false;
+}
+
+bool CMappedFile::IsOpen() const
+{
+	return m_bOpen;
+}
+
+const char* CMappedFile::Data() const
+{
+	return m_data;
+}
+
+std::uint64_t CMappedFile::Size() const
+{
+	return m_size;
+}
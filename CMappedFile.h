@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// *****
+// Read only memory mapping of a whole file, the pages are loaded by the system on first access
+// and shared with the file cache, so opening a large file neither reads nor copies it.
+// The path is UTF-8.
+// *****
+class CMappedFile
+{
+public:
+	CMappedFile();
+	~CMappedFile();
+	CMappedFile(const CMappedFile&) = delete;
+	CMappedFile& operator=(const CMappedFile&) = delete;
+
+	bool Open(const std::string& path);
+	void Close();
+	bool IsOpen() const;
+
+	const char* Data() const;//nullptr for an empty file
+	std::uint64_t Size() const;
+
+private:
+#ifdef _WIN32
+	void* m_file;
+	void* m_mapping;
+#else
+	int m_file;
+#endif
+	const char* m_data;
+	std::uint64_t m_size;
+	bool m_bOpen;
+};
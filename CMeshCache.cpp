@@ -0,0 +1,278 @@
+#include "CMeshCache.h"
+#include "CMappedFile.h"
+#include "CMeshFile.h"
+#include "CMeshNormals.h"
+#include "CMeshWelder.h"
+#include "CPointGridIndex.h"
+#include "CStlReader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <vtkPolyData.h>
+#include <vtkPoints.h>
+#include <vtkCellArray.h>
+#include <vtkPointData.h>
+#include <vtkCellData.h>
+#include <vtkAbstractArray.h>
+#include <vtkSMPTools.h>
+
+namespace
+{
+const char* KeySection = "key";
+const char* IndexSection = "pointIndex";
+const std::uint64_t HashChunkSize = std::uint64_t(1) << 20;
+const std::uint64_t Prime1 = 0x9E3779B185EBCA87ULL;
+const std::uint64_t Prime2 = 0xC2B2AE3D27D4EB4FULL;
+
+std::uint64_t rotateLeft(std::uint64_t value, int bits)
+{
+	return (value << bits) | (value >> (64 - bits));
+}
+
+std::uint64_t mix(std::uint64_t hash)
+{
+	hash ^= hash >> 33;
+	hash *= Prime2;
+	hash ^= hash >> 29;
+	hash *= Prime1;
+	return hash ^ (hash >> 32);
+}
+
+// four independent multiply-rotate lanes over 8 byte words, a fingerprint of the content and not a secure hash
+std::uint64_t hashChunk(const char* data, std::uint64_t size, std::uint64_t seed)
+{
+	std::uint64_t lanes[4] = {seed + Prime1, seed + Prime2, seed, seed - Prime1};
+	std::uint64_t i(0);
+	for(; i + 32 <= size; i += 32)
+	{
+		for(int l = 0; l < 4; ++l)
+		{
+			std::uint64_t word;
+			std::memcpy(&word, data + i + 8 * l, sizeof(word));
+			lanes[l] = rotateLeft(lanes[l] + word * Prime2, 31) * Prime1;
+		}
+	}
+	std::uint64_t ret = rotateLeft(lanes[0], 1) + rotateLeft(lanes[1], 7) + rotateLeft(lanes[2], 12) + rotateLeft(lanes[3], 18);
+	for(; i < size; ++i)
+		ret = rotateLeft(ret ^ (static_cast<unsigned char>(data[i]) * Prime1), 11) * Prime2;
+	return mix(ret ^ size);
+}
+
+// chunks hashed in parallel and combined in file order, the result does not depend on the thread count
+std::uint64_t contentHash(const char* data, std::uint64_t size, bool parallel)
+{
+	const vtkIdType numChunks = static_cast<vtkIdType>((size + HashChunkSize - 1) / HashChunkSize);
+	std::vector<std::uint64_t> chunkHashes(numChunks);
+	auto functor = [data, size, &chunkHashes](vtkIdType begin, vtkIdType end)
+	{
+		for(vtkIdType c = begin; c < end; ++c)
+		{
+			const std::uint64_t offset = HashChunkSize * c;
+			chunkHashes[c] = hashChunk(data + offset, std::min(HashChunkSize, size - offset), static_cast<std::uint64_t>(c));
+		}
+	};
+	if(parallel && numChunks > 1)
+		vtkSMPTools::For(0, numChunks, 1, functor);
+	else
+		functor(0, numChunks);
+
+	std::uint64_t ret(size);
+	for(const auto chunkHash : chunkHashes)
+		ret = mix(rotateLeft(ret, 27) ^ chunkHash);
+	return ret;
+}
+}
+
+CMeshCache::CMeshCache()
+	: m_bCacheHit(false)
+	, m_bCanceled(false)
+	, m_dHashTime(0.0)
+	, m_dLoadTime(0.0)
+{
+}
+
+void CMeshCache::SetParameters(const Parameters& parameters)
+{
+	m_parameters = parameters;
+}
+
+const CMeshCache::Parameters& CMeshCache::GetParameters() const
+{
+	return m_parameters;
+}
+
+void CMeshCache::SetProgressCallback(ProgressCallback callback)
+{
+	m_progressCallback = std::move(callback);
+}
+
+bool CMeshCache::ReportProgress(double fraction)
+{
+	if(m_progressCallback && !m_progressCallback(fraction))
+		m_bCanceled = true;
+	return !m_bCanceled;
+}
+
+std::string CMeshCache::SidecarPath(const std::string& stlPath)
+{
+	return stlPath + ".meshcache";
+}
+
+vtkSmartPointer<vtkPolyData> CMeshCache::Load(const std::string& stlPath, CStlReader& reader, CPointGridIndex* index)
+{
+	const auto startTime = std::chrono::steady_clock::now();
+	m_errorMessage.clear();
+	m_bCacheHit = false;
+	m_bCanceled = false;
+	m_dHashTime = 0.0;
+	m_dLoadTime = 0.0;
+
+	Key key;
+	if(!ComputeKey(stlPath, reader.GetParallel(), key))
+	{
+		m_errorMessage = "cannot open " + stlPath;
+		return nullptr;
+	}
+	const std::string sidecarPath = SidecarPath(stlPath);
+	auto ret = ReadSidecar(sidecarPath, key, index);
+	m_bCacheHit = ret != nullptr;
+	if(!ret)
+	{
+		ret = reader.Read(stlPath);
+		if(!ret)
+		{
+			m_bCanceled = reader.WasCanceled();
+			m_errorMessage = reader.ErrorMessage();
+			return nullptr;
+		}
+		// the normals take most of the preprocessing, then the index and the sidecar
+		if(m_parameters.normals)
+		{
+			CMeshNormals normals;
+			normals.SetParallel(reader.GetParallel());
+			normals.SetProgressCallback([this](double fraction) { return ReportProgress(0.6 * fraction); });
+			normals.Compute(ret);
+		}
+		CPointGridIndex pointIndex;
+		if(ReportProgress(0.6) && m_parameters.pointsPerBucket > 0)
+			pointIndex.Build(ret->GetPoints(), m_parameters.pointsPerBucket);
+		if(!ReportProgress(0.8))
+		{
+			m_errorMessage = "preprocessing " + stlPath + " was canceled";
+			return nullptr;
+		}
+		// the cache is only an accelerator, a sidecar that cannot be written is not an error
+		WriteSidecar(sidecarPath, key, ret, pointIndex);
+		if(index)
+			*index = std::move(pointIndex);
+	}
+	m_dLoadTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	return ret;
+}
+
+bool CMeshCache::ComputeKey(const std::string& stlPath, bool parallel, Key& key)
+{
+	const auto startTime = std::chrono::steady_clock::now();
+	CMappedFile file;
+	if(!file.Open(stlPath))
+		return false;
+	key = {};
+	key.version = Version;
+	key.pointsPerBucket = m_parameters.pointsPerBucket;
+	key.normals = m_parameters.normals ? 1 : 0;
+	key.contentHash = contentHash(file.Data(), file.Size(), parallel);
+	key.contentSize = file.Size();
+	m_dHashTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	return true;
+}
+
+vtkSmartPointer<vtkPolyData> CMeshCache::ReadSidecar(const std::string& sidecarPath, const Key& key, CPointGridIndex* index) const
+{
+	CMeshFileReader reader;
+	if(!reader.Open(sidecarPath))
+		return nullptr;
+	const auto keySection = reader.FindSection(CMeshFile::BLOB, KeySection);
+	if(!keySection || keySection->size != sizeof(Key) || std::memcmp(reader.SectionData(*keySection), &key, sizeof(Key)) != 0)
+		return nullptr;
+	// ReadPolyData() rejects cells out of the section or of the points, the sidecar must also hold the welded
+	// triangles only and attributes of the right length, anything else is rebuilt from the STL
+	auto ret = reader.ReadPolyData();
+	if(!ret || !ret->GetPoints() || !CMeshWelder::IsTriangleMesh(ret))
+		return nullptr;
+	for(int i = 0; i < ret->GetPointData()->GetNumberOfArrays(); ++i)
+	{
+		if(ret->GetPointData()->GetAbstractArray(i)->GetNumberOfTuples() != ret->GetNumberOfPoints())
+			return nullptr;
+	}
+	for(int i = 0; i < ret->GetCellData()->GetNumberOfArrays(); ++i)
+	{
+		if(ret->GetCellData()->GetAbstractArray(i)->GetNumberOfTuples() != ret->GetNumberOfCells())
+			return nullptr;
+	}
+	if(index)
+	{
+		const auto indexSection = reader.FindSection(CMeshFile::BLOB, IndexSection);
+		if(!indexSection || !index->Deserialize(ret->GetPoints(), reader.SectionData(*indexSection), indexSection->size))
+		{
+			// written by a build with another vtkIdType or without index, or corrupted
+			if(m_parameters.pointsPerBucket > 0)
+				index->Build(ret->GetPoints(), m_parameters.pointsPerBucket);
+			else
+				index->Clear();
+		}
+	}
+	return ret;
+}
+
+bool CMeshCache::WriteSidecar(const std::string& sidecarPath, const Key& key, vtkPolyData* polydata, const CPointGridIndex& index) const
+{
+	const std::string temporaryPath = sidecarPath + ".tmp";
+	CMeshFileWriter writer;
+	bool ret = writer.Open(temporaryPath)
+		&& writer.WriteBlob(KeySection, &key, sizeof(key))
+		&& writer.WritePolyData(polydata);
+	if(ret && index.IsBuilt())
+	{
+		const std::vector<char> serialized = index.Serialize();
+		ret = writer.WriteBlob(IndexSection, serialized.data(), serialized.size());
+	}
+	ret = writer.Close() && ret;
+	if(ret)
+	{
+		// rename does not replace an existing file everywhere
+		std::remove(sidecarPath.c_str());
+		ret = std::rename(temporaryPath.c_str(), sidecarPath.c_str()) == 0;
+	}
+	if(!ret)
+		std::remove(temporaryPath.c_str());
+	return ret;
+}
+
+const std::string& CMeshCache::ErrorMessage() const
+{
+	return m_errorMessage;
+}
+
+bool CMeshCache::WasCacheHit() const
+{
+	return m_bCacheHit;
+}
+
+bool CMeshCache::WasCanceled() const
+{
+	return m_bCanceled;
+}
+
+double CMeshCache::HashTime() const
+{
+	return m_dHashTime;
+}
+
+double CMeshCache::LoadTime() const
+{
+	return m_dLoadTime;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vtkSmartPointer.h>
+
+class vtkPolyData;
+class CStlReader;
+class CPointGridIndex;
+
+// *****
+// Preprocessed mesh sidecar of an STL file: the welded points, the connectivity, the point normals and the
+// serialized CPointGridIndex are stored in a CMeshFile next to the STL, so reopening the file maps the sidecar
+// and copies the arrays instead of parsing, welding and indexing again.
+// The sidecar is keyed by a hash of the STL content, its size, the cache version and the preprocessing
+// parameters, any difference rebuilds it. It is written to a temporary file renamed at the end, an interrupted
+// write never leaves a sidecar that looks valid.
+// *****
+class CMeshCache
+{
+public:
+	struct Parameters
+	{
+		bool normals = true;//CMeshNormals point normals
+		int pointsPerBucket = 4;//of the point index, 0 stores no index
+	};
+
+	// fraction of the preprocessing after the read in [0, 1], return false to cancel
+	using ProgressCallback = std::function<bool(double fraction)>;
+
+	static const std::uint32_t Version = 1;
+
+	CMeshCache();
+
+	void SetParameters(const Parameters& parameters);
+	const Parameters& GetParameters() const;
+	// called during the normals and between the preprocessing steps, a canceled Load() writes no sidecar
+	void SetProgressCallback(ProgressCallback callback);
+
+	static std::string SidecarPath(const std::string& stlPath);
+
+	// the mesh of the sidecar when it matches, otherwise read by reader (its callbacks and parallel setting apply),
+	// preprocessed and written to the sidecar; index, when not nullptr, receives the point index over the mesh points.
+	// nullptr when the STL cannot be read, see ErrorMessage()
+	vtkSmartPointer<vtkPolyData> Load(const std::string& stlPath, CStlReader& reader, CPointGridIndex* index = nullptr);
+
+	const std::string& ErrorMessage() const;
+	bool WasCacheHit() const;
+	bool WasCanceled() const;//by the reader or the progress callback
+	double HashTime() const;//seconds spent hashing the STL
+	double LoadTime() const;//seconds spent in the last Load()
+
+private:
+	struct Key
+	{
+		std::uint32_t version;
+		std::int32_t pointsPerBucket;
+		std::uint32_t normals;
+		std::uint32_t reserved;
+		std::uint64_t contentHash;
+		std::uint64_t contentSize;
+	};
+
+	bool ReportProgress(double fraction);
+	bool ComputeKey(const std::string& stlPath, bool parallel, Key& key);
+	vtkSmartPointer<vtkPolyData> ReadSidecar(const std::string& sidecarPath, const Key& key, CPointGridIndex* index) const;
+	bool WriteSidecar(const std::string& sidecarPath, const Key& key, vtkPolyData* polydata, const CPointGridIndex& index) const;
+
+private:
+	Parameters m_parameters;
+	ProgressCallback m_progressCallback;
+	std::string m_errorMessage;
+	bool m_bCacheHit;
+	bool m_bCanceled;
+	double m_dHashTime;
+	double m_dLoadTime;
+};
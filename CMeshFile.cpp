@@ -0,0 +1,394 @@
+#include "CMeshFile.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <vtkPolyData.h>
+#include <vtkPoints.h>
+#include <vtkCellArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkIdList.h>
+#include <vtkDataArray.h>
+#include <vtkPointData.h>
+#include <vtkCellData.h>
+
+namespace
+{
+struct FileHeader
+{
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t sectionCount;
+	std::uint64_t tableOffset;
+};
+static_assert(sizeof(FileHeader) == 24, "the header layout is part of the file format");
+static_assert(sizeof(CMeshFile::Section) == 80, "the section layout is part of the file format");
+
+const char Magic[8] = {'V', 'S', 'T', 'L', 'M', 'E', 'S', 'H'};
+const std::uint64_t Alignment = 64;
+const std::uint64_t WriteBlockSize = std::uint64_t(64) << 20;
+const std::size_t StreamBufferSize = std::size_t(4) << 20;
+
+std::string sectionName(const CMeshFile::Section& section)
+{
+	return std::string(section.name, std::find(section.name, section.name + sizeof(section.name), '\0'));
+}
+
+// copies count ids stored on elementSize bytes, the file may come from a build with another vtkIdType
+bool copyIds(const void* data, std::uint32_t elementSize, std::uint64_t count, vtkIdType* ids)
+{
+	if(elementSize == sizeof(vtkIdType))
+	{
+		std::memcpy(ids, data, count * sizeof(vtkIdType));
+		return true;
+	}
+	if(elementSize == sizeof(std::int32_t))
+	{
+		const std::int32_t* values = static_cast<const std::int32_t*>(data);
+		std::copy(values, values + count, ids);
+		return true;
+	}
+	if(elementSize == sizeof(std::int64_t))
+	{
+		const std::int64_t* values = static_cast<const std::int64_t*>(data);
+		for(std::uint64_t i = 0; i < count; ++i)
+			ids[i] = static_cast<vtkIdType>(values[i]);
+		return true;
+	}
+	return false;
+}
+}
+
+CMeshFileWriter::CMeshFileWriter()
+	: m_position(0)
+	, m_bFailed(false)
+{
+}
+
+CMeshFileWriter::~CMeshFileWriter()
+{
+	if(m_stream.is_open())
+		Close();
+}
+
+bool CMeshFileWriter::Open(const std::string& path)
+{
+	if(m_stream.is_open())
+		Close();
+	m_sections.clear();
+	m_bFailed = false;
+	m_buffer.resize(StreamBufferSize);
+	m_stream.rdbuf()->pubsetbuf(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+	m_stream.open(path, std::ios::binary | std::ios::trunc);
+	if(!m_stream.is_open())
+		return false;
+	// the header is written again with the table offset on Close()
+	const FileHeader header = {};
+	m_stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	m_position = sizeof(header);
+	return m_stream.good();
+}
+
+bool CMeshFileWriter::WriteSection(CMeshFile::Section section, const std::string& name, const void* data)
+{
+	if(!m_stream.is_open() || m_bFailed)
+		return false;
+	const char padding[Alignment] = {};
+	const std::uint64_t aligned = (m_position + Alignment - 1) / Alignment * Alignment;
+	m_stream.write(padding, static_cast<std::streamsize>(aligned - m_position));
+	m_position = aligned;
+
+	section.offset = m_position;
+	std::memset(section.name, 0, sizeof(section.name));
+	std::memcpy(section.name, name.data(), std::min(name.size(), sizeof(section.name) - 1));
+	// large blocks go around the stream buffer straight to the file
+	const char* bytes = static_cast<const char*>(data);
+	for(std::uint64_t written = 0; written < section.size && m_stream.good();)
+	{
+		const std::uint64_t block = std::min(WriteBlockSize, section.size - written);
+		m_stream.write(bytes + written, static_cast<std::streamsize>(block));
+		written += block;
+	}
+	m_position += section.size;
+	m_bFailed = !m_stream.good();
+	if(!m_bFailed)
+		m_sections.push_back(section);
+	return !m_bFailed;
+}
+
+bool CMeshFileWriter::WriteArray(std::uint32_t kind, vtkDataArray* array, int attribute)
+{
+	if(!array)
+		return true;
+	CMeshFile::Section section = {};
+	section.kind = kind;
+	section.dataType = array->GetDataType();
+	section.components = static_cast<std::uint32_t>(array->GetNumberOfComponents());
+	section.elementSize = static_cast<std::uint32_t>(array->GetDataTypeSize());
+	section.tuples = static_cast<std::uint64_t>(array->GetNumberOfTuples());
+	section.size = section.tuples * section.components * section.elementSize;
+	section.attribute = attribute;
+	const char* name = array->GetName();
+	return WriteSection(section, name ? name : "", section.size > 0 ? array->GetVoidPointer(0) : nullptr);
+}
+
+bool CMeshFileWriter::WriteCells(std::uint32_t kind, vtkCellArray* cells)
+{
+	if(!cells || cells->GetNumberOfCells() == 0)
+		return true;
+	CMeshFile::Section section = {};
+	section.kind = kind;
+	section.dataType = VTK_ID_TYPE;
+	section.components = 1;
+	section.elementSize = sizeof(vtkIdType);
+	section.tuples = static_cast<std::uint64_t>(cells->GetNumberOfCells());
+	section.size = static_cast<std::uint64_t>(cells->GetNumberOfConnectivityEntries()) * sizeof(vtkIdType);
+	section.attribute = -1;
+	return WriteSection(section, "", cells->GetPointer());
+}
+
+bool CMeshFileWriter::WriteAttributes(std::uint32_t kind, vtkDataSetAttributes* attributes)
+{
+	bool ret = true;
+	for(int i = 0; ret && i < attributes->GetNumberOfArrays(); ++i)
+	{
+		// string and variant arrays have no contiguous values and are not written
+		ret = WriteArray(kind, attributes->GetArray(i), attributes->IsArrayAnAttribute(i));
+	}
+	return ret;
+}
+
+bool CMeshFileWriter::WritePolyData(vtkPolyData* polydata)
+{
+	if(!polydata)
+		return false;
+	return WriteArray(CMeshFile::POINTS, polydata->GetPoints() ? polydata->GetPoints()->GetData() : nullptr, -1)
+		&& WriteCells(CMeshFile::VERTS, polydata->GetVerts())
+		&& WriteCells(CMeshFile::LINES, polydata->GetLines())
+		&& WriteCells(CMeshFile::POLYS, polydata->GetPolys())
+		&& WriteCells(CMeshFile::STRIPS, polydata->GetStrips())
+		&& WriteAttributes(CMeshFile::POINT_DATA, polydata->GetPointData())
+		&& WriteAttributes(CMeshFile::CELL_DATA, polydata->GetCellData());
+}
+
+bool CMeshFileWriter::WriteIdList(const std::string& name, vtkIdList* ids)
+{
+	if(!ids)
+		return false;
+	CMeshFile::Section section = {};
+	section.kind = CMeshFile::ID_LIST;
+	section.dataType = VTK_ID_TYPE;
+	section.components = 1;
+	section.elementSize = sizeof(vtkIdType);
+	section.tuples = static_cast<std::uint64_t>(ids->GetNumberOfIds());
+	section.size = section.tuples * sizeof(vtkIdType);
+	section.attribute = -1;
+	return WriteSection(section, name, ids->GetPointer(0));
+}
+
+bool CMeshFileWriter::WriteBlob(const std::string& name, const void* data, std::uint64_t size)
+{
+	CMeshFile::Section section = {};
+	section.kind = CMeshFile::BLOB;
+	section.dataType = VTK_CHAR;
+	section.components = 1;
+	section.elementSize = 1;
+	section.tuples = size;
+	section.size = size;
+	section.attribute = -1;
+	return WriteSection(section, name, data);
+}
+
+bool CMeshFileWriter::Close()
+{
+	if(!m_stream.is_open())
+		return false;
+	FileHeader header;
+	std::memcpy(header.magic, Magic, sizeof(Magic));
+	header.version = CMeshFile::Version;
+	header.sectionCount = static_cast<std::uint32_t>(m_sections.size());
+	header.tableOffset = m_position;
+	m_stream.write(reinterpret_cast<const char*>(m_sections.data()), static_cast<std::streamsize>(m_sections.size() * sizeof(CMeshFile::Section)));
+	m_stream.seekp(0);
+	m_stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	const bool ret = !m_bFailed && m_stream.good();
+	m_stream.close();
+	m_sections.clear();
+	m_position = 0;
+	return ret && !m_stream.fail();
+}
+
+bool CMeshFileReader::Open(const std::string& path)
+{
+	Close();
+	if(!m_file.Open(path) || m_file.Size() < sizeof(FileHeader))
+	{
+		Close();
+		return false;
+	}
+	FileHeader header;
+	std::memcpy(&header, m_file.Data(), sizeof(header));
+	const std::uint64_t tableSize = std::uint64_t(header.sectionCount) * sizeof(CMeshFile::Section);
+	if(std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != CMeshFile::Version
+		|| header.tableOffset > m_file.Size() || tableSize > m_file.Size() - header.tableOffset)
+	{
+		Close();
+		return false;
+	}
+	m_sections.resize(header.sectionCount);
+	std::memcpy(m_sections.data(), m_file.Data() + header.tableOffset, tableSize);
+	for(const auto& section : m_sections)
+	{
+		if(section.offset > header.tableOffset || section.size > header.tableOffset - section.offset)
+		{
+			Close();
+			return false;
+		}
+	}
+	return true;
+}
+
+void CMeshFileReader::Close()
+{
+	m_file.Close();
+	m_sections.clear();
+}
+
+bool CMeshFileReader::IsOpen() const
+{
+	return m_file.IsOpen();
+}
+
+const std::vector<CMeshFile::Section>& CMeshFileReader::Sections() const
+{
+	return m_sections;
+}
+
+const CMeshFile::Section* CMeshFileReader::FindSection(std::uint32_t kind, const std::string& name) const
+{
+	for(const auto& section : m_sections)
+	{
+		if(section.kind == kind && (name.empty() || sectionName(section) == name))
+			return &section;
+	}
+	return nullptr;
+}
+
+const void* CMeshFileReader::SectionData(const CMeshFile::Section& section) const
+{
+	return m_file.Data() + section.offset;
+}
+
+vtkSmartPointer<vtkDataArray> CMeshFileReader::ReadArray(const CMeshFile::Section& section) const
+{
+	auto array = vtkSmartPointer<vtkDataArray>::Take(vtkDataArray::CreateDataArray(section.dataType));
+	if(!array || section.components == 0 || static_cast<std::uint32_t>(array->GetDataTypeSize()) != section.elementSize
+		|| section.size != section.tuples * section.components * section.elementSize)
+		return nullptr;
+	array->SetNumberOfComponents(static_cast<int>(section.components));
+	array->SetNumberOfTuples(static_cast<vtkIdType>(section.tuples));
+	if(section.size > 0)
+		std::memcpy(array->GetVoidPointer(0), SectionData(section), section.size);
+	const std::string name = sectionName(section);
+	if(!name.empty())
+		array->SetName(name.c_str());
+	return array;
+}
+
+vtkSmartPointer<vtkCellArray> CMeshFileReader::ReadCells(const CMeshFile::Section& section, vtkIdType numPoints) const
+{
+	if(section.elementSize == 0 || section.size % section.elementSize != 0)
+		return nullptr;
+	const std::uint64_t entries = section.size / section.elementSize;
+	auto ids = vtkSmartPointer<vtkIdTypeArray>::New();
+	ids->SetNumberOfValues(static_cast<vtkIdType>(entries));
+	if(!copyIds(SectionData(section), section.elementSize, entries, ids->GetPointer(0)))
+		return nullptr;
+	// the ids come from the file, every cell must fit in the entries and use existing points only
+	const vtkIdType* conn = ids->GetPointer(0);
+	const vtkIdType numEntries = static_cast<vtkIdType>(entries);
+	vtkIdType numCells(0);
+	for(vtkIdType pos = 0; pos < numEntries; ++numCells)
+	{
+		const vtkIdType n = conn[pos];
+		if(n < 0 || n >= numEntries - pos)
+			return nullptr;
+		for(vtkIdType k = 1; k <= n; ++k)
+		{
+			if(conn[pos+k] < 0 || conn[pos+k] >= numPoints)
+				return nullptr;
+		}
+		pos += n + 1;
+	}
+	if(static_cast<std::uint64_t>(numCells) != section.tuples)
+		return nullptr;
+	auto cells = vtkSmartPointer<vtkCellArray>::New();
+	cells->SetCells(static_cast<vtkIdType>(section.tuples), ids);
+	return cells;
+}
+
+vtkSmartPointer<vtkPolyData> CMeshFileReader::ReadPolyData() const
+{
+	if(!IsOpen())
+		return nullptr;
+	auto ret = vtkSmartPointer<vtkPolyData>::New();
+	if(const auto section = FindSection(CMeshFile::POINTS))
+	{
+		auto data = ReadArray(*section);
+		if(!data || data->GetNumberOfComponents() != 3)
+			return nullptr;
+		auto points = vtkSmartPointer<vtkPoints>::New();
+		points->SetData(data);
+		ret->SetPoints(points);
+	}
+	for(const auto& section : m_sections)
+	{
+		vtkSmartPointer<vtkCellArray> cells;
+		vtkSmartPointer<vtkDataArray> array;
+		switch(section.kind)
+		{
+		case CMeshFile::VERTS:
+		case CMeshFile::LINES:
+		case CMeshFile::POLYS:
+		case CMeshFile::STRIPS:
+			cells = ReadCells(section, ret->GetNumberOfPoints());
+			if(!cells)
+				return nullptr;
+			if(section.kind == CMeshFile::VERTS)
+				ret->SetVerts(cells);
+			else if(section.kind == CMeshFile::LINES)
+				ret->SetLines(cells);
+			else if(section.kind == CMeshFile::POLYS)
+				ret->SetPolys(cells);
+			else
+				ret->SetStrips(cells);
+			break;
+		case CMeshFile::POINT_DATA:
+		case CMeshFile::CELL_DATA:
+			array = ReadArray(section);
+			if(array)
+			{
+				vtkDataSetAttributes* attributes = section.kind == CMeshFile::POINT_DATA ? static_cast<vtkDataSetAttributes*>(ret->GetPointData()) : ret->GetCellData();
+				const int index = attributes->AddArray(array);
+				if(section.attribute >= 0)
+					attributes->SetActiveAttribute(index, section.attribute);
+			}
+			break;
+		default:
+			break;
+		}
+	}
+	return ret;
+}
+
+vtkSmartPointer<vtkIdList> CMeshFileReader::ReadIdList(const std::string& name) const
+{
+	const auto section = FindSection(CMeshFile::ID_LIST, name);
+	if(!section || section->size < section->tuples * section->elementSize)
+		return nullptr;
+	auto ret = vtkSmartPointer<vtkIdList>::New();
+	ret->SetNumberOfIds(static_cast<vtkIdType>(section->tuples));
+	if(section->tuples > 0 && !copyIds(SectionData(*section), section->elementSize, section->tuples, ret->GetPointer(0)))
+		return nullptr;
+	return ret;
+}
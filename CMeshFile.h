@@ -0,0 +1,110 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <vtkSmartPointer.h>
+#include <vtkType.h>
+#include "CMappedFile.h"
+
+class vtkPolyData;
+class vtkIdList;
+class vtkDataArray;
+class vtkCellArray;
+class vtkDataSetAttributes;
+
+// *****
+// Section based binary mesh file.
+// A 24 byte header (magic, version, section count, table offset) is followed by the raw sections, each aligned
+// to 64 bytes, and by the section table at the end of the file, so a writer streams the arrays straight from
+// their memory in large blocks without knowing the sections in advance. Points, cell arrays (legacy layout),
+// point and cell data arrays, id lists and opaque blobs are stored as they are in memory (little endian).
+// The reader memory-maps the file, a section is usable in place through SectionData() or copied into
+// preallocated VTK arrays with a single memcpy.
+// *****
+class CMeshFile
+{
+public:
+	enum SectionKind : std::uint32_t
+	{
+		POINTS = 1,
+		VERTS,
+		LINES,
+		POLYS,
+		STRIPS,
+		POINT_DATA,
+		CELL_DATA,
+		ID_LIST,
+		BLOB
+	};
+
+	struct Section
+	{
+		std::uint32_t kind;
+		std::int32_t dataType;//VTK_FLOAT, VTK_ID_TYPE, ... or VTK_CHAR for a blob
+		std::uint32_t components;
+		std::uint32_t elementSize;//bytes of one value
+		std::uint64_t tuples;//number of cells for a cell array, of bytes for a blob
+		std::uint64_t offset;//from the start of the file
+		std::uint64_t size;//bytes
+		std::int32_t attribute;//vtkDataSetAttributes::AttributeTypes of a data array, -1 if none
+		std::uint32_t reserved;
+		char name[32];
+	};
+
+	static const std::uint32_t Version = 1;
+};
+
+class CMeshFileWriter
+{
+public:
+	CMeshFileWriter();
+	~CMeshFileWriter();
+
+	bool Open(const std::string& path);
+	// points, cell arrays and every point and cell data array
+	bool WritePolyData(vtkPolyData* polydata);
+	bool WriteIdList(const std::string& name, vtkIdList* ids);
+	bool WriteBlob(const std::string& name, const void* data, std::uint64_t size);
+	// writes the section table, the file is not readable before
+	bool Close();
+
+private:
+	bool WriteSection(CMeshFile::Section section, const std::string& name, const void* data);
+	bool WriteArray(std::uint32_t kind, vtkDataArray* array, int attribute);
+	bool WriteCells(std::uint32_t kind, vtkCellArray* cells);
+	bool WriteAttributes(std::uint32_t kind, vtkDataSetAttributes* attributes);
+
+private:
+	std::ofstream m_stream;
+	std::vector<char> m_buffer;
+	std::vector<CMeshFile::Section> m_sections;
+	std::uint64_t m_position;
+	bool m_bFailed;
+};
+
+class CMeshFileReader
+{
+public:
+	bool Open(const std::string& path);
+	void Close();
+	bool IsOpen() const;
+
+	const std::vector<CMeshFile::Section>& Sections() const;
+	// the first section of kind, of that name when name is not empty
+	const CMeshFile::Section* FindSection(std::uint32_t kind, const std::string& name = std::string()) const;
+	const void* SectionData(const CMeshFile::Section& section) const;
+
+	// nullptr when the points or a cell array are malformed, see ReadCells()
+	vtkSmartPointer<vtkPolyData> ReadPolyData() const;
+	vtkSmartPointer<vtkIdList> ReadIdList(const std::string& name = std::string()) const;
+
+private:
+	vtkSmartPointer<vtkDataArray> ReadArray(const CMeshFile::Section& section) const;
+	// nullptr unless the legacy (n, ids...) cells fill the section exactly and use points below numPoints
+	vtkSmartPointer<vtkCellArray> ReadCells(const CMeshFile::Section& section, vtkIdType numPoints) const;
+
+private:
+	CMappedFile m_file;
+	std::vector<CMeshFile::Section> m_sections;
+};
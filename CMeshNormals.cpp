@@ -0,0 +1,316 @@
+#include "CMeshNormals.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <utility>
+
+#include <vtkPolyData.h>
+#include <vtkPoints.h>
+#include <vtkCellArray.h>
+#include <vtkIdList.h>
+#include <vtkFloatArray.h>
+#include <vtkPointData.h>
+#include <vtkCellData.h>
+#include <vtkSMPTools.h>
+
+namespace
+{
+// returns the normals of attributes and whether they had to be created
+std::pair<vtkFloatArray*, bool> prepareNormals(vtkDataSetAttributes* attributes, vtkIdType numTuples)
+{
+	auto normals = vtkFloatArray::SafeDownCast(attributes->GetNormals());
+	if(normals && normals->GetNumberOfComponents() == 3 && normals->GetNumberOfTuples() == numTuples)
+		return {normals, false};
+	auto created = vtkSmartPointer<vtkFloatArray>::New();
+	created->SetName("Normals");
+	created->SetNumberOfComponents(3);
+	created->SetNumberOfTuples(numTuples);
+	attributes->SetNormals(created);
+	return {created, true};
+}
+
+void sortUnique(std::vector<vtkIdType>& ids)
+{
+	std::sort(ids.begin(), ids.end());
+	ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+}
+}
+
+CMeshNormals::CMeshNormals()
+	: m_polysMTime(0)
+	, m_firstPoly(0)
+	, m_cellNormals(nullptr)
+	, m_pointNormals(nullptr)
+	, m_bParallel(true)
+	, m_bCanceled(false)
+	, m_dLastTime(0.0)
+	, m_updatedCellCount(0)
+	, m_updatedPointCount(0)
+{
+}
+
+void CMeshNormals::SetParallel(bool parallel)
+{
+	m_bParallel = parallel;
+}
+
+bool CMeshNormals::GetParallel() const
+{
+	return m_bParallel;
+}
+
+void CMeshNormals::SetProgressCallback(ProgressCallback callback)
+{
+	m_progressCallback = std::move(callback);
+}
+
+bool CMeshNormals::ReportProgress(double fraction)
+{
+	if(m_progressCallback && !m_progressCallback(fraction))
+		m_bCanceled = true;
+	return !m_bCanceled;
+}
+
+void CMeshNormals::Clear()
+{
+	m_polydata = nullptr;
+	m_polysMTime = 0;
+	m_firstPoly = 0;
+	std::vector<vtkIdType>().swap(m_polyOffsets);
+	std::vector<vtkIdType>().swap(m_incidenceOffsets);
+	std::vector<vtkIdType>().swap(m_incidence);
+	m_cellNormals = nullptr;
+	m_pointNormals = nullptr;
+}
+
+template <typename Functor>
+void CMeshNormals::Run(vtkIdType n, Functor&& functor)
+{
+	if(m_bParallel)
+		vtkSMPTools::For(0, n, functor);
+	else
+		functor(0, n);
+}
+
+bool CMeshNormals::UpdateIncidence(vtkPolyData* polydata)
+{
+	vtkCellArray* polys = polydata->GetPolys();
+	const vtkIdType numPoints = polydata->GetNumberOfPoints();
+	const vtkIdType firstPoly = polydata->GetNumberOfVerts() + polydata->GetNumberOfLines();
+	if(m_polydata.GetPointer() == polydata && m_polysMTime == polys->GetMTime() && m_firstPoly == firstPoly
+		&& static_cast<vtkIdType>(m_incidenceOffsets.size()) == numPoints + 1)
+		return false;
+
+	m_polydata = polydata;
+	m_polysMTime = polys->GetMTime();
+	m_firstPoly = firstPoly;
+	const vtkIdType* conn = polys->GetPointer();
+	const vtkIdType numPolys = polys->GetNumberOfCells();
+	m_polyOffsets.resize(numPolys);
+	m_incidenceOffsets.assign(numPoints + 1, 0);
+	for(vtkIdType p = 0, pos = 0; p < numPolys; ++p, pos += conn[pos] + 1)
+	{
+		m_polyOffsets[p] = pos;
+		for(vtkIdType k = 0; k < conn[pos]; ++k)
+			++m_incidenceOffsets[conn[pos+1+k] + 1];
+	}
+	for(vtkIdType i = 0; i < numPoints; ++i)
+		m_incidenceOffsets[i+1] += m_incidenceOffsets[i];
+	m_incidence.resize(m_incidenceOffsets[numPoints]);
+	std::vector<vtkIdType> cursor(m_incidenceOffsets.cbegin(), m_incidenceOffsets.cend() - 1);
+	for(vtkIdType p = 0; p < numPolys; ++p)
+	{
+		const vtkIdType pos = m_polyOffsets[p];
+		for(vtkIdType k = 0; k < conn[pos]; ++k)
+			m_incidence[cursor[conn[pos+1+k]]++] = p;
+	}
+	return true;
+}
+
+bool CMeshNormals::PrepareArrays(vtkPolyData* polydata)
+{
+	const auto cellNormals = prepareNormals(polydata->GetCellData(), polydata->GetNumberOfCells());
+	const auto pointNormals = prepareNormals(polydata->GetPointData(), polydata->GetNumberOfPoints());
+	m_cellNormals = cellNormals.first;
+	m_pointNormals = pointNormals.first;
+	return cellNormals.second || pointNormals.second;
+}
+
+void CMeshNormals::ComputeCells(vtkPolyData* polydata, const vtkIdType* cellIds, vtkIdType count)
+{
+	vtkPoints* points = polydata->GetPoints();
+	const vtkIdType* conn = polydata->GetPolys()->GetPointer();
+	const vtkIdType numPolys = static_cast<vtkIdType>(m_polyOffsets.size());
+	float* normals = m_cellNormals->GetPointer(0);
+	Run(count, [this, points, conn, numPolys, normals, cellIds](vtkIdType begin, vtkIdType end)
+	{
+		double a[3], b[3], c[3];
+		for(vtkIdType i = begin; i < end; ++i)
+		{
+			const vtkIdType cellId = cellIds ? cellIds[i] : i;
+			const vtkIdType poly = cellId - m_firstPoly;
+			double normal[3] = {0.0, 0.0, 0.0};
+			if(poly >= 0 && poly < numPolys)
+			{
+				const vtkIdType n = conn[m_polyOffsets[poly]];
+				const vtkIdType* ids = conn + m_polyOffsets[poly] + 1;
+				if(n == 3)
+				{
+					points->GetPoint(ids[0], a);
+					points->GetPoint(ids[1], b);
+					points->GetPoint(ids[2], c);
+					const double u[3] = {b[0]-a[0], b[1]-a[1], b[2]-a[2]};
+					const double v[3] = {c[0]-a[0], c[1]-a[1], c[2]-a[2]};
+					normal[0] = u[1]*v[2] - u[2]*v[1];
+					normal[1] = u[2]*v[0] - u[0]*v[2];
+					normal[2] = u[0]*v[1] - u[1]*v[0];
+				}
+				else if(n > 3)
+				{
+					// Newell normal, robust for slightly non planar polygons
+					points->GetPoint(ids[n-1], a);
+					for(vtkIdType k = 0; k < n; ++k)
+					{
+						points->GetPoint(ids[k], b);
+						normal[0] += (a[1]-b[1]) * (a[2]+b[2]);
+						normal[1] += (a[2]-b[2]) * (a[0]+b[0]);
+						normal[2] += (a[0]-b[0]) * (a[1]+b[1]);
+						std::copy(b, b + 3, a);
+					}
+				}
+				const double length = std::sqrt(normal[0]*normal[0] + normal[1]*normal[1] + normal[2]*normal[2]);
+				if(length > 0.0)
+				{
+					for(auto& value : normal)
+						value /= length;
+				}
+			}
+			for(int j = 0; j < 3; ++j)
+				normals[3*cellId+j] = static_cast<float>(normal[j]);
+		}
+	});
+}
+
+void CMeshNormals::ComputePoints(const vtkIdType* pointIds, vtkIdType count)
+{
+	const float* cellNormals = m_cellNormals->GetPointer(0);
+	float* normals = m_pointNormals->GetPointer(0);
+	Run(count, [this, cellNormals, normals, pointIds](vtkIdType begin, vtkIdType end)
+	{
+		for(vtkIdType i = begin; i < end; ++i)
+		{
+			const vtkIdType pointId = pointIds ? pointIds[i] : i;
+			double normal[3] = {0.0, 0.0, 0.0};
+			for(vtkIdType k = m_incidenceOffsets[pointId]; k < m_incidenceOffsets[pointId+1]; ++k)
+			{
+				const float* cellNormal = cellNormals + 3 * (m_incidence[k] + m_firstPoly);
+				for(int j = 0; j < 3; ++j)
+					normal[j] += cellNormal[j];
+			}
+			const double length = std::sqrt(normal[0]*normal[0] + normal[1]*normal[1] + normal[2]*normal[2]);
+			for(int j = 0; j < 3; ++j)
+				normals[3*pointId+j] = static_cast<float>(length > 0.0 ? normal[j] / length : 0.0);
+		}
+	});
+}
+
+void CMeshNormals::Compute(vtkSmartPointer<vtkPolyData> polydata)
+{
+	const auto startTime = std::chrono::steady_clock::now();
+	m_updatedCellCount = 0;
+	m_updatedPointCount = 0;
+	m_bCanceled = false;
+	if(!polydata || !polydata->GetPoints())
+		return;
+
+	// the three passes take about the same time
+	UpdateIncidence(polydata);
+	PrepareArrays(polydata);
+	if(!ReportProgress(1.0 / 3.0))
+		return;
+	m_updatedCellCount = polydata->GetNumberOfCells();
+	m_updatedPointCount = polydata->GetNumberOfPoints();
+	ComputeCells(polydata, nullptr, m_updatedCellCount);
+	if(!ReportProgress(2.0 / 3.0))
+		return;
+	ComputePoints(nullptr, m_updatedPointCount);
+	m_cellNormals->Modified();
+	m_pointNormals->Modified();
+	m_dLastTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void CMeshNormals::Update(vtkSmartPointer<vtkPolyData> polydata, vtkSmartPointer<vtkIdList> dirtyCells)
+{
+	if(!polydata || !polydata->GetPoints() || !dirtyCells)
+	{
+		Compute(polydata);
+		return;
+	}
+	const auto startTime = std::chrono::steady_clock::now();
+	const bool rebuilt = UpdateIncidence(polydata);
+	if(PrepareArrays(polydata) || rebuilt)
+	{
+		Compute(polydata);
+		return;
+	}
+
+	// the moved points are the points of the dirty cells, every poly around them has a new normal
+	const vtkIdType* conn = polydata->GetPolys()->GetPointer();
+	const vtkIdType numPolys = static_cast<vtkIdType>(m_polyOffsets.size());
+	auto addPolyPoints = [this, conn](vtkIdType poly, std::vector<vtkIdType>& pointIds)
+	{
+		const vtkIdType pos = m_polyOffsets[poly];
+		pointIds.insert(pointIds.end(), conn + pos + 1, conn + pos + 1 + conn[pos]);
+	};
+	std::vector<vtkIdType> movedPoints;
+	for(vtkIdType i = 0; i < dirtyCells->GetNumberOfIds(); ++i)
+	{
+		const vtkIdType poly = dirtyCells->GetId(i) - m_firstPoly;
+		if(poly >= 0 && poly < numPolys)
+			addPolyPoints(poly, movedPoints);
+	}
+	sortUnique(movedPoints);
+
+	std::vector<vtkIdType> ringCells;
+	for(const vtkIdType pointId : movedPoints)
+	{
+		for(vtkIdType k = m_incidenceOffsets[pointId]; k < m_incidenceOffsets[pointId+1]; ++k)
+			ringCells.push_back(m_incidence[k] + m_firstPoly);
+	}
+	sortUnique(ringCells);
+
+	// and every point of those polys has a new normal
+	std::vector<vtkIdType> ringPoints;
+	for(const vtkIdType cellId : ringCells)
+		addPolyPoints(cellId - m_firstPoly, ringPoints);
+	sortUnique(ringPoints);
+
+	m_updatedCellCount = static_cast<vtkIdType>(ringCells.size());
+	m_updatedPointCount = static_cast<vtkIdType>(ringPoints.size());
+	ComputeCells(polydata, ringCells.data(), m_updatedCellCount);
+	ComputePoints(ringPoints.data(), m_updatedPointCount);
+	m_cellNormals->Modified();
+	m_pointNormals->Modified();
+	m_dLastTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+double CMeshNormals::LastTime() const
+{
+	return m_dLastTime;
+}
+
+bool CMeshNormals::WasCanceled() const
+{
+	return m_bCanceled;
+}
+
+vtkIdType CMeshNormals::UpdatedCellCount() const
+{
+	return m_updatedCellCount;
+}
+
+vtkIdType CMeshNormals::UpdatedPointCount() const
+{
+	return m_updatedPointCount;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <functional>
+#include <vector>
+#include <vtkSmartPointer.h>
+#include <vtkWeakPointer.h>
+#include <vtkType.h>
+
+class vtkPolyData;
+class vtkIdList;
+class vtkFloatArray;
+
+// *****
+// Cell and point normals written in place into the "Normals" arrays of a polydata, in parallel.
+// Unlike vtkPolyDataNormals the topology is never changed: no polygon is reordered, no sharp edge is split
+// and no point is renumbered, so the polygons are expected to be consistently oriented already.
+// A cell normal is the unit Newell normal of the polygon, a point normal the normalized sum of the normals
+// of its polygons, as in vtkPolyDataNormals. The point to polygon incidence is cached against the polys,
+// after moving the points of some cells only those cells, their one-ring and the points of both are updated.
+// Vertices, lines and strips get a zero normal.
+// *****
+class CMeshNormals
+{
+public:
+	// fraction of Compute() done in [0, 1], return false to cancel
+	using ProgressCallback = std::function<bool(double fraction)>;
+
+	CMeshNormals();
+
+	void SetParallel(bool parallel);
+	bool GetParallel() const;
+	// called after the incidence and after the cell normals, a canceled Compute() leaves the normals incomplete
+	void SetProgressCallback(ProgressCallback callback);
+
+	// computes every normal, the arrays are created when missing or not of the right size
+	void Compute(vtkSmartPointer<vtkPolyData> polydata);
+	// dirtyCells are the cells whose points moved, falls back to Compute() when the polys or the arrays changed
+	void Update(vtkSmartPointer<vtkPolyData> polydata, vtkSmartPointer<vtkIdList> dirtyCells);
+	void Clear();
+
+	double LastTime() const;//seconds spent in the last Compute() or Update()
+	bool WasCanceled() const;//by the progress callback in the last Compute()
+	vtkIdType UpdatedCellCount() const;
+	vtkIdType UpdatedPointCount() const;
+
+private:
+	bool ReportProgress(double fraction);
+	bool UpdateIncidence(vtkPolyData* polydata);
+	bool PrepareArrays(vtkPolyData* polydata);
+	void ComputeCells(vtkPolyData* polydata, const vtkIdType* cellIds, vtkIdType count);
+	void ComputePoints(const vtkIdType* pointIds, vtkIdType count);
+	template <typename Functor>
+	void Run(vtkIdType n, Functor&& functor);
+
+private:
+	vtkWeakPointer<vtkPolyData> m_polydata;
+	vtkMTimeType m_polysMTime;
+	vtkIdType m_firstPoly;//cell id of the first poly
+	std::vector<vtkIdType> m_polyOffsets;//position of every poly in the legacy connectivity
+	std::vector<vtkIdType> m_incidenceOffsets;//CSR point -> poly index
+	std::vector<vtkIdType> m_incidence;
+	vtkFloatArray* m_cellNormals;//owned by the polydata cell data
+	vtkFloatArray* m_pointNormals;//owned by the polydata point data
+	bool m_bParallel;
+	bool m_bCanceled;
+	ProgressCallback m_progressCallback;
+	double m_dLastTime;
+	vtkIdType m_updatedCellCount;
+	vtkIdType m_updatedPointCount;
+};
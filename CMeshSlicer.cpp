@@ -0,0 +1,250 @@
+#include "CMeshSlicer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+
+#include <vtkPolyData.h>
+#include <vtkPoints.h>
+#include <vtkCellType.h>
+#include <vtkSMPTools.h>
+
+namespace
+{
+// height of every point along the unit normal
+class HeightFunctor
+{
+public:
+	HeightFunctor(vtkPoints* points, const std::array<double, 3>& normal, std::vector<double>& heights)
+		: m_points(points)
+		, m_normal(normal)
+		, m_heights(heights)
+	{
+	}
+
+	void operator()(vtkIdType begin, vtkIdType end) const
+	{
+		double x[3];
+		for(vtkIdType i = begin; i < end; ++i)
+		{
+			m_points->GetPoint(i, x);
+			m_heights[i] = m_normal[0] * x[0] + m_normal[1] * x[1] + m_normal[2] * x[2];
+		}
+	}
+
+private:
+	vtkPoints* m_points;
+	const std::array<double, 3>& m_normal;
+	std::vector<double>& m_heights;
+};
+
+// the planes a cell crosses are the offsets in (min height, max height], they form the range [first, last) of the sorted offsets
+class CellRangeFunctor
+{
+public:
+	CellRangeFunctor(vtkPolyData* polydata, const std::vector<double>& heights, const std::vector<double>& sortedOffsets, std::vector<int>& first, std::vector<int>& last)
+		: m_polydata(polydata)
+		, m_heights(heights)
+		, m_sortedOffsets(sortedOffsets)
+		, m_first(first)
+		, m_last(last)
+	{
+	}
+
+	void operator()(vtkIdType begin, vtkIdType end) const
+	{
+		vtkIdType nPoints(0);
+		vtkIdType* pts(nullptr);
+		for(vtkIdType cellId = begin; cellId < end; ++cellId)
+		{
+			m_first[cellId] = m_last[cellId] = 0;
+			m_polydata->GetCellPoints(cellId, nPoints, pts);
+			if(nPoints < 3 || m_polydata->GetCellType(cellId) == VTK_TRIANGLE_STRIP)
+				continue;
+			double lower = m_heights[pts[0]], upper = m_heights[pts[0]];
+			for(vtkIdType k = 1; k < nPoints; ++k)
+			{
+				lower = std::min(lower, m_heights[pts[k]]);
+				upper = std::max(upper, m_heights[pts[k]]);
+			}
+			m_first[cellId] = static_cast<int>(std::upper_bound(m_sortedOffsets.cbegin(), m_sortedOffsets.cend(), lower) - m_sortedOffsets.cbegin());
+			m_last[cellId] = static_cast<int>(std::upper_bound(m_sortedOffsets.cbegin(), m_sortedOffsets.cend(), upper) - m_sortedOffsets.cbegin());
+		}
+	}
+
+private:
+	vtkPolyData* m_polydata;
+	const std::vector<double>& m_heights;
+	const std::vector<double>& m_sortedOffsets;
+	std::vector<int>& m_first;
+	std::vector<int>& m_last;
+};
+
+// A vertex with height >= offset counts as above the plane, so a triangle crosses the plane through exactly
+// two edges or none, and the neighbours of a crossed edge agree on it.
+// The segments of a layer are chained by CContourChainer, which also orients the loops as outer or hole.
+class LayerFunctor
+{
+public:
+	LayerFunctor(vtkPolyData* polydata, const std::array<double, 3>& normal, const std::vector<double>& heights, const std::vector<double>& sortedOffsets,
+		const std::vector<vtkIdType>& layerStart, const std::vector<vtkIdType>& layerCells, const std::vector<std::size_t>& order, std::vector<CMeshSlicer::Layer>& layers)
+		: m_polydata(polydata)
+		, m_normal(normal)
+		, m_heights(heights)
+		, m_sortedOffsets(sortedOffsets)
+		, m_layerStart(layerStart)
+		, m_layerCells(layerCells)
+		, m_order(order)
+		, m_layers(layers)
+	{
+	}
+
+	void operator()(vtkIdType begin, vtkIdType end) const
+	{
+		CContourChainer chainer;
+		vtkIdType nPoints(0);
+		vtkIdType* pts(nullptr);
+		for(vtkIdType l = begin; l < end; ++l)
+		{
+			const double offset = m_sortedOffsets[l];
+			chainer.Clear();
+			chainer.Reserve(m_layerStart[l+1] - m_layerStart[l]);
+			for(vtkIdType i = m_layerStart[l]; i < m_layerStart[l+1]; ++i)
+			{
+				m_polydata->GetCellPoints(m_layerCells[i], nPoints, pts);
+				for(vtkIdType k = 1; k + 1 < nPoints; ++k)
+				{
+					const vtkIdType triangle[3] = {pts[0], pts[k], pts[k+1]};
+					CutTriangle(triangle, offset, chainer);
+				}
+			}
+			CMeshSlicer::Layer& layer = m_layers[m_order[l]];
+			layer.offset = offset;
+			layer.contours = chainer.Chain(m_normal);
+		}
+	}
+
+private:
+	void CutTriangle(const vtkIdType triangle[3], double offset, CContourChainer& chainer) const
+	{
+		std::array<double, 3> segment[2];
+		int found(0);
+		for(int i = 0; i < 3; ++i)
+		{
+			const vtkIdType a = triangle[i];
+			const vtkIdType b = triangle[(i + 1) % 3];
+			const bool aboveA = m_heights[a] >= offset;
+			const bool aboveB = m_heights[b] >= offset;
+			if(aboveA == aboveB)
+				continue;
+			EdgePoint(std::min(a, b), std::max(a, b), offset, segment[found++]);
+		}
+		if(found == 2)
+			chainer.AddSegment(segment[0], segment[1]);
+	}
+
+	// computed from the sorted edge ids (first < second), so both cells of the edge get the same bits
+	void EdgePoint(vtkIdType first, vtkIdType second, double offset, std::array<double, 3>& point) const
+	{
+		double a[3], b[3];
+		m_polydata->GetPoints()->GetPoint(first, a);
+		m_polydata->GetPoints()->GetPoint(second, b);
+		const double da = m_heights[first] - offset;
+		const double db = m_heights[second] - offset;
+		const double t = da / (da - db);
+		for(int j = 0; j < 3; ++j)
+			point[j] = a[j] + t * (b[j] - a[j]);
+	}
+
+private:
+	vtkPolyData* m_polydata;
+	const std::array<double, 3>& m_normal;
+	const std::vector<double>& m_heights;
+	const std::vector<double>& m_sortedOffsets;
+	const std::vector<vtkIdType>& m_layerStart;
+	const std::vector<vtkIdType>& m_layerCells;
+	const std::vector<std::size_t>& m_order;
+	std::vector<CMeshSlicer::Layer>& m_layers;
+};
+}
+
+CMeshSlicer::CMeshSlicer()
+	: m_dSliceTime(0.0)
+	, m_crossingCount(0)
+{
+}
+
+std::vector<CMeshSlicer::Layer> CMeshSlicer::Slice(vtkSmartPointer<vtkPolyData> polydata, const std::array<double, 3>& normal, const std::vector<double>& offsets, bool parallel)
+{
+	const auto startTime = std::chrono::steady_clock::now();
+	m_crossingCount = 0;
+	std::vector<Layer> ret(offsets.size());
+	for(std::size_t i = 0; i < offsets.size(); ++i)
+		ret[i].offset = offsets[i];
+	const double length = std::sqrt(normal[0]*normal[0] + normal[1]*normal[1] + normal[2]*normal[2]);
+	if(!polydata || !polydata->GetPoints() || polydata->GetNumberOfCells() == 0 || offsets.empty() || length == 0.0)
+		return ret;
+	const std::array<double, 3> unitNormal = {normal[0] / length, normal[1] / length, normal[2] / length};
+
+	auto run = [parallel](vtkIdType n, auto& functor)
+	{
+		if(parallel)
+			vtkSMPTools::For(0, n, functor);
+		else
+			functor(0, n);
+	};
+
+	const vtkIdType numPoints = polydata->GetNumberOfPoints();
+	const vtkIdType numCells = polydata->GetNumberOfCells();
+	std::vector<double> heights(numPoints);
+	HeightFunctor heightFunctor(polydata->GetPoints(), unitNormal, heights);
+	run(numPoints, heightFunctor);
+
+	std::vector<std::size_t> order(offsets.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [&offsets](std::size_t a, std::size_t b) { return offsets[a] < offsets[b]; });
+	std::vector<double> sortedOffsets(offsets.size());
+	for(std::size_t i = 0; i < order.size(); ++i)
+		sortedOffsets[i] = offsets[order[i]];
+
+	polydata->GetCellType(0);//builds the cell map before the parallel passes read it
+	std::vector<int> first(numCells), last(numCells);
+	CellRangeFunctor rangeFunctor(polydata, heights, sortedOffsets, first, last);
+	run(numCells, rangeFunctor);
+
+	// bucket the cells by layer in compressed rows, the cost is the number of cell-plane crossings
+	const vtkIdType numLayers = static_cast<vtkIdType>(sortedOffsets.size());
+	std::vector<vtkIdType> layerStart(numLayers + 1, 0);
+	for(vtkIdType cellId = 0; cellId < numCells; ++cellId)
+	{
+		for(int l = first[cellId]; l < last[cellId]; ++l)
+			++layerStart[l+1];
+	}
+	for(vtkIdType l = 0; l < numLayers; ++l)
+		layerStart[l+1] += layerStart[l];
+	m_crossingCount = layerStart[numLayers];
+	std::vector<vtkIdType> layerCells(m_crossingCount);
+	std::vector<vtkIdType> insertPos(layerStart.cbegin(), layerStart.cend() - 1);
+	for(vtkIdType cellId = 0; cellId < numCells; ++cellId)
+	{
+		for(int l = first[cellId]; l < last[cellId]; ++l)
+			layerCells[insertPos[l]++] = cellId;
+	}
+
+	LayerFunctor layerFunctor(polydata, unitNormal, heights, sortedOffsets, layerStart, layerCells, order, ret);
+	run(numLayers, layerFunctor);
+
+	m_dSliceTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	return ret;
+}
+
+double CMeshSlicer::SliceTime() const
+{
+	return m_dSliceTime;
+}
+
+vtkIdType CMeshSlicer::CrossingCount() const
+{
+	return m_crossingCount;
+}
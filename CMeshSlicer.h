@@ -0,0 +1,42 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <vtkSmartPointer.h>
+#include <vtkType.h>
+#include "CContourChainer.h"
+
+class vtkPolyData;
+
+// *****
+// Cuts a polydata by many parallel planes in one call.
+// The planes are n . x = offset for each offset, n being the normal scaled to unit length, so an offset is a
+// distance along the normal. Every cell is bucketed to the range of planes its extent along the normal
+// crosses, so it is only visited for those planes, and the planes are cut in parallel.
+// The intersection point of an edge is computed from its sorted point ids, the segments of neighbouring cells
+// therefore share bit identical end points, CContourChainer joins them into loops with outer/hole orientation.
+// Polygons are cut as triangle fans, vertices and lines are ignored and strips are skipped.
+// *****
+class CMeshSlicer
+{
+public:
+	using Contour = CContourChainer::Contour;
+
+	struct Layer
+	{
+		double offset;
+		std::vector<Contour> contours;
+	};
+
+	CMeshSlicer();
+
+	// the layers are returned in the order of offsets. normal is normalized here, offsets are distances along
+	// the unit normal whatever the length of normal
+	std::vector<Layer> Slice(vtkSmartPointer<vtkPolyData> polydata, const std::array<double, 3>& normal, const std::vector<double>& offsets, bool parallel = true);
+
+	double SliceTime() const;//seconds spent in the last Slice()
+	vtkIdType CrossingCount() const;//cell-plane pairs visited in the last Slice()
+
+private:
+	double m_dSliceTime;
+	vtkIdType m_crossingCount;
+};
@@ -0,0 +1,367 @@
+#include "CMeshTopology.h"
+
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include <vtkPolyData.h>
+#include <vtkCellArray.h>
+#include <vtkSMPTools.h>
+
+namespace
+{
+// the two neighbours of a point in one polygon, the polygon goes prev -> point -> next
+struct Incidence
+{
+	vtkIdType prev;
+	vtkIdType next;
+};
+
+struct LinkEntry
+{
+	vtkIdType other;
+	int incidence;
+	int direction;//+1 when the polygon goes from the point to other
+
+	bool operator<(const LinkEntry& rhs) const
+	{
+		return other != rhs.other ? other < rhs.other : incidence < rhs.incidence;
+	}
+};
+
+struct PointSummary
+{
+	int edges;//edges to a point of larger id
+	int boundaryEdges;
+	int nonManifoldEdges;
+	int inconsistentEdges;
+	int fans;
+};
+
+template <typename T>
+T FindRoot(std::vector<T>& parent, T i)
+{
+	while(parent[i] != i)
+	{
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+template <typename T>
+bool Unite(std::vector<T>& parent, T a, T b)
+{
+	a = FindRoot(parent, a);
+	b = FindRoot(parent, b);
+	if(a == b)
+		return false;
+	parent[std::max(a, b)] = std::min(a, b);
+	return true;
+}
+
+// root of face i in a union-find whose links carry the parity of a flip between a face and its parent
+std::pair<vtkIdType, char> FindFlipRoot(std::vector<vtkIdType>& parent, std::vector<char>& flip, vtkIdType i)
+{
+	vtkIdType root = i;
+	char parity = 0;
+	while(parent[root] != root)
+	{
+		parity ^= flip[root];
+		root = parent[root];
+	}
+	for(char p = parity; i != root;)
+	{
+		const vtkIdType next = parent[i];
+		const char nextParity = p ^ flip[i];
+		parent[i] = root;
+		flip[i] = p;
+		i = next;
+		p = nextParity;
+	}
+	return {root, parity};
+}
+
+// a manifold mesh is orientable when flipping some of its polygons can make every edge consistent: two polygons
+// going the same direction along an edge must end up with opposite flips, the others with equal ones
+bool IsOrientable(const vtkIdType* conn, vtkIdType numPolys, vtkIdType numFaces)
+{
+	struct DirectedEdge
+	{
+		vtkIdType a, b;//a < b
+		vtkIdType face;
+		char forward;//the polygon goes from a to b
+
+		bool operator<(const DirectedEdge& rhs) const
+		{
+			return a != rhs.a ? a < rhs.a : b < rhs.b;
+		}
+	};
+	std::vector<DirectedEdge> edges;
+	for(vtkIdType c = 0, pos = 0, face = 0; c < numPolys; ++c, pos += conn[pos] + 1)
+	{
+		const vtkIdType n = conn[pos];
+		if(n < 3)
+			continue;
+		const vtkIdType* ids = conn + pos + 1;
+		for(vtkIdType k = 0; k < n; ++k)
+		{
+			const vtkIdType from = ids[k];
+			const vtkIdType to = ids[(k+1) % n];
+			if(from != to)
+				edges.push_back({std::min(from, to), std::max(from, to), face, from < to});
+		}
+		++face;
+	}
+	std::sort(edges.begin(), edges.end());
+
+	std::vector<vtkIdType> parent(numFaces);
+	std::iota(parent.begin(), parent.end(), vtkIdType(0));
+	std::vector<char> flip(numFaces, 0);
+	const std::size_t numEdges = edges.size();
+	for(std::size_t i = 0; i + 1 < numEdges; ++i)
+	{
+		const DirectedEdge& first = edges[i];
+		const DirectedEdge& second = edges[i+1];
+		if(first.a != second.a || first.b != second.b)
+			continue;
+		const char opposite = first.forward == second.forward;
+		const auto rootFirst = FindFlipRoot(parent, flip, first.face);
+		const auto rootSecond = FindFlipRoot(parent, flip, second.face);
+		if(rootFirst.first == rootSecond.first)
+		{
+			if((rootFirst.second ^ rootSecond.second) != opposite)
+				return false;
+		}
+		else
+		{
+			parent[rootFirst.first] = rootSecond.first;
+			flip[rootFirst.first] = rootFirst.second ^ rootSecond.second ^ opposite;
+		}
+		++i;//a manifold edge has two polygons
+	}
+	return true;
+}
+
+// resolves the edges around point from its incidences, the edges are owned by their smaller point
+void AnalyzePoint(vtkIdType point, const Incidence* incidences, int count, std::vector<LinkEntry>& link, std::vector<int>& parent, PointSummary& summary,
+	std::vector<std::array<vtkIdType, 2>>* nonManifoldEdges, std::vector<std::array<vtkIdType, 2>>* boundaryEdges)
+{
+	link.clear();
+	for(int i = 0; i < count; ++i)
+	{
+		link.push_back({incidences[i].next, i, 1});
+		link.push_back({incidences[i].prev, i, -1});
+	}
+	std::sort(link.begin(), link.end());
+	parent.resize(count);
+	std::iota(parent.begin(), parent.end(), 0);
+
+	summary = {0, 0, 0, 0, 0};
+	const int numEntries = static_cast<int>(link.size());
+	for(int first = 0; first < numEntries;)
+	{
+		int last = first + 1;
+		while(last < numEntries && link[last].other == link[first].other)
+			++last;
+		const vtkIdType other = link[first].other;
+		const int faces = last - first;
+		if(other != point)//repeated point of a degenerate polygon
+		{
+			// the polygons sharing a manifold edge belong to the same fan, polygons around a non-manifold edge
+			// are joined too so that the edge is reported once and not again through its points
+			for(int i = first + 1; i < last; ++i)
+				Unite(parent, link[first].incidence, link[i].incidence);
+			if(other > point)
+			{
+				++summary.edges;
+				if(faces == 1)
+				{
+					++summary.boundaryEdges;
+					if(boundaryEdges)
+						boundaryEdges->push_back({point, other});
+				}
+				else if(faces == 2)
+				{
+					if(link[first].direction == link[first+1].direction)
+						++summary.inconsistentEdges;
+				}
+				else
+				{
+					++summary.nonManifoldEdges;
+					if(nonManifoldEdges)
+						nonManifoldEdges->push_back({point, other});
+				}
+			}
+		}
+		first = last;
+	}
+	for(int i = 0; i < count; ++i)
+	{
+		if(parent[i] == i)
+			++summary.fans;
+	}
+}
+}
+
+CMeshTopology::CMeshTopology()
+	: m_mtime(0)
+	, m_bParallel(true)
+	, m_dAnalysisTime(0.0)
+	, m_report()
+{
+}
+
+void CMeshTopology::SetParallel(bool parallel)
+{
+	m_bParallel = parallel;
+}
+
+bool CMeshTopology::GetParallel() const
+{
+	return m_bParallel;
+}
+
+void CMeshTopology::Clear()
+{
+	m_polydata = nullptr;
+	m_mtime = 0;
+	m_report = Report();
+}
+
+const CMeshTopology::Report& CMeshTopology::Analyze(vtkSmartPointer<vtkPolyData> polydata)
+{
+	if(!polydata)
+	{
+		Clear();
+		return m_report;
+	}
+	if(m_polydata.GetPointer() == polydata.GetPointer() && m_mtime == polydata->GetMTime())
+		return m_report;
+
+	const auto startTime = std::chrono::steady_clock::now();
+	m_report = Report();
+	const vtkIdType numPoints = polydata->GetNumberOfPoints();
+	vtkCellArray* polys = polydata->GetPolys();
+	const vtkIdType* conn = polys ? polys->GetPointer() : nullptr;
+	const vtkIdType numPolys = polys ? polys->GetNumberOfCells() : 0;
+
+	// bucket the corners by point: count, prefix sum, fill
+	std::vector<vtkIdType> offsets(numPoints + 1, 0);
+	vtkIdType numFaces(0);
+	for(vtkIdType c = 0, pos = 0; c < numPolys; ++c, pos += conn[pos] + 1)
+	{
+		const vtkIdType n = conn[pos];
+		if(n < 3)
+			continue;
+		++numFaces;
+		for(vtkIdType k = 0; k < n; ++k)
+			++offsets[conn[pos+1+k] + 1];
+	}
+	for(vtkIdType i = 0; i < numPoints; ++i)
+		offsets[i+1] += offsets[i];
+	std::vector<Incidence> incidences(offsets[numPoints]);
+	{
+		std::vector<vtkIdType> cursor(offsets.cbegin(), offsets.cend() - 1);
+		for(vtkIdType c = 0, pos = 0; c < numPolys; ++c, pos += conn[pos] + 1)
+		{
+			const vtkIdType n = conn[pos];
+			if(n < 3)
+				continue;
+			const vtkIdType* ids = conn + pos + 1;
+			for(vtkIdType k = 0; k < n; ++k)
+				incidences[cursor[ids[k]]++] = {ids[(k+n-1) % n], ids[(k+1) % n]};
+		}
+	}
+
+	// resolve every bucket, which is what a point owns in the edge table
+	std::vector<PointSummary> summaries(numPoints);
+	auto resolve = [&offsets, &incidences, &summaries](vtkIdType begin, vtkIdType end)
+	{
+		std::vector<LinkEntry> link;
+		std::vector<int> parent;
+		for(vtkIdType i = begin; i < end; ++i)
+		{
+			const int count = static_cast<int>(offsets[i+1] - offsets[i]);
+			AnalyzePoint(i, incidences.data() + offsets[i], count, link, parent, summaries[i], nullptr, nullptr);
+		}
+	};
+	if(m_bParallel)
+		vtkSMPTools::For(0, numPoints, resolve);
+	else
+		resolve(0, numPoints);
+
+	// gather in point order, only the points with offending edges are resolved again to list them
+	std::vector<std::array<vtkIdType, 2>> boundaryEdges;
+	std::vector<LinkEntry> link;
+	std::vector<int> parent;
+	for(vtkIdType i = 0; i < numPoints; ++i)
+	{
+		const PointSummary& summary = summaries[i];
+		if(offsets[i+1] == offsets[i])
+			continue;
+		++m_report.numPoints;
+		m_report.numEdges += summary.edges;
+		m_report.numBoundaryEdges += summary.boundaryEdges;
+		m_report.numInconsistentEdges += summary.inconsistentEdges;
+		if(summary.fans > 1)
+			m_report.nonManifoldPoints.push_back(i);
+		if(summary.boundaryEdges > 0 || summary.nonManifoldEdges > 0)
+		{
+			PointSummary again;
+			AnalyzePoint(i, incidences.data() + offsets[i], static_cast<int>(offsets[i+1] - offsets[i]), link, parent, again, &m_report.nonManifoldEdges, &boundaryEdges);
+		}
+	}
+	m_report.numFaces = numFaces;
+	std::vector<PointSummary>().swap(summaries);
+	std::vector<Incidence>().swap(incidences);
+
+	// components and boundary loops: the number of merges of a union-find over the points
+	std::vector<vtkIdType> points(numPoints);
+	std::iota(points.begin(), points.end(), vtkIdType(0));
+	vtkIdType merges(0);
+	for(vtkIdType c = 0, pos = 0; c < numPolys; ++c, pos += conn[pos] + 1)
+	{
+		const vtkIdType n = conn[pos];
+		for(vtkIdType k = 1; n >= 3 && k < n; ++k)
+			merges += Unite(points, conn[pos+1], conn[pos+1+k]);
+	}
+	m_report.numComponents = m_report.numPoints - merges;
+
+	if(!boundaryEdges.empty())
+	{
+		std::iota(points.begin(), points.end(), vtkIdType(0));
+		std::vector<char> onBoundary(numPoints, 0);
+		vtkIdType numBoundaryPoints(0);
+		merges = 0;
+		for(const auto& edge : boundaryEdges)
+		{
+			for(const vtkIdType p : edge)
+			{
+				numBoundaryPoints += !onBoundary[p];
+				onBoundary[p] = 1;
+			}
+			merges += Unite(points, edge[0], edge[1]);
+		}
+		m_report.numBoundaryLoops = numBoundaryPoints - merges;
+	}
+
+	m_report.eulerCharacteristic = m_report.numPoints - m_report.numEdges + m_report.numFaces;
+	// chi = 2 C - 2 g - B for orientable surfaces. Without inconsistent edges the orientation itself proves the
+	// mesh orientable, otherwise the polygons are checked for a flip that would fix every edge.
+	const vtkIdType twiceGenus = 2 * m_report.numComponents - m_report.eulerCharacteristic - m_report.numBoundaryLoops;
+	const bool orientable = m_report.numInconsistentEdges == 0 || (m_report.IsManifold() && IsOrientable(conn, numPolys, numFaces));
+	m_report.genus = m_report.IsManifold() && orientable && twiceGenus >= 0 && twiceGenus % 2 == 0 ? twiceGenus / 2 : -1;
+
+	m_polydata = polydata.GetPointer();
+	m_mtime = polydata->GetMTime();
+	m_dAnalysisTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	return m_report;
+}
+
+double CMeshTopology::AnalysisTime() const
+{
+	return m_dAnalysisTime;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <vtkSmartPointer.h>
+#include <vtkWeakPointer.h>
+#include <vtkType.h>
+
+class vtkPolyData;
+
+// *****
+// Topology report of the polygons of a polydata without generating any geometry.
+// The corners of the polygons are bucketed by point id in one pass over the connectivity, which makes an edge
+// table keyed by the smaller point of every edge, then the buckets are resolved in parallel: each point counts
+// the edges it owns, the boundary, non-manifold and inconsistently oriented ones, and the fans of polygons
+// around it. A point whose polygons form more than one fan (two cones touching by their apex) is non-manifold.
+// The report is cached against the polydata and its MTime, analyzing an unchanged polydata again is free.
+// Vertices, lines and strips are ignored.
+// *****
+class CMeshTopology
+{
+public:
+	struct Report
+	{
+		vtkIdType numPoints;//points used by at least one polygon
+		vtkIdType numEdges;
+		vtkIdType numFaces;
+		vtkIdType numBoundaryEdges;
+		vtkIdType numInconsistentEdges;//edges of two polygons going the same direction
+		vtkIdType numBoundaryLoops;
+		vtkIdType numComponents;//connected through shared points
+		vtkIdType eulerCharacteristic;//points - edges + faces
+		vtkIdType genus;//-1 when the mesh is not a manifold or not orientable
+		std::vector<std::array<vtkIdType, 2>> nonManifoldEdges;//point ids (smaller first) of edges with more than two polygons
+		std::vector<vtkIdType> nonManifoldPoints;
+
+		bool IsManifold() const { return nonManifoldEdges.empty() && nonManifoldPoints.empty(); }
+		bool IsClosed() const { return numBoundaryEdges == 0; }
+	};
+
+	CMeshTopology();
+
+	void SetParallel(bool parallel);
+	bool GetParallel() const;
+
+	// returns the cached report when polydata has not been modified since the last call
+	const Report& Analyze(vtkSmartPointer<vtkPolyData> polydata);
+	void Clear();
+
+	double AnalysisTime() const;//seconds spent in the last analysis that was not cached
+
+private:
+	vtkWeakPointer<vtkPolyData> m_polydata;
+	vtkMTimeType m_mtime;
+	bool m_bParallel;
+	double m_dAnalysisTime;
+	Report m_report;
+};
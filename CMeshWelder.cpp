@@ -0,0 +1,361 @@
+#include "CMeshWelder.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <vtkPolyData.h>
+#include <vtkPoints.h>
+#include <vtkCellArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkIdList.h>
+#include <vtkPointData.h>
+#include <vtkCellData.h>
+#include <vtkSMPTools.h>
+
+namespace
+{
+struct HashEntry
+{
+	std::uint64_t hash;
+	vtkIdType id;
+
+	bool operator<(const HashEntry& other) const
+	{
+		return hash != other.hash ? hash < other.hash : id < other.id;
+	}
+};
+
+using VertexKey = std::array<long long, 3>;
+
+std::uint64_t HashKey(const VertexKey& key)
+{
+	std::uint64_t h = static_cast<std::uint64_t>(key[0]) * 0x9E3779B97F4A7C15ull;
+	h ^= static_cast<std::uint64_t>(key[1]) * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2);
+	h ^= static_cast<std::uint64_t>(key[2]) * 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+	h ^= h >> 29;
+	return h;
+}
+}
+
+CMeshWelder::CMeshWelder()
+	: m_dTolerance(0.0)
+	, m_bToleranceIsAbsolute(false)
+	, m_bParallel(true)
+	, m_dWeldTime(0.0)
+	, m_duplicateCount(0)
+	, m_degenerateCount(0)
+{
+}
+
+void CMeshWelder::SetTolerance(double tolerance)
+{
+	m_dTolerance = std::max(0.0, tolerance);
+}
+
+double CMeshWelder::GetTolerance() const
+{
+	return m_dTolerance;
+}
+
+void CMeshWelder::SetToleranceIsAbsolute(bool absolute)
+{
+	m_bToleranceIsAbsolute = absolute;
+}
+
+bool CMeshWelder::GetToleranceIsAbsolute() const
+{
+	return m_bToleranceIsAbsolute;
+}
+
+void CMeshWelder::SetParallel(bool parallel)
+{
+	m_bParallel = parallel;
+}
+
+bool CMeshWelder::GetParallel() const
+{
+	return m_bParallel;
+}
+
+bool CMeshWelder::IsTriangleMesh(vtkPolyData* polydata)
+{
+	if(!polydata || !polydata->GetPoints() || polydata->GetNumberOfVerts() > 0 || polydata->GetNumberOfLines() > 0 || polydata->GetNumberOfStrips() > 0)
+		return false;
+	vtkCellArray* polys = polydata->GetPolys();
+	return polys && polys->GetNumberOfCells() > 0 && polys->GetMaxCellSize() == 3
+		&& polys->GetNumberOfConnectivityEntries() == 4 * polys->GetNumberOfCells();
+}
+
+vtkSmartPointer<vtkPolyData> CMeshWelder::Weld(vtkSmartPointer<vtkPolyData> polydata)
+{
+	if(!IsTriangleMesh(polydata))
+		return nullptr;
+	return WeldTriangles(polydata->GetPoints(), polydata->GetPolys()->GetPointer(), polydata->GetNumberOfPolys(), polydata);
+}
+
+vtkSmartPointer<vtkPolyData> CMeshWelder::WeldSoup(vtkSmartPointer<vtkPoints> corners)
+{
+	if(!corners)
+		return nullptr;
+	const vtkIdType numTriangles = corners->GetNumberOfPoints() / 3;
+	return WeldTriangles(std::move(corners), nullptr, numTriangles, nullptr);
+}
+
+vtkSmartPointer<vtkPolyData> CMeshWelder::WeldTriangles(vtkSmartPointer<vtkPoints> points, const vtkIdType* cellArray, vtkIdType numTriangles, vtkPolyData* attributes)
+{
+	const auto startTime = std::chrono::steady_clock::now();
+	m_duplicateCount = 0;
+	m_degenerateCount = 0;
+	auto run = [this](vtkIdType n, auto&& functor)
+	{
+		if(m_bParallel)
+			vtkSMPTools::For(0, n, functor);
+		else
+			functor(0, n);
+	};
+	auto corner = [cellArray](vtkIdType triangle, int k) { return cellArray ? cellArray[4*triangle+1+k] : 3*triangle+k; };
+
+	const vtkIdType numPoints = points->GetNumberOfPoints();
+	double bounds[6];
+	points->GetBounds(bounds);
+	const double diagonal = std::sqrt((bounds[1]-bounds[0])*(bounds[1]-bounds[0]) + (bounds[3]-bounds[2])*(bounds[3]-bounds[2]) + (bounds[5]-bounds[4])*(bounds[5]-bounds[4]));
+	const double tolerance = m_bToleranceIsAbsolute ? m_dTolerance : m_dTolerance * diagonal;
+	const bool exact = !(tolerance > 0.0);
+	const double origin[3] = {bounds[0], bounds[2], bounds[4]};
+	auto keyOf = [&points, exact, tolerance, &origin](vtkIdType id)
+	{
+		VertexKey key;
+		double x[3];
+		points->GetPoint(id, x);
+		for(int j = 0; j < 3; ++j)
+		{
+			if(exact)
+			{
+				const double value = x[j] + 0.0;//-0.0 and 0.0 get the same bits
+				std::memcpy(&key[j], &value, sizeof(value));
+			}
+			else
+			{
+				key[j] = static_cast<long long>(std::floor((x[j] - origin[j]) / tolerance));
+			}
+		}
+		return key;
+	};
+
+	// hash, sort, then merge the equal keys inside each run of equal hash into its smallest id
+	std::vector<HashEntry> entries(numPoints);
+	run(numPoints, [&entries, &keyOf](vtkIdType begin, vtkIdType end)
+	{
+		for(vtkIdType i = begin; i < end; ++i)
+			entries[i] = {HashKey(keyOf(i)), i};
+	});
+	if(m_bParallel)
+		vtkSMPTools::Sort(entries.begin(), entries.end());
+	else
+		std::sort(entries.begin(), entries.end());
+
+	std::vector<vtkIdType> representative(numPoints);
+	if(exact)
+	{
+		std::vector<VertexKey> runKeys;
+		std::vector<vtkIdType> runIds;
+		for(vtkIdType first = 0; first < numPoints;)
+		{
+			vtkIdType last = first + 1;
+			while(last < numPoints && entries[last].hash == entries[first].hash)
+				++last;
+			if(last - first == 1)
+			{
+				representative[entries[first].id] = entries[first].id;
+			}
+			else
+			{
+				// the runs are as long as the duplicates of a vertex, hash collisions only add a few keys
+				runKeys.clear();
+				runIds.clear();
+				for(vtkIdType i = first; i < last; ++i)
+				{
+					const VertexKey key = keyOf(entries[i].id);
+					const auto pos = std::find(runKeys.cbegin(), runKeys.cend(), key) - runKeys.cbegin();
+					if(pos == static_cast<std::ptrdiff_t>(runKeys.size()))
+					{
+						runKeys.push_back(key);
+						runIds.push_back(entries[i].id);
+					}
+					else
+					{
+						++m_duplicateCount;
+					}
+					representative[entries[i].id] = runIds[pos];
+				}
+			}
+			first = last;
+		}
+	}
+	else
+	{
+		// a vertex merges into the smallest earlier representative within the tolerance, like vtkCleanPolyData
+		// inserting the points in id order. The cells are one tolerance wide so the candidates lie in the 3x3x3
+		// cells around the vertex, found by their hash in the sorted entries. The pass is sequential because
+		// each vertex depends on the representatives before it.
+		const double tolerance2 = tolerance * tolerance;
+		for(vtkIdType i = 0; i < numPoints; ++i)
+		{
+			const VertexKey key = keyOf(i);
+			double x[3];
+			points->GetPoint(i, x);
+			vtkIdType best = i;
+			for(int n = 0; n < 27; ++n)
+			{
+				const VertexKey cell = {key[0] + n % 3 - 1, key[1] + n / 3 % 3 - 1, key[2] + n / 9 - 1};
+				const std::uint64_t hash = HashKey(cell);
+				auto it = std::lower_bound(entries.cbegin(), entries.cend(), HashEntry{hash, 0});
+				// within a run the ids are ascending, only the earlier vertices are candidates
+				for(; it != entries.cend() && it->hash == hash && it->id < best; ++it)
+				{
+					if(representative[it->id] != it->id)
+						continue;
+					double y[3];
+					points->GetPoint(it->id, y);
+					const double distance2 = (x[0]-y[0])*(x[0]-y[0]) + (x[1]-y[1])*(x[1]-y[1]) + (x[2]-y[2])*(x[2]-y[2]);
+					if(distance2 <= tolerance2)
+						best = it->id;
+				}
+			}
+			representative[i] = best;
+			if(best != i)
+				++m_duplicateCount;
+		}
+	}
+	std::vector<HashEntry>().swap(entries);
+
+	// keep the triangles with three distinct vertices, then number the used representatives in id order
+	std::vector<char> keep(numTriangles);
+	run(numTriangles, [&keep, &representative, &corner](vtkIdType begin, vtkIdType end)
+	{
+		for(vtkIdType t = begin; t < end; ++t)
+		{
+			const vtkIdType a = representative[corner(t, 0)];
+			const vtkIdType b = representative[corner(t, 1)];
+			const vtkIdType c = representative[corner(t, 2)];
+			keep[t] = a != b && b != c && c != a;
+		}
+	});
+	std::vector<vtkIdType> triangleOffset(numTriangles + 1, 0);
+	std::vector<char> used(numPoints, 0);
+	for(vtkIdType t = 0; t < numTriangles; ++t)
+	{
+		triangleOffset[t+1] = triangleOffset[t] + keep[t];
+		for(int k = 0; keep[t] && k < 3; ++k)
+			used[representative[corner(t, k)]] = 1;
+	}
+	const vtkIdType numKept = triangleOffset[numTriangles];
+	m_degenerateCount = numTriangles - numKept;
+	std::vector<vtkIdType> newId(numPoints, -1);
+	vtkIdType numUsed(0);
+	for(vtkIdType i = 0; i < numPoints; ++i)
+	{
+		if(used[i])
+			newId[i] = numUsed++;
+	}
+	std::vector<char>().swap(used);
+
+	auto outPoints = vtkSmartPointer<vtkPoints>::New();
+	outPoints->SetDataType(points->GetDataType());
+	outPoints->SetNumberOfPoints(numUsed);
+	run(numPoints, [&points, &outPoints, &newId](vtkIdType begin, vtkIdType end)
+	{
+		double x[3];
+		for(vtkIdType i = begin; i < end; ++i)
+		{
+			if(newId[i] < 0)
+				continue;
+			points->GetPoint(i, x);
+			outPoints->SetPoint(newId[i], x);
+		}
+	});
+	// the last reference to a soup moved into WeldSoup(), it is freed before the connectivity is allocated
+	points = nullptr;
+
+	auto connectivity = vtkSmartPointer<vtkIdTypeArray>::New();
+	connectivity->SetNumberOfValues(4 * numKept);
+	vtkIdType* conn = connectivity->GetPointer(0);
+	run(numTriangles, [conn, &keep, &triangleOffset, &representative, &newId, &corner](vtkIdType begin, vtkIdType end)
+	{
+		for(vtkIdType t = begin; t < end; ++t)
+		{
+			if(!keep[t])
+				continue;
+			vtkIdType* cell = conn + 4 * triangleOffset[t];
+			cell[0] = 3;
+			for(int k = 0; k < 3; ++k)
+				cell[k+1] = newId[representative[corner(t, k)]];
+		}
+	});
+	auto polys = vtkSmartPointer<vtkCellArray>::New();
+	polys->SetCells(numKept, connectivity);
+
+	auto ret = vtkSmartPointer<vtkPolyData>::New();
+	ret->SetPoints(outPoints);
+	ret->SetPolys(polys);
+
+	if(attributes && attributes->GetPointData()->GetNumberOfArrays() > 0)
+	{
+		auto fromIds = vtkSmartPointer<vtkIdList>::New();
+		auto toIds = vtkSmartPointer<vtkIdList>::New();
+		fromIds->SetNumberOfIds(numUsed);
+		toIds->SetNumberOfIds(numUsed);
+		for(vtkIdType i = 0; i < numPoints; ++i)
+		{
+			if(newId[i] >= 0)
+			{
+				fromIds->SetId(newId[i], i);
+				toIds->SetId(newId[i], newId[i]);
+			}
+		}
+		ret->GetPointData()->CopyAllocate(attributes->GetPointData(), numUsed);
+		ret->GetPointData()->CopyData(attributes->GetPointData(), fromIds, toIds);
+	}
+	if(attributes && attributes->GetCellData()->GetNumberOfArrays() > 0)
+	{
+		// a triangle mesh has only polys, the cell id is the triangle index
+		auto fromIds = vtkSmartPointer<vtkIdList>::New();
+		auto toIds = vtkSmartPointer<vtkIdList>::New();
+		fromIds->SetNumberOfIds(numKept);
+		toIds->SetNumberOfIds(numKept);
+		for(vtkIdType t = 0; t < numTriangles; ++t)
+		{
+			if(keep[t])
+			{
+				fromIds->SetId(triangleOffset[t], t);
+				toIds->SetId(triangleOffset[t], triangleOffset[t]);
+			}
+		}
+		ret->GetCellData()->CopyAllocate(attributes->GetCellData(), numKept);
+		ret->GetCellData()->CopyData(attributes->GetCellData(), fromIds, toIds);
+	}
+
+	m_dWeldTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	return ret;
+}
+
+double CMeshWelder::WeldTime() const
+{
+	return m_dWeldTime;
+}
+
+vtkIdType CMeshWelder::DuplicateCount() const
+{
+	return m_duplicateCount;
+}
+
+vtkIdType CMeshWelder::DegenerateCount() const
+{
+	return m_degenerateCount;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <vtkSmartPointer.h>
+#include <vtkType.h>
+
+class vtkPolyData;
+class vtkPoints;
+
+// *****
+// Merges the coincident vertices of a triangle mesh and drops the triangles that become degenerate.
+// Every vertex gets a 64 bit hash of its coordinates (bit exact with a zero tolerance, otherwise quantized
+// to cells one tolerance wide), the (hash, id) pairs are sorted with vtkSMPTools::Sort and the vertices of equal key
+// inside a run of equal hash are merged into the smallest id, so the result does not depend on the thread count.
+// With a tolerance a vertex is merged into the smallest earlier kept vertex within the tolerance, searched in the
+// 27 cells around it, which is sequential.
+// Only the points used by the remaining triangles are kept, point data and cell data are copied.
+// *****
+class CMeshWelder
+{
+public:
+	CMeshWelder();
+
+	// 0 merges bit identical coordinates only, which is the default
+	void SetTolerance(double tolerance);
+	double GetTolerance() const;
+	// false (default) takes the tolerance as a fraction of the bounds diagonal, like vtkCleanPolyData
+	void SetToleranceIsAbsolute(bool absolute);
+	bool GetToleranceIsAbsolute() const;
+	void SetParallel(bool parallel);
+	bool GetParallel() const;
+
+	// only polys of three points, no vertices, lines or strips
+	static bool IsTriangleMesh(vtkPolyData* polydata);
+
+	// polydata must be a triangle mesh (IsTriangleMesh()), nullptr is returned otherwise
+	vtkSmartPointer<vtkPolyData> Weld(vtkSmartPointer<vtkPolyData> polydata);
+	// corners holds three consecutive points per triangle, like the triangles of a STL file.
+	// When the caller moves its only reference in, the soup is freed as soon as the output points are copied.
+	vtkSmartPointer<vtkPolyData> WeldSoup(vtkSmartPointer<vtkPoints> corners);
+
+	double WeldTime() const;//seconds spent in the last weld
+	vtkIdType DuplicateCount() const;//vertices merged into another one in the last weld
+	vtkIdType DegenerateCount() const;//triangles dropped in the last weld
+
+private:
+	// cellArray is the legacy (3, a, b, c) connectivity of the triangles, nullptr for a soup
+	vtkSmartPointer<vtkPolyData> WeldTriangles(vtkSmartPointer<vtkPoints> points, const vtkIdType* cellArray, vtkIdType numTriangles, vtkPolyData* attributes);
+
+private:
+	double m_dTolerance;
+	bool m_bToleranceIsAbsolute;
+	bool m_bParallel;
+	double m_dWeldTime;
+	vtkIdType m_duplicateCount;
+	vtkIdType m_degenerateCount;
+};
@@ -0,0 +1,290 @@
+#include "CPointGridIndex.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#include <vtkPoints.h>
+
+namespace
+{
+struct SerializedHeader
+{
+	std::uint32_t version;
+	std::uint32_t idSize;//sizeof(vtkIdType) of the writer
+	std::int32_t dims[3];
+	std::uint32_t reserved;
+	double origin[3];
+	double bucketSize[3];
+	std::uint64_t pointCount;
+	std::uint64_t bucketCount;
+};
+static_assert(sizeof(SerializedHeader) == 88, "the header layout is part of the serialized index");
+const std::uint32_t SerializedVersion = 1;
+}
+
+CPointGridIndex::CPointGridIndex()
+	: m_points(nullptr)
+	, m_origin({0.0, 0.0, 0.0})
+	, m_bucketSize({1.0, 1.0, 1.0})
+	, m_dims({0, 0, 0})
+	, m_dBuildTime(0.0)
+{
+}
+
+void CPointGridIndex::Build(vtkSmartPointer<vtkPoints> points, int pointsPerBucket)
+{
+	const auto startTime = std::chrono::steady_clock::now();
+	Clear();
+	if(!points || points->GetNumberOfPoints() == 0)
+		return;
+	m_points = points;
+
+	const vtkIdType numPoints = points->GetNumberOfPoints();
+	double bounds[6];
+	points->GetBounds(bounds);
+
+	// choose a bucket count close to numPoints / pointsPerBucket, spread over the axes by extent
+	std::array<double, 3> length;
+	double volume(1.0);
+	int nonFlatAxes(0);
+	for(int i = 0; i < 3; ++i)
+	{
+		length[i] = bounds[2*i+1] - bounds[2*i];
+		if(length[i] > 0.0)
+		{
+			volume *= length[i];
+			++nonFlatAxes;
+		}
+	}
+	const double targetBuckets = std::max(1.0, static_cast<double>(numPoints) / std::max(1, pointsPerBucket));
+	const double bucketLength = nonFlatAxes > 0 ? std::pow(volume / targetBuckets, 1.0 / nonFlatAxes) : 1.0;
+	for(int i = 0; i < 3; ++i)
+	{
+		m_origin[i] = bounds[2*i];
+		if(length[i] > 0.0 && bucketLength > 0.0)
+		{
+			m_dims[i] = static_cast<int>(std::min(1024.0, std::max(1.0, std::ceil(length[i] / bucketLength))));
+			m_bucketSize[i] = length[i] / m_dims[i];
+		}
+		else
+		{
+			m_dims[i] = 1;
+			m_bucketSize[i] = 1.0;
+		}
+	}
+
+	// counting sort of the point ids by bucket
+	const vtkIdType numBuckets = static_cast<vtkIdType>(m_dims[0]) * m_dims[1] * m_dims[2];
+	m_bucketOffsets.assign(numBuckets + 1, 0);
+	double x[3];
+	for(vtkIdType i = 0; i < numPoints; ++i)
+	{
+		points->GetPoint(i, x);
+		++m_bucketOffsets[BucketIndex(BucketCoord(x)) + 1];
+	}
+	for(vtkIdType b = 0; b < numBuckets; ++b)
+		m_bucketOffsets[b+1] += m_bucketOffsets[b];
+
+	m_pointIds.resize(numPoints);
+	std::vector<vtkIdType> insertPos(m_bucketOffsets.cbegin(), m_bucketOffsets.cend() - 1);
+	for(vtkIdType i = 0; i < numPoints; ++i)
+	{
+		points->GetPoint(i, x);
+		m_pointIds[insertPos[BucketIndex(BucketCoord(x))]++] = i;
+	}
+
+	m_dBuildTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void CPointGridIndex::Clear()
+{
+	m_points = nullptr;
+	m_dims = {0, 0, 0};
+	m_bucketOffsets.clear();
+	m_bucketOffsets.shrink_to_fit();
+	m_pointIds.clear();
+	m_pointIds.shrink_to_fit();
+	m_dBuildTime = 0.0;
+}
+
+bool CPointGridIndex::IsBuilt() const
+{
+	return m_points != nullptr;
+}
+
+vtkPoints* CPointGridIndex::Points() const
+{
+	return m_points;
+}
+
+std::vector<char> CPointGridIndex::Serialize() const
+{
+	if(!IsBuilt())
+		return std::vector<char>();
+	SerializedHeader header = {};
+	header.version = SerializedVersion;
+	header.idSize = sizeof(vtkIdType);
+	std::copy(m_dims.cbegin(), m_dims.cend(), header.dims);
+	std::copy(m_origin.cbegin(), m_origin.cend(), header.origin);
+	std::copy(m_bucketSize.cbegin(), m_bucketSize.cend(), header.bucketSize);
+	header.pointCount = m_pointIds.size();
+	header.bucketCount = m_bucketOffsets.size() - 1;
+
+	const std::size_t offsetsSize = m_bucketOffsets.size() * sizeof(vtkIdType);
+	const std::size_t idsSize = m_pointIds.size() * sizeof(vtkIdType);
+	std::vector<char> ret(sizeof(header) + offsetsSize + idsSize);
+	std::memcpy(ret.data(), &header, sizeof(header));
+	std::memcpy(ret.data() + sizeof(header), m_bucketOffsets.data(), offsetsSize);
+	std::memcpy(ret.data() + sizeof(header) + offsetsSize, m_pointIds.data(), idsSize);
+	return ret;
+}
+
+bool CPointGridIndex::Deserialize(vtkSmartPointer<vtkPoints> points, const void* data, std::uint64_t size)
+{
+	Clear();
+	SerializedHeader header;
+	if(!points || !data || size < sizeof(header))
+		return false;
+	std::memcpy(&header, data, sizeof(header));
+	if(header.version != SerializedVersion || header.idSize != sizeof(vtkIdType)
+		|| header.pointCount != static_cast<std::uint64_t>(points->GetNumberOfPoints()) || header.pointCount == 0
+		|| header.dims[0] <= 0 || header.dims[1] <= 0 || header.dims[2] <= 0
+		|| header.bucketCount != std::uint64_t(header.dims[0]) * header.dims[1] * header.dims[2]
+		|| size != sizeof(header) + (header.bucketCount + 1 + header.pointCount) * sizeof(vtkIdType))
+		return false;
+
+	// BucketCoord() needs finite positive bucket sizes to stay inside the grid
+	for(int i = 0; i < 3; ++i)
+	{
+		if(!(header.bucketSize[i] > 0.0) || !std::isfinite(header.bucketSize[i]) || !std::isfinite(header.origin[i]))
+			return false;
+	}
+
+	// a corrupted sidecar with a matching key must not send the queries out of the arrays
+	const char* arrays = static_cast<const char*>(data) + sizeof(header);
+	m_bucketOffsets.resize(static_cast<std::size_t>(header.bucketCount + 1));
+	std::memcpy(m_bucketOffsets.data(), arrays, m_bucketOffsets.size() * sizeof(vtkIdType));
+	if(m_bucketOffsets.front() != 0 || m_bucketOffsets.back() != static_cast<vtkIdType>(header.pointCount)
+		|| !std::is_sorted(m_bucketOffsets.cbegin(), m_bucketOffsets.cend()))
+	{
+		Clear();
+		return false;
+	}
+	m_pointIds.resize(static_cast<std::size_t>(header.pointCount));
+	std::memcpy(m_pointIds.data(), arrays + m_bucketOffsets.size() * sizeof(vtkIdType), m_pointIds.size() * sizeof(vtkIdType));
+	const vtkIdType pointCount = static_cast<vtkIdType>(header.pointCount);
+	if(std::any_of(m_pointIds.cbegin(), m_pointIds.cend(), [pointCount](vtkIdType id) { return id < 0 || id >= pointCount; }))
+	{
+		Clear();
+		return false;
+	}
+	std::copy(header.dims, header.dims + 3, m_dims.begin());
+	std::copy(header.origin, header.origin + 3, m_origin.begin());
+	std::copy(header.bucketSize, header.bucketSize + 3, m_bucketSize.begin());
+	m_points = points;
+	return true;
+}
+
+void CPointGridIndex::FindPointsWithinRadius(const std::array<double, 3>& center, double radius, std::vector<vtkIdType>& outIds) const
+{
+	outIds.clear();
+	if(!IsBuilt() || radius < 0.0)
+		return;
+
+	const double lower[3] = {center[0] - radius, center[1] - radius, center[2] - radius};
+	const double upper[3] = {center[0] + radius, center[1] + radius, center[2] + radius};
+	const auto minCoord = BucketCoord(lower);
+	const auto maxCoord = BucketCoord(upper);
+	const double radius2 = radius * radius;
+	double x[3];
+	for(int k = minCoord[2]; k <= maxCoord[2]; ++k)
+	{
+		for(int j = minCoord[1]; j <= maxCoord[1]; ++j)
+		{
+			for(int i = minCoord[0]; i <= maxCoord[0]; ++i)
+			{
+				const vtkIdType bucket = BucketIndex({i, j, k});
+				for(vtkIdType n = m_bucketOffsets[bucket]; n < m_bucketOffsets[bucket+1]; ++n)
+				{
+					const vtkIdType ptId = m_pointIds[n];
+					m_points->GetPoint(ptId, x);
+					const double dist2 = (x[0]-center[0])*(x[0]-center[0]) + (x[1]-center[1])*(x[1]-center[1]) + (x[2]-center[2])*(x[2]-center[2]);
+					if(dist2 <= radius2)
+						outIds.push_back(ptId);
+				}
+			}
+		}
+	}
+}
+
+// points whose distance to the segment pt1-pt2 is not larger than radius
+void CPointGridIndex::FindPointsWithinCapsule(const std::array<double, 3>& pt1, const std::array<double, 3>& pt2, double radius, std::vector<vtkIdType>& outIds) const
+{
+	outIds.clear();
+	if(!IsBuilt() || radius < 0.0)
+		return;
+
+	double lower[3], upper[3];
+	for(int i = 0; i < 3; ++i)
+	{
+		lower[i] = std::min(pt1[i], pt2[i]) - radius;
+		upper[i] = std::max(pt1[i], pt2[i]) + radius;
+	}
+	const auto minCoord = BucketCoord(lower);
+	const auto maxCoord = BucketCoord(upper);
+	const double axis[3] = {pt2[0] - pt1[0], pt2[1] - pt1[1], pt2[2] - pt1[2]};
+	const double axisLength2 = axis[0]*axis[0] + axis[1]*axis[1] + axis[2]*axis[2];
+	const double radius2 = radius * radius;
+	double x[3];
+	for(int k = minCoord[2]; k <= maxCoord[2]; ++k)
+	{
+		for(int j = minCoord[1]; j <= maxCoord[1]; ++j)
+		{
+			for(int i = minCoord[0]; i <= maxCoord[0]; ++i)
+			{
+				const vtkIdType bucket = BucketIndex({i, j, k});
+				for(vtkIdType n = m_bucketOffsets[bucket]; n < m_bucketOffsets[bucket+1]; ++n)
+				{
+					const vtkIdType ptId = m_pointIds[n];
+					m_points->GetPoint(ptId, x);
+					const double v[3] = {x[0] - pt1[0], x[1] - pt1[1], x[2] - pt1[2]};
+					double t = axisLength2 > 0.0 ? (v[0]*axis[0] + v[1]*axis[1] + v[2]*axis[2]) / axisLength2 : 0.0;
+					t = std::min(std::max(t, 0.0), 1.0);
+					const double d[3] = {v[0] - t*axis[0], v[1] - t*axis[1], v[2] - t*axis[2]};
+					if(d[0]*d[0] + d[1]*d[1] + d[2]*d[2] <= radius2)
+						outIds.push_back(ptId);
+				}
+			}
+		}
+	}
+}
+
+double CPointGridIndex::BuildTime() const
+{
+	return m_dBuildTime;
+}
+
+std::size_t CPointGridIndex::MemorySize() const
+{
+	return sizeof(*this)
+		+ m_bucketOffsets.capacity() * sizeof(vtkIdType)
+		+ m_pointIds.capacity() * sizeof(vtkIdType);
+}
+
+std::array<int, 3> CPointGridIndex::BucketCoord(const double x[3]) const
+{
+	std::array<int, 3> ret;
+	for(int i = 0; i < 3; ++i)
+	{
+		const double n = std::floor((x[i] - m_origin[i]) / m_bucketSize[i]);
+		ret[i] = static_cast<int>(std::min(std::max(n, 0.0), static_cast<double>(m_dims[i] - 1)));
+	}
+	return ret;
+}
+
+vtkIdType CPointGridIndex::BucketIndex(const std::array<int, 3>& coord) const
+{
+	return coord[0] + static_cast<vtkIdType>(m_dims[0]) * (coord[1] + static_cast<vtkIdType>(m_dims[1]) * coord[2]);
+}
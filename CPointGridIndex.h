@@ -0,0 +1,51 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <vector>
+#include <vtkSmartPointer.h>
+#include <vtkType.h>
+
+class vtkPoints;
+
+// *****
+// Uniform grid index over a point set.
+// The buckets are stored as CSR arrays: m_bucketOffsets[b] .. m_bucketOffsets[b+1] is the
+// range of m_pointIds belonging to bucket b. The index is built once by Build() and only read
+// by the queries afterwards, so one instance can serve many selections.
+// Serialize() dumps the grid and the CSR arrays as one block, Deserialize() takes them back over the same
+// points without touching the coordinates (used by the CMeshCache sidecar) and rejects arrays that would
+// index outside themselves or outside the points.
+// *****
+class CPointGridIndex
+{
+public:
+	CPointGridIndex();
+
+	void Build(vtkSmartPointer<vtkPoints> points, int pointsPerBucket = 4);
+	void Clear();
+	bool IsBuilt() const;
+	vtkPoints* Points() const;
+
+	std::vector<char> Serialize() const;
+	// false, leaving the index cleared, when data was not written by Serialize() over as many points
+	bool Deserialize(vtkSmartPointer<vtkPoints> points, const void* data, std::uint64_t size);
+
+	void FindPointsWithinRadius(const std::array<double, 3>& center, double radius, std::vector<vtkIdType>& outIds) const;
+	void FindPointsWithinCapsule(const std::array<double, 3>& pt1, const std::array<double, 3>& pt2, double radius, std::vector<vtkIdType>& outIds) const;
+
+	double BuildTime() const;
+	std::size_t MemorySize() const;
+
+private:
+	std::array<int, 3> BucketCoord(const double x[3]) const;
+	vtkIdType BucketIndex(const std::array<int, 3>& coord) const;
+
+private:
+	vtkSmartPointer<vtkPoints> m_points;
+	std::array<double, 3> m_origin;
+	std::array<double, 3> m_bucketSize;
+	std::array<int, 3> m_dims;
+	std::vector<vtkIdType> m_bucketOffsets;
+	std::vector<vtkIdType> m_pointIds;
+	double m_dBuildTime;//seconds
+};
@@ -0,0 +1,355 @@
+#include "CStlReader.h"
+#include "CMappedFile.h"
+#include "CMeshWelder.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <vtkPolyData.h>
+#include <vtkPoints.h>
+#include <vtkFloatArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkCellArray.h>
+#include <vtkSMPTools.h>
+
+namespace
+{
+const std::uint64_t HeaderSize = 84;//80 bytes of text and the triangle count
+const std::uint64_t RecordSize = 50;//normal, three vertices and the attribute byte count
+const std::uint64_t AsciiChunkSize = std::uint64_t(8) << 20;
+const vtkIdType AsciiBatchChunks = 8;//chunks parsed between two progress reports
+const vtkIdType BinaryBlockSize = vtkIdType(1) << 20;//triangles decoded between two progress reports
+const double ParseProgress = 0.8;//share of the parse in the reported progress, the weld takes the rest
+
+bool isSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// float records nearly always hold control or non ASCII bytes, an ASCII file never does
+bool isText(const char* begin, const char* end)
+{
+	return std::all_of(begin, end, [](char c) { return isSpace(c) || (c >= 0x20 && c < 0x7f); });
+}
+
+// the first character after the end of the line that contains position
+const char* nextLine(const char* position, const char* end)
+{
+	const char* newline = static_cast<const char*>(std::memchr(position, '\n', end - position));
+	return newline ? newline + 1 : end;
+}
+
+// parses "vertex x y z" lines in [begin, end), the other keywords of the format carry nothing needed
+void collectVertices(const char* begin, const char* end, std::vector<float>& values)
+{
+	for(const char* line = begin; line < end;)
+	{
+		const char* lineEnd = nextLine(line, end);
+		const char* c = line;
+		while(c < lineEnd && isSpace(*c))
+			++c;
+		if(lineEnd - c > 6 && std::memcmp(c, "vertex", 6) == 0 && isSpace(c[6]))
+		{
+			c += 6;
+			for(int j = 0; j < 3; ++j)
+			{
+				while(c < lineEnd && isSpace(*c))
+					++c;
+				if(c < lineEnd && *c == '+')
+					++c;
+				// from_chars ignores the locale, Qt applications may switch the decimal separator
+				float value(0.0f);
+				c = std::from_chars(c, lineEnd, value).ptr;
+				values.push_back(value);
+			}
+		}
+		line = lineEnd;
+	}
+}
+}
+
+CStlReader::CStlReader()
+	: m_bParallel(true)
+	, m_bBinary(false)
+	, m_bCanceled(false)
+	, m_previewPointCount(50000)
+	, m_triangleCount(0)
+	, m_dParseTime(0.0)
+	, m_dWeldTime(0.0)
+{
+}
+
+void CStlReader::SetParallel(bool parallel)
+{
+	m_bParallel = parallel;
+}
+
+bool CStlReader::GetParallel() const
+{
+	return m_bParallel;
+}
+
+void CStlReader::SetProgressCallback(ProgressCallback callback)
+{
+	m_progressCallback = std::move(callback);
+}
+
+void CStlReader::SetPreviewCallback(PreviewCallback callback, vtkIdType maxPoints)
+{
+	m_previewCallback = std::move(callback);
+	m_previewPointCount = std::max<vtkIdType>(1, maxPoints);
+}
+
+vtkSmartPointer<vtkPolyData> CStlReader::Read(const std::string& path)
+{
+	const auto startTime = std::chrono::steady_clock::now();
+	m_bBinary = false;
+	m_bCanceled = false;
+	m_triangleCount = 0;
+	m_dParseTime = 0.0;
+	m_dWeldTime = 0.0;
+	m_errorMessage.clear();
+
+	vtkSmartPointer<vtkPoints> soup;
+	{
+		CMappedFile file;
+		if(!file.Open(path))
+		{
+			m_errorMessage = "cannot open " + path;
+			return nullptr;
+		}
+		const char* data = file.Data();
+		const std::uint64_t size = file.Size();
+		std::uint64_t binaryTriangles(0);
+		const Format format = DetectFormat(data, size, binaryTriangles);
+		if(format == Format::Unknown)
+		{
+			m_errorMessage = path + " is neither a binary nor an ASCII STL file";
+			return nullptr;
+		}
+		m_bBinary = format == Format::Binary;
+		if(m_previewCallback)
+			m_previewCallback(Preview(data, size, binaryTriangles));
+		soup = m_bBinary ? ParseBinary(data, binaryTriangles) : ParseAscii(data, size);
+		if(soup && format == Format::AsciiOrBinary && soup->GetNumberOfPoints() == 0 && binaryTriangles > 0)
+		{
+			m_bBinary = true;
+			if(m_previewCallback)
+				m_previewCallback(Preview(data, size, binaryTriangles));
+			soup = ParseBinary(data, binaryTriangles);
+		}
+	}
+	if(!soup)
+	{
+		m_errorMessage = "reading " + path + " was canceled";
+		return nullptr;
+	}
+	m_triangleCount = soup->GetNumberOfPoints() / 3;
+	m_dParseTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	if(m_triangleCount == 0)
+	{
+		m_errorMessage = path + " has no triangle";
+		return nullptr;
+	}
+
+	// the welder frees the soup once the output points are copied
+	CMeshWelder welder;
+	welder.SetParallel(m_bParallel);
+	auto ret = welder.WeldSoup(std::move(soup));
+	m_dWeldTime = welder.WeldTime();
+	ReportProgress(1.0);
+	return ret;
+}
+
+CStlReader::Format CStlReader::DetectFormat(const char* data, std::uint64_t size, std::uint64_t& binaryTriangles)
+{
+	std::uint32_t count(0);
+	if(size >= HeaderSize)
+		std::memcpy(&count, data + 80, sizeof(count));
+	const bool countFits = size >= HeaderSize && size >= HeaderSize + RecordSize * count;
+	binaryTriangles = (countFits && count > 0) ? count : (size >= HeaderSize ? (size - HeaderSize) / RecordSize : 0);
+
+	// many binary files start with "solid" too, and some have trailing bytes or a wrong count in the header.
+	// An exact size is binary, a "solid" file is ASCII unless its records hold bytes no text has, any other
+	// file is binary
+	const char* text = data;
+	while(text < data + size && isSpace(*text))
+		++text;
+	const bool solid = data + size - text >= 5 && std::memcmp(text, "solid", 5) == 0;
+	if(size >= HeaderSize && (size == HeaderSize + RecordSize * count || !solid))
+		return Format::Binary;
+	if(!solid)
+		return Format::Unknown;
+	if(binaryTriangles > 0 && !isText(data + HeaderSize, data + std::min(size, HeaderSize + 64 * RecordSize)))
+		return Format::AsciiOrBinary;
+	return Format::Ascii;
+}
+
+bool CStlReader::ReportProgress(double fraction)
+{
+	if(m_progressCallback && !m_progressCallback(fraction))
+		m_bCanceled = true;
+	return !m_bCanceled;
+}
+
+vtkSmartPointer<vtkPolyData> CStlReader::Preview(const char* data, std::uint64_t size, std::uint64_t numTriangles) const
+{
+	std::vector<float> values;
+	if(m_bBinary)
+	{
+		// the first vertex of evenly spaced records
+		const std::uint64_t count = std::min<std::uint64_t>(numTriangles, m_previewPointCount);
+		values.resize(static_cast<std::size_t>(3 * count));
+		for(std::uint64_t i = 0; i < count; ++i)
+			std::memcpy(values.data() + 3 * i, data + HeaderSize + RecordSize * (i * numTriangles / count) + 12, 3 * sizeof(float));
+	}
+	else
+	{
+		// the first vertex line after evenly spaced positions
+		const char* end = data + size;
+		values.reserve(static_cast<std::size_t>(3 * m_previewPointCount));
+		const char* searched = data;
+		for(vtkIdType i = 0; i < m_previewPointCount; ++i)
+		{
+			const char* line = std::max(searched, nextLine(data + size * i / m_previewPointCount, end));
+			const std::size_t found = values.size();
+			for(int lines = 0; line < end && values.size() == found && lines < 8; ++lines)
+			{
+				const char* lineEnd = nextLine(line, end);
+				collectVertices(line, lineEnd, values);
+				line = lineEnd;
+			}
+			searched = line;
+		}
+		values.resize(values.size() / 3 * 3);
+	}
+
+	const vtkIdType numPoints = static_cast<vtkIdType>(values.size() / 3);
+	auto points = vtkSmartPointer<vtkPoints>::New();
+	points->SetDataTypeToFloat();
+	points->SetNumberOfPoints(numPoints);
+	std::copy(values.cbegin(), values.cend(), vtkFloatArray::SafeDownCast(points->GetData())->GetPointer(0));
+	auto connectivity = vtkSmartPointer<vtkIdTypeArray>::New();
+	connectivity->SetNumberOfValues(numPoints + 1);
+	vtkIdType* ids = connectivity->GetPointer(0);
+	ids[0] = numPoints;
+	for(vtkIdType i = 0; i < numPoints; ++i)
+		ids[i+1] = i;
+	auto verts = vtkSmartPointer<vtkCellArray>::New();
+	verts->SetCells(1, connectivity);
+	auto ret = vtkSmartPointer<vtkPolyData>::New();
+	ret->SetPoints(points);
+	ret->SetVerts(verts);
+	return ret;
+}
+
+vtkSmartPointer<vtkPoints> CStlReader::ParseBinary(const char* data, std::uint64_t count)
+{
+	const vtkIdType numTriangles = static_cast<vtkIdType>(count);
+	auto ret = vtkSmartPointer<vtkPoints>::New();
+	ret->SetDataTypeToFloat();
+	ret->SetNumberOfPoints(3 * numTriangles);
+	float* xyz = vtkFloatArray::SafeDownCast(ret->GetData())->GetPointer(0);
+	const char* records = data + HeaderSize;
+	auto functor = [xyz, records](vtkIdType begin, vtkIdType end)
+	{
+		// the records are not aligned, the nine vertex floats follow the normal (little endian like the file)
+		for(vtkIdType t = begin; t < end; ++t)
+			std::memcpy(xyz + 9 * t, records + RecordSize * t + 12, 9 * sizeof(float));
+	};
+	for(vtkIdType block = 0; block < numTriangles; block += BinaryBlockSize)
+	{
+		const vtkIdType blockEnd = std::min(numTriangles, block + BinaryBlockSize);
+		if(m_bParallel)
+			vtkSMPTools::For(block, blockEnd, functor);
+		else
+			functor(block, blockEnd);
+		if(!ReportProgress(ParseProgress * blockEnd / numTriangles))
+			return nullptr;
+	}
+	return ret;
+}
+
+vtkSmartPointer<vtkPoints> CStlReader::ParseAscii(const char* data, std::uint64_t size)
+{
+	const char* end = data + size;
+	const vtkIdType numChunks = static_cast<vtkIdType>(std::max<std::uint64_t>(1, size / AsciiChunkSize));
+	std::vector<std::vector<float>> chunkValues(numChunks);
+	auto functor = [data, end, size, numChunks, &chunkValues](vtkIdType begin, vtkIdType last)
+	{
+		for(vtkIdType chunk = begin; chunk < last; ++chunk)
+		{
+			// a chunk owns the lines that start inside it
+			const char* chunkBegin = chunk == 0 ? data : nextLine(data + size * chunk / numChunks - 1, end);
+			const char* chunkEnd = chunk + 1 == numChunks ? end : nextLine(data + size * (chunk + 1) / numChunks - 1, end);
+			if(chunkBegin < chunkEnd)
+			{
+				chunkValues[chunk].reserve(static_cast<std::size_t>((chunkEnd - chunkBegin) / 12));
+				collectVertices(chunkBegin, chunkEnd, chunkValues[chunk]);
+			}
+		}
+	};
+	for(vtkIdType batch = 0; batch < numChunks; batch += AsciiBatchChunks)
+	{
+		const vtkIdType batchEnd = std::min(numChunks, batch + AsciiBatchChunks);
+		if(m_bParallel && batchEnd - batch > 1)
+			vtkSMPTools::For(batch, batchEnd, 1, functor);
+		else
+			functor(batch, batchEnd);
+		if(!ReportProgress(ParseProgress * batchEnd / numChunks))
+			return nullptr;
+	}
+
+	std::vector<std::size_t> offsets(numChunks + 1, 0);
+	for(vtkIdType chunk = 0; chunk < numChunks; ++chunk)
+		offsets[chunk+1] = offsets[chunk] + chunkValues[chunk].size();
+	const vtkIdType numTriangles = static_cast<vtkIdType>(offsets[numChunks] / 9);
+	auto ret = vtkSmartPointer<vtkPoints>::New();
+	ret->SetDataTypeToFloat();
+	ret->SetNumberOfPoints(3 * numTriangles);
+	float* xyz = vtkFloatArray::SafeDownCast(ret->GetData())->GetPointer(0);
+	const std::size_t numValues = static_cast<std::size_t>(9 * numTriangles);
+	for(vtkIdType chunk = 0; chunk < numChunks; ++chunk)
+	{
+		const std::size_t first = std::min(offsets[chunk], numValues);
+		const std::size_t count = std::min(offsets[chunk+1], numValues) - first;
+		std::copy(chunkValues[chunk].cbegin(), chunkValues[chunk].cbegin() + count, xyz + first);
+		std::vector<float>().swap(chunkValues[chunk]);
+	}
+	return ret;
+}
+
+const std::string& CStlReader::ErrorMessage() const
+{
+	return m_errorMessage;
+}
+
+bool CStlReader::WasCanceled() const
+{
+	return m_bCanceled;
+}
+
+bool CStlReader::IsBinary() const
+{
+	return m_bBinary;
+}
+
+vtkIdType CStlReader::TriangleCount() const
+{
+	return m_triangleCount;
+}
+
+double CStlReader::ParseTime() const
+{
+	return m_dParseTime;
+}
+
+double CStlReader::WeldTime() const
+{
+	return m_dWeldTime;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vtkSmartPointer.h>
+#include <vtkType.h>
+
+class vtkPolyData;
+class vtkPoints;
+
+// *****
+// STL reader that memory-maps the file (CMappedFile) instead of streaming it through a copy.
+// Binary files are recognized by their size (84 + 50 bytes per triangle, whatever their header says) or by
+// not starting with "solid", trailing bytes are ignored and a header count that does not fit in the file is
+// replaced by the number of whole records, like vtkSTLReader does. The records are decoded in parallel
+// straight into a preallocated float soup of three points per triangle. ASCII files are split into chunks
+// at line ends, every chunk collects its vertex lines in parallel and the chunks are joined in file order.
+// A file starting with "solid" without any facet is read as binary when its records are not text.
+// The soup is welded by CMeshWelder (bit exact, like the point merging of vtkSTLReader) and freed before the
+// connectivity is built, degenerate triangles are dropped.
+// The peak memory is about three times the soup (36 bytes per triangle): the soup, the sorted vertex hashes
+// and the representative of every corner during the weld. That is the price of the sort based weld, which
+// runs in parallel and gives the same mesh whatever the thread count; inserting the vertices one by one
+// into a hash of the unique points would stay near the final mesh but parse and weld on a single thread.
+// Read() is meant to run on a worker thread: the callbacks are called on that thread, the preview (a point
+// sample taken across the whole mapped file before the parse) as soon as the format is known, the progress
+// between parsed blocks, where a false return cancels the read.
+// *****
+class CStlReader
+{
+public:
+	enum class Format
+	{
+		Binary,//exact size, or not starting with "solid"
+		Ascii,//starts with "solid" and its records would be text
+		AsciiOrBinary,//starts with "solid" but its records are not text, binary when it has no facet
+		Unknown
+	};
+
+	// fraction of the read done in [0, 1], return false to cancel
+	using ProgressCallback = std::function<bool(double fraction)>;
+	// points with a single poly vertex cell
+	using PreviewCallback = std::function<void(vtkSmartPointer<vtkPolyData> preview)>;
+
+	CStlReader();
+
+	void SetParallel(bool parallel);
+	bool GetParallel() const;
+	void SetProgressCallback(ProgressCallback callback);
+	void SetPreviewCallback(PreviewCallback callback, vtkIdType maxPoints = 50000);
+
+	// nullptr on failure, see ErrorMessage()
+	vtkSmartPointer<vtkPolyData> Read(const std::string& path);
+	// format of a mapped STL file and its triangles when read as binary: the header count when it fits in
+	// the file, otherwise every whole record like vtkSTLReader
+	static Format DetectFormat(const char* data, std::uint64_t size, std::uint64_t& binaryTriangles);
+
+	const std::string& ErrorMessage() const;
+	bool WasCanceled() const;
+	bool IsBinary() const;//format of the last file read
+	vtkIdType TriangleCount() const;//triangles in the file, before dropping the degenerate ones
+	double ParseTime() const;//seconds, mapping and decoding
+	double WeldTime() const;//seconds
+
+private:
+	bool ReportProgress(double fraction);
+	vtkSmartPointer<vtkPolyData> Preview(const char* data, std::uint64_t size, std::uint64_t binaryTriangles) const;
+	vtkSmartPointer<vtkPoints> ParseBinary(const char* data, std::uint64_t numTriangles);
+	vtkSmartPointer<vtkPoints> ParseAscii(const char* data, std::uint64_t size);
+
+private:
+	bool m_bParallel;
+	bool m_bBinary;
+	bool m_bCanceled;
+	ProgressCallback m_progressCallback;
+	PreviewCallback m_previewCallback;
+	vtkIdType m_previewPointCount;
+	vtkIdType m_triangleCount;
+	double m_dParseTime;
+	double m_dWeldTime;
+	std::string m_errorMessage;
+};
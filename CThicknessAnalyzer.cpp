@@ -0,0 +1,367 @@
+#include "CThicknessAnalyzer.h"
+#include "CMeshNormals.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define THICKNESS_SSE2
+#endif
+
+#include <vtkPolyData.h>
+#include <vtkPoints.h>
+#include <vtkCellArray.h>
+#include <vtkIdList.h>
+#include <vtkFloatArray.h>
+#include <vtkPointData.h>
+#include <vtkCellData.h>
+#include <vtkSMPTools.h>
+
+namespace
+{
+const int Lanes = 4;
+
+struct Ray
+{
+	float origin[3];
+	float direction[3];
+	float tMin;
+};
+
+// Moller-Trumbore against the triangles [first, first + count) of the structure of arrays, both faces count,
+// lowers tMax to the closest hit beyond tMin
+void intersectTriangles(const float* triangles, vtkIdType stride, vtkIdType first, vtkIdType count, const Ray& ray, double& tMax)
+{
+	const float* v0[3] = {triangles, triangles + stride, triangles + 2 * stride};
+	const float* e1[3] = {triangles + 3 * stride, triangles + 4 * stride, triangles + 5 * stride};
+	const float* e2[3] = {triangles + 6 * stride, triangles + 7 * stride, triangles + 8 * stride};
+#if defined(THICKNESS_SSE2)
+	const __m128 dx = _mm_set1_ps(ray.direction[0]), dy = _mm_set1_ps(ray.direction[1]), dz = _mm_set1_ps(ray.direction[2]);
+	const __m128 ox = _mm_set1_ps(ray.origin[0]), oy = _mm_set1_ps(ray.origin[1]), oz = _mm_set1_ps(ray.origin[2]);
+	const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), tMin = _mm_set1_ps(ray.tMin);
+	alignas(16) float t[Lanes];
+	for(vtkIdType i = first; i < first + count; i += Lanes)
+	{
+		// the arrays are padded, the lanes past the leaf read the next triangles and are masked below
+		const __m128 e1x = _mm_loadu_ps(e1[0] + i), e1y = _mm_loadu_ps(e1[1] + i), e1z = _mm_loadu_ps(e1[2] + i);
+		const __m128 e2x = _mm_loadu_ps(e2[0] + i), e2y = _mm_loadu_ps(e2[1] + i), e2z = _mm_loadu_ps(e2[2] + i);
+		const __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+		const __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+		const __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+		const __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+		const __m128 inverse = _mm_div_ps(one, det);
+		const __m128 tx = _mm_sub_ps(ox, _mm_loadu_ps(v0[0] + i));
+		const __m128 ty = _mm_sub_ps(oy, _mm_loadu_ps(v0[1] + i));
+		const __m128 tz = _mm_sub_ps(oz, _mm_loadu_ps(v0[2] + i));
+		const __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz)), inverse);
+		const __m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+		const __m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+		const __m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+		const __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inverse);
+		const __m128 hitT = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inverse);
+		__m128 mask = _mm_cmpneq_ps(det, zero);
+		mask = _mm_and_ps(mask, _mm_cmpge_ps(u, zero));
+		mask = _mm_and_ps(mask, _mm_cmpge_ps(v, zero));
+		mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), one));
+		mask = _mm_and_ps(mask, _mm_cmpgt_ps(hitT, tMin));
+		mask = _mm_and_ps(mask, _mm_cmplt_ps(hitT, _mm_set1_ps(static_cast<float>(tMax))));
+		const int bits = _mm_movemask_ps(mask);
+		if(bits == 0)
+			continue;
+		_mm_store_ps(t, hitT);
+		const int lanes = static_cast<int>(std::min<vtkIdType>(Lanes, first + count - i));
+		for(int lane = 0; lane < lanes; ++lane)
+		{
+			if((bits >> lane & 1) && t[lane] < tMax)
+				tMax = t[lane];
+		}
+	}
+#else
+	const float* d = ray.direction;
+	for(vtkIdType i = first; i < first + count; ++i)
+	{
+		const float p[3] = {d[1]*e2[2][i] - d[2]*e2[1][i], d[2]*e2[0][i] - d[0]*e2[2][i], d[0]*e2[1][i] - d[1]*e2[0][i]};
+		const float det = e1[0][i]*p[0] + e1[1][i]*p[1] + e1[2][i]*p[2];
+		if(det == 0.0f)
+			continue;
+		const float inverse = 1.0f / det;
+		const float s[3] = {ray.origin[0] - v0[0][i], ray.origin[1] - v0[1][i], ray.origin[2] - v0[2][i]};
+		const float u = (s[0]*p[0] + s[1]*p[1] + s[2]*p[2]) * inverse;
+		const float q[3] = {s[1]*e1[2][i] - s[2]*e1[1][i], s[2]*e1[0][i] - s[0]*e1[2][i], s[0]*e1[1][i] - s[1]*e1[0][i]};
+		const float v = (d[0]*q[0] + d[1]*q[1] + d[2]*q[2]) * inverse;
+		const float t = (e2[0][i]*q[0] + e2[1][i]*q[1] + e2[2][i]*q[2]) * inverse;
+		if(u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t > ray.tMin && t < tMax)
+			tMax = t;
+	}
+#endif
+}
+
+void sortUnique(std::vector<vtkIdType>& ids)
+{
+	std::sort(ids.begin(), ids.end());
+	ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+}
+}
+
+CThicknessAnalyzer::CThicknessAnalyzer()
+	: m_mode(Mode::Points)
+	, m_dMaxDistance(0.0)
+	, m_bParallel(true)
+	, m_pointsMTime(0)
+	, m_polysMTime(0)
+	, m_stride(0)
+	, m_dDiagonal(0.0)
+	, m_dBuildTime(0.0)
+	, m_dAnalysisTime(0.0)
+	, m_rayCount(0)
+	, m_hitCount(0)
+{
+}
+
+void CThicknessAnalyzer::SetMode(Mode mode)
+{
+	m_mode = mode;
+}
+
+CThicknessAnalyzer::Mode CThicknessAnalyzer::GetMode() const
+{
+	return m_mode;
+}
+
+void CThicknessAnalyzer::SetMaxDistance(double distance)
+{
+	m_dMaxDistance = std::max(0.0, distance);
+}
+
+double CThicknessAnalyzer::GetMaxDistance() const
+{
+	return m_dMaxDistance;
+}
+
+void CThicknessAnalyzer::SetParallel(bool parallel)
+{
+	m_bParallel = parallel;
+}
+
+bool CThicknessAnalyzer::GetParallel() const
+{
+	return m_bParallel;
+}
+
+void CThicknessAnalyzer::Clear()
+{
+	m_bvh.Clear();
+	m_pointsMTime = 0;
+	m_polysMTime = 0;
+	m_stride = 0;
+	std::vector<float>().swap(m_triangles);
+}
+
+void CThicknessAnalyzer::BuildTriangles(vtkPolyData* polydata)
+{
+	const std::vector<vtkIdType>& order = m_bvh.OrderedCellIds();
+	const vtkIdType numCells = static_cast<vtkIdType>(order.size());
+	// padded for the four wide loads of the last leaf, the padding is degenerate
+	m_stride = numCells + Lanes;
+	m_triangles.assign(9 * m_stride, 0.0f);
+	vtkPoints* points = polydata->GetPoints();
+	polydata->GetCellType(0);//builds the cell map before the parallel passes read it
+	auto functor = [this, polydata, points, &order](vtkIdType begin, vtkIdType end)
+	{
+		double a[3], b[3], c[3];
+		for(vtkIdType i = begin; i < end; ++i)
+		{
+			vtkIdType numIds;
+			vtkIdType* ids;
+			polydata->GetCellPoints(order[i], numIds, ids);
+			if(numIds != 3)
+				continue;
+			points->GetPoint(ids[0], a);
+			points->GetPoint(ids[1], b);
+			points->GetPoint(ids[2], c);
+			for(int j = 0; j < 3; ++j)
+			{
+				m_triangles[j * m_stride + i] = static_cast<float>(a[j]);
+				m_triangles[(3 + j) * m_stride + i] = static_cast<float>(b[j] - a[j]);
+				m_triangles[(6 + j) * m_stride + i] = static_cast<float>(c[j] - a[j]);
+			}
+		}
+	};
+	if(m_bParallel)
+		vtkSMPTools::For(0, numCells, functor);
+	else
+		functor(0, numCells);
+}
+
+bool CThicknessAnalyzer::Analyze(vtkSmartPointer<vtkPolyData> polydata, vtkSmartPointer<vtkIdList> region)
+{
+	m_rayCount = 0;
+	m_hitCount = 0;
+	m_dBuildTime = 0.0;
+	m_dAnalysisTime = 0.0;
+	if(!polydata || !polydata->GetPoints() || polydata->GetNumberOfCells() == 0)
+		return false;
+
+	auto startTime = std::chrono::steady_clock::now();
+	if(m_bvh.PolyData() != polydata.GetPointer() || m_pointsMTime != polydata->GetPoints()->GetMTime() || m_polysMTime != polydata->GetPolys()->GetMTime())
+	{
+		m_bvh.Build(polydata);
+		BuildTriangles(polydata);
+		double bounds[6];
+		polydata->GetPoints()->GetBounds(bounds);
+		m_dDiagonal = std::sqrt((bounds[1]-bounds[0])*(bounds[1]-bounds[0]) + (bounds[3]-bounds[2])*(bounds[3]-bounds[2]) + (bounds[5]-bounds[4])*(bounds[5]-bounds[4]));
+		m_pointsMTime = polydata->GetPoints()->GetMTime();
+		m_polysMTime = polydata->GetPolys()->GetMTime();
+		m_dBuildTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+		startTime = std::chrono::steady_clock::now();
+	}
+
+	const bool pointMode = m_mode == Mode::Points;
+	const vtkIdType numPoints = polydata->GetNumberOfPoints();
+	const vtkIdType numCells = polydata->GetNumberOfCells();
+	vtkDataArray* normals = nullptr;
+	if(pointMode)
+	{
+		normals = polydata->GetPointData()->GetNormals();
+		if(!normals || normals->GetNumberOfComponents() != 3 || normals->GetNumberOfTuples() != numPoints)
+		{
+			CMeshNormals meshNormals;
+			meshNormals.SetParallel(m_bParallel);
+			meshNormals.Compute(polydata);
+			normals = polydata->GetPointData()->GetNormals();
+		}
+	}
+
+	polydata->GetCellType(0);//builds the cell map before the parallel passes read it
+
+	// the analyzed points or cells, all of them without a region
+	std::vector<vtkIdType> items;
+	if(region)
+	{
+		for(vtkIdType i = 0; i < region->GetNumberOfIds(); ++i)
+		{
+			const vtkIdType cellId = region->GetId(i);
+			if(cellId < 0 || cellId >= numCells)
+				continue;
+			if(pointMode)
+			{
+				vtkIdType numIds;
+				vtkIdType* ids;
+				polydata->GetCellPoints(cellId, numIds, ids);
+				items.insert(items.end(), ids, ids + numIds);
+			}
+			else
+			{
+				items.push_back(cellId);
+			}
+		}
+		sortUnique(items);
+	}
+	const vtkIdType count = region ? static_cast<vtkIdType>(items.size()) : (pointMode ? numPoints : numCells);
+
+	vtkDataSetAttributes* attributes = pointMode ? static_cast<vtkDataSetAttributes*>(polydata->GetPointData()) : polydata->GetCellData();
+	const vtkIdType numValues = pointMode ? numPoints : numCells;
+	vtkSmartPointer<vtkFloatArray> thickness = vtkFloatArray::SafeDownCast(attributes->GetArray("Thickness"));
+	if(!thickness || thickness->GetNumberOfComponents() != 1 || thickness->GetNumberOfTuples() != numValues)
+	{
+		thickness = vtkSmartPointer<vtkFloatArray>::New();
+		thickness->SetName("Thickness");
+		thickness->SetNumberOfValues(numValues);
+		std::fill(thickness->GetPointer(0), thickness->GetPointer(0) + numValues, std::numeric_limits<float>::quiet_NaN());
+		attributes->AddArray(thickness);
+	}
+	float* values = thickness->GetPointer(0);
+
+	const double maxDistance = m_dMaxDistance > 0.0 ? m_dMaxDistance : m_dDiagonal;
+	// the float triangles round at about 1e-7 of the coordinates, closer hits are the surface the ray starts on
+	const float tMin = static_cast<float>(1e-5 * m_dDiagonal);
+	vtkPoints* points = polydata->GetPoints();
+	auto functor = [&, points, normals](vtkIdType begin, vtkIdType end)
+	{
+		double origin[3], direction[3];
+		for(vtkIdType i = begin; i < end; ++i)
+		{
+			const vtkIdType id = region ? items[i] : i;
+			if(pointMode)
+			{
+				points->GetPoint(id, origin);
+				normals->GetTuple(id, direction);
+			}
+			else
+			{
+				vtkIdType numIds;
+				vtkIdType* ids;
+				polydata->GetCellPoints(id, numIds, ids);
+				if(numIds != 3)
+				{
+					values[id] = std::numeric_limits<float>::quiet_NaN();
+					continue;
+				}
+				double a[3], b[3], c[3];
+				points->GetPoint(ids[0], a);
+				points->GetPoint(ids[1], b);
+				points->GetPoint(ids[2], c);
+				for(int j = 0; j < 3; ++j)
+					origin[j] = (a[j] + b[j] + c[j]) / 3.0;
+				direction[0] = (b[1]-a[1])*(c[2]-a[2]) - (b[2]-a[2])*(c[1]-a[1]);
+				direction[1] = (b[2]-a[2])*(c[0]-a[0]) - (b[0]-a[0])*(c[2]-a[2]);
+				direction[2] = (b[0]-a[0])*(c[1]-a[1]) - (b[1]-a[1])*(c[0]-a[0]);
+			}
+			const double length = std::sqrt(direction[0]*direction[0] + direction[1]*direction[1] + direction[2]*direction[2]);
+			if(!(length > 0.0))
+			{
+				values[id] = std::numeric_limits<float>::quiet_NaN();
+				continue;
+			}
+			// inward, against the outward normal
+			Ray ray;
+			for(int j = 0; j < 3; ++j)
+			{
+				direction[j] /= -length;
+				ray.origin[j] = static_cast<float>(origin[j]);
+				ray.direction[j] = static_cast<float>(direction[j]);
+			}
+			ray.tMin = tMin;
+			double tMax = maxDistance;
+			m_bvh.RayTraverse(origin, direction, tMax, [this, &ray](vtkIdType first, vtkIdType numTriangles, double& closest)
+			{
+				intersectTriangles(m_triangles.data(), m_stride, first, numTriangles, ray, closest);
+			});
+			values[id] = tMax < maxDistance ? static_cast<float>(tMax) : std::numeric_limits<float>::quiet_NaN();
+		}
+	};
+	if(m_bParallel)
+		vtkSMPTools::For(0, count, functor);
+	else
+		functor(0, count);
+
+	m_rayCount = count;
+	for(vtkIdType i = 0; i < count; ++i)
+		m_hitCount += !std::isnan(values[region ? items[i] : i]);
+	thickness->Modified();
+	m_dAnalysisTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	return true;
+}
+
+double CThicknessAnalyzer::BuildTime() const
+{
+	return m_dBuildTime;
+}
+
+double CThicknessAnalyzer::AnalysisTime() const
+{
+	return m_dAnalysisTime;
+}
+
+vtkIdType CThicknessAnalyzer::RayCount() const
+{
+	return m_rayCount;
+}
+
+vtkIdType CThicknessAnalyzer::HitCount() const
+{
+	return m_hitCount;
+}
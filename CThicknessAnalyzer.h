@@ -0,0 +1,66 @@
+#pragma once
+#include <vector>
+#include <vtkSmartPointer.h>
+#include <vtkType.h>
+#include "CCellBVH.h"
+
+class vtkPolyData;
+class vtkIdList;
+
+// *****
+// Wall thickness by ray casting: from every point (or cell center) a ray goes along the inward normal and
+// the distance to the first triangle it hits on the opposite wall is written into a "Thickness" float array.
+// The triangles are copied in the leaf order of a CCellBVH into structure of arrays floats, so a leaf is
+// tested four triangles at a time with SSE (scalar fallback) while the rays run in parallel with vtkSMPTools.
+// The BVH is kept while the points and polys of the polydata are unchanged.
+// Point mode uses the point normals of the polydata (computeNormals), they are computed in place by
+// CMeshNormals when missing. Entries without a hit within the maximum distance, or outside the analyzed
+// region on the first analysis, are NaN. Cells that are not triangles are never hit.
+// *****
+class CThicknessAnalyzer
+{
+public:
+	enum class Mode
+	{
+		Points,
+		Cells
+	};
+
+	CThicknessAnalyzer();
+
+	void SetMode(Mode mode);
+	Mode GetMode() const;
+	// 0 (default) limits the rays to the diagonal of the bounds
+	void SetMaxDistance(double distance);
+	double GetMaxDistance() const;
+	void SetParallel(bool parallel);
+	bool GetParallel() const;
+
+	// region holds cell ids like the selections of vtkAppendableSelection, nullptr analyzes the whole mesh,
+	// the points of the region cells in point mode; values outside the region are kept from the previous analysis
+	bool Analyze(vtkSmartPointer<vtkPolyData> polydata, vtkSmartPointer<vtkIdList> region = nullptr);
+	void Clear();
+
+	double BuildTime() const;//seconds spent building the BVH and the triangles, 0 when they were reused
+	double AnalysisTime() const;//seconds spent in the last Analyze() without the build
+	vtkIdType RayCount() const;
+	vtkIdType HitCount() const;
+
+private:
+	void BuildTriangles(vtkPolyData* polydata);
+
+private:
+	Mode m_mode;
+	double m_dMaxDistance;
+	bool m_bParallel;
+	CCellBVH m_bvh;
+	vtkMTimeType m_pointsMTime;
+	vtkMTimeType m_polysMTime;
+	vtkIdType m_stride;//floats per component of m_triangles
+	std::vector<float> m_triangles;//v0 x y z, e1 x y z, e2 x y z, one array of m_stride floats each
+	double m_dDiagonal;
+	double m_dBuildTime;
+	double m_dAnalysisTime;
+	vtkIdType m_rayCount;
+	vtkIdType m_hitCount;
+};
@@ -0,0 +1,292 @@
+#include "CTriangleNormalKernel.h"
+#include "CMeshWelder.h"
+
+#include <algorithm>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define TRIANGLE_NORMAL_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TRIANGLE_NORMAL_SSE2
+#endif
+
+#include <vtkPolyData.h>
+#include <vtkPoints.h>
+#include <vtkDataArray.h>
+#include <vtkCellArray.h>
+#include <vtkSMPTools.h>
+
+namespace
+{
+constexpr int BlockSize = 4;
+constexpr vtkIdType ChunkSize = 16384;
+
+// corners a, b, c of four triangles, one array per coordinate
+struct TriangleBlock
+{
+	alignas(32) double a[3][BlockSize];
+	alignas(32) double b[3][BlockSize];
+	alignas(32) double c[3][BlockSize];
+};
+
+#if defined(TRIANGLE_NORMAL_AVX2)
+class CrossAccumulator
+{
+public:
+	CrossAccumulator() : m_x(_mm256_setzero_pd()), m_y(_mm256_setzero_pd()), m_z(_mm256_setzero_pd()) {}
+
+	void Add(const TriangleBlock& block)
+	{
+		const __m256d ax = _mm256_load_pd(block.a[0]), ay = _mm256_load_pd(block.a[1]), az = _mm256_load_pd(block.a[2]);
+		const __m256d ux = _mm256_sub_pd(_mm256_load_pd(block.b[0]), ax);
+		const __m256d uy = _mm256_sub_pd(_mm256_load_pd(block.b[1]), ay);
+		const __m256d uz = _mm256_sub_pd(_mm256_load_pd(block.b[2]), az);
+		const __m256d vx = _mm256_sub_pd(_mm256_load_pd(block.c[0]), ax);
+		const __m256d vy = _mm256_sub_pd(_mm256_load_pd(block.c[1]), ay);
+		const __m256d vz = _mm256_sub_pd(_mm256_load_pd(block.c[2]), az);
+		m_x = _mm256_add_pd(m_x, _mm256_sub_pd(_mm256_mul_pd(uy, vz), _mm256_mul_pd(uz, vy)));
+		m_y = _mm256_add_pd(m_y, _mm256_sub_pd(_mm256_mul_pd(uz, vx), _mm256_mul_pd(ux, vz)));
+		m_z = _mm256_add_pd(m_z, _mm256_sub_pd(_mm256_mul_pd(ux, vy), _mm256_mul_pd(uy, vx)));
+	}
+
+	std::array<double, 3> Sum() const
+	{
+		alignas(32) double lanes[3][BlockSize];
+		_mm256_store_pd(lanes[0], m_x);
+		_mm256_store_pd(lanes[1], m_y);
+		_mm256_store_pd(lanes[2], m_z);
+		std::array<double, 3> ret;
+		for(int j = 0; j < 3; ++j)
+			ret[j] = (lanes[j][0] + lanes[j][1]) + (lanes[j][2] + lanes[j][3]);
+		return ret;
+	}
+
+private:
+	__m256d m_x, m_y, m_z;
+};
+#elif defined(TRIANGLE_NORMAL_SSE2)
+class CrossAccumulator
+{
+public:
+	CrossAccumulator()
+	{
+		for(int h = 0; h < 2; ++h)
+			m_x[h] = m_y[h] = m_z[h] = _mm_setzero_pd();
+	}
+
+	void Add(const TriangleBlock& block)
+	{
+		for(int h = 0; h < 2; ++h)
+		{
+			const int lane = 2 * h;
+			const __m128d ax = _mm_load_pd(block.a[0] + lane), ay = _mm_load_pd(block.a[1] + lane), az = _mm_load_pd(block.a[2] + lane);
+			const __m128d ux = _mm_sub_pd(_mm_load_pd(block.b[0] + lane), ax);
+			const __m128d uy = _mm_sub_pd(_mm_load_pd(block.b[1] + lane), ay);
+			const __m128d uz = _mm_sub_pd(_mm_load_pd(block.b[2] + lane), az);
+			const __m128d vx = _mm_sub_pd(_mm_load_pd(block.c[0] + lane), ax);
+			const __m128d vy = _mm_sub_pd(_mm_load_pd(block.c[1] + lane), ay);
+			const __m128d vz = _mm_sub_pd(_mm_load_pd(block.c[2] + lane), az);
+			m_x[h] = _mm_add_pd(m_x[h], _mm_sub_pd(_mm_mul_pd(uy, vz), _mm_mul_pd(uz, vy)));
+			m_y[h] = _mm_add_pd(m_y[h], _mm_sub_pd(_mm_mul_pd(uz, vx), _mm_mul_pd(ux, vz)));
+			m_z[h] = _mm_add_pd(m_z[h], _mm_sub_pd(_mm_mul_pd(ux, vy), _mm_mul_pd(uy, vx)));
+		}
+	}
+
+	std::array<double, 3> Sum() const
+	{
+		alignas(16) double lanes[3][BlockSize];
+		for(int h = 0; h < 2; ++h)
+		{
+			_mm_store_pd(lanes[0] + 2 * h, m_x[h]);
+			_mm_store_pd(lanes[1] + 2 * h, m_y[h]);
+			_mm_store_pd(lanes[2] + 2 * h, m_z[h]);
+		}
+		std::array<double, 3> ret;
+		for(int j = 0; j < 3; ++j)
+			ret[j] = (lanes[j][0] + lanes[j][1]) + (lanes[j][2] + lanes[j][3]);
+		return ret;
+	}
+
+private:
+	__m128d m_x[2], m_y[2], m_z[2];
+};
+#else
+class CrossAccumulator
+{
+public:
+	CrossAccumulator() : m_sum() {}
+
+	void Add(const TriangleBlock& block)
+	{
+		for(int lane = 0; lane < BlockSize; ++lane)
+		{
+			const double u[3] = {block.b[0][lane] - block.a[0][lane], block.b[1][lane] - block.a[1][lane], block.b[2][lane] - block.a[2][lane]};
+			const double v[3] = {block.c[0][lane] - block.a[0][lane], block.c[1][lane] - block.a[1][lane], block.c[2][lane] - block.a[2][lane]};
+			m_sum[0][lane] += u[1]*v[2] - u[2]*v[1];
+			m_sum[1][lane] += u[2]*v[0] - u[0]*v[2];
+			m_sum[2][lane] += u[0]*v[1] - u[1]*v[0];
+		}
+	}
+
+	std::array<double, 3> Sum() const
+	{
+		std::array<double, 3> ret;
+		for(int j = 0; j < 3; ++j)
+			ret[j] = (m_sum[j][0] + m_sum[j][1]) + (m_sum[j][2] + m_sum[j][3]);
+		return ret;
+	}
+
+private:
+	double m_sum[3][BlockSize];
+};
+#endif
+
+// cornerIds(i) returns the three point ids of the i-th cell or nullptr, coordinates(id, x) fetches a point
+template <typename CornerIds, typename Coordinates>
+std::array<double, 3> SumRange(vtkIdType begin, vtkIdType end, const CornerIds& cornerIds, const Coordinates& coordinates)
+{
+	TriangleBlock block;
+	CrossAccumulator accumulator;
+	int lane(0);
+	double x[3];
+	for(vtkIdType i = begin; i < end; ++i)
+	{
+		const vtkIdType* ids = cornerIds(i);
+		if(!ids)
+			continue;
+		double (*corners[3])[BlockSize] = {block.a, block.b, block.c};
+		for(int k = 0; k < 3; ++k)
+		{
+			coordinates(ids[k], x);
+			for(int j = 0; j < 3; ++j)
+				corners[k][j][lane] = x[j];
+		}
+		if(++lane == BlockSize)
+		{
+			accumulator.Add(block);
+			lane = 0;
+		}
+	}
+	if(lane > 0)
+	{
+		// degenerate padding triangles add a zero cross product
+		for(int j = 0; j < 3; ++j)
+		{
+			std::fill(block.a[j] + lane, block.a[j] + BlockSize, 0.0);
+			std::fill(block.b[j] + lane, block.b[j] + BlockSize, 0.0);
+			std::fill(block.c[j] + lane, block.c[j] + BlockSize, 0.0);
+		}
+		accumulator.Add(block);
+	}
+	return accumulator.Sum();
+}
+
+template <typename CornerIds, typename Coordinates>
+std::array<double, 3> SumChunks(vtkIdType count, bool parallel, const CornerIds& cornerIds, const Coordinates& coordinates)
+{
+	const vtkIdType numChunks = (count + ChunkSize - 1) / ChunkSize;
+	std::vector<std::array<double, 3>> partial(numChunks);
+	auto functor = [count, &partial, &cornerIds, &coordinates](vtkIdType begin, vtkIdType end)
+	{
+		for(vtkIdType chunk = begin; chunk < end; ++chunk)
+			partial[chunk] = SumRange(chunk * ChunkSize, std::min(count, (chunk + 1) * ChunkSize), cornerIds, coordinates);
+	};
+	if(parallel && numChunks > 1)
+		vtkSMPTools::For(0, numChunks, 1, functor);
+	else
+		functor(0, numChunks);
+
+	std::array<double, 3> ret{0.0, 0.0, 0.0};
+	for(const auto& sum : partial)
+	{
+		for(int j = 0; j < 3; ++j)
+			ret[j] += sum[j];
+	}
+	return ret;
+}
+
+template <typename CornerIds>
+std::array<double, 3> SumWithPoints(vtkPoints* points, vtkIdType count, bool parallel, const CornerIds& cornerIds)
+{
+	vtkDataArray* data = points->GetData();
+	switch(points->GetDataType())
+	{
+	case VTK_FLOAT:
+	{
+		const float* xyz = static_cast<const float*>(data->GetVoidPointer(0));
+		return SumChunks(count, parallel, cornerIds, [xyz](vtkIdType id, double x[3])
+		{
+			x[0] = xyz[3*id];
+			x[1] = xyz[3*id+1];
+			x[2] = xyz[3*id+2];
+		});
+	}
+	case VTK_DOUBLE:
+	{
+		const double* xyz = static_cast<const double*>(data->GetVoidPointer(0));
+		return SumChunks(count, parallel, cornerIds, [xyz](vtkIdType id, double x[3])
+		{
+			x[0] = xyz[3*id];
+			x[1] = xyz[3*id+1];
+			x[2] = xyz[3*id+2];
+		});
+	}
+	default:
+		return SumChunks(count, parallel, cornerIds, [points](vtkIdType id, double x[3]) { points->GetPoint(id, x); });
+	}
+}
+
+// CMeshWelder::IsTriangleMesh() walks the connectivity, a selection sums a few cells per stroke of the same mesh.
+// The answer is kept against the polys and their MTime, the other cell arrays are counted on every call.
+bool IsTriangleMeshCached(vtkPolyData* polydata)
+{
+	struct Cache
+	{
+		vtkCellArray* polys;
+		vtkMTimeType mtime;
+		bool triangles;
+	};
+	static thread_local Cache cache{nullptr, 0, false};
+	vtkCellArray* polys = polydata->GetPolys();
+	if(!polys || polydata->GetNumberOfVerts() > 0 || polydata->GetNumberOfLines() > 0 || polydata->GetNumberOfStrips() > 0)
+		return false;
+	if(cache.polys != polys || cache.mtime != polys->GetMTime())
+		cache = {polys, polys->GetMTime(), CMeshWelder::IsTriangleMesh(polydata)};
+	return cache.triangles;
+}
+}
+
+std::array<double, 3> CTriangleNormalKernel::CrossProductSum(vtkPolyData* polydata, const vtkIdType* cellIds, vtkIdType count, bool parallel)
+{
+	if(!polydata || !polydata->GetPoints() || !cellIds || count <= 0)
+		return {0.0, 0.0, 0.0};
+
+	if(IsTriangleMeshCached(polydata))
+	{
+		// the cell id is the triangle index in the polys
+		const vtkIdType* conn = polydata->GetPolys()->GetPointer();
+		return SumWithPoints(polydata->GetPoints(), count, parallel, [conn, cellIds](vtkIdType i) { return conn + 4 * cellIds[i] + 1; });
+	}
+
+	polydata->GetCellType(0);//builds the cell map before the parallel passes read it
+	return SumWithPoints(polydata->GetPoints(), count, parallel, [polydata, cellIds](vtkIdType i) -> const vtkIdType*
+	{
+		vtkIdType numPoints;
+		vtkIdType* ids;
+		polydata->GetCellPoints(cellIds[i], numPoints, ids);
+		return numPoints == 3 ? ids : nullptr;
+	});
+}
+
+const char* CTriangleNormalKernel::InstructionSet()
+{
+#if defined(TRIANGLE_NORMAL_AVX2)
+	return "AVX2";
+#elif defined(TRIANGLE_NORMAL_SSE2)
+	return "SSE2";
+#else
+	return "scalar";
+#endif
+}
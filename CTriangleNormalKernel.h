@@ -0,0 +1,24 @@
+#pragma once
+#include <array>
+#include <vtkType.h>
+
+class vtkPolyData;
+
+// *****
+// Area weighted normal of many triangles.
+// The area weighted normal of a triangle is half of the raw cross product (b - a) x (c - a), so the sum needs
+// neither a normalization nor an area per triangle. The corners are gathered into structure of arrays blocks
+// of four triangles and the cross products are accumulated with AVX2 or SSE2 when the compiler targets them,
+// with a scalar fallback. Fixed chunks of cells are summed with vtkSMPTools and their partial sums are added
+// in chunk order, so the result does not depend on the thread count.
+// *****
+class CTriangleNormalKernel
+{
+public:
+	// sum of the cross products of the triangles among cellIds (twice their area weighted normal),
+	// the cells that are not triangles are skipped
+	static std::array<double, 3> CrossProductSum(vtkPolyData* polydata, const vtkIdType* cellIds, vtkIdType count, bool parallel = true);
+
+	// "AVX2", "SSE2" or "scalar", the instruction set the kernel was compiled for
+	static const char* InstructionSet();
+};
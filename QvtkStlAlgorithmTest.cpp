@@ -1,11 +1,25 @@
 #include "QvtkStlAlgorithmTest.h"
-#include "vtkSTLReader.h"
+#include "CStlReader.h"
+#include "CMeshCache.h"
+#include "CPointGridIndex.h"
+#include "vtkPolyData.h"
+#include "vtkProperty.h"
 #include "InteractorStyleMouseListener.h"
+#include "vtkAppendableSelection.h"
+#include <QProgressBar>
+#include <QPushButton>
+#include <QStatusBar>
 
 QvtkStlAlgorithmTest::QvtkStlAlgorithmTest(QWidget *parent)
     : QMainWindow(parent)
     , m_displayWidget(new DisplayWidgetType)
     , m_mouseListener(vtkSmartPointer<InteractorStyleMouseListener>::New())
+    , m_selection(vtkSmartPointer<vtkAppendableSelection>::New())
+    , m_loadProgress(new QProgressBar)
+    , m_cancelLoad(new QPushButton(tr("Cancel")))
+    , m_bCancelLoad(false)
+    , m_bPreviewShown(false)
+    , m_nLoadGeneration(0)
 {
     ui.setupUi(this);
     ui.m_layout->addWidget(m_displayWidget->Widget());
@@ -19,10 +33,124 @@ QvtkStlAlgorithmTest::QvtkStlAlgorithmTest(QWidget *parent)
     ));
 
 
-    auto stlReader = vtkSmartPointer<vtkSTLReader>::New();
-    stlReader->SetFileName("sample1.stl");
-    stlReader->Update();
-    m_displayWidget->Mapper<0>()->SetInputData(stlReader->GetOutput());
+    m_displayWidget->Actor<0>()->GetProperty()->SetPointSize(2.0f);//the preview is a point sample
+    m_loadProgress->setRange(0, 100);
+    statusBar()->addPermanentWidget(m_loadProgress);
+    statusBar()->addPermanentWidget(m_cancelLoad);
+    connect(m_cancelLoad, &QPushButton::clicked, this, [this]()
+    {
+        m_bCancelLoad = true;
+        m_cancelLoad->setEnabled(false);
+    });
+    LoadAsync("sample1.stl");
+}
+
+QvtkStlAlgorithmTest::~QvtkStlAlgorithmTest()
+{
+    m_bCancelLoad = true;
+    if(m_loadThread.joinable())
+        m_loadThread.join();
+}
+
+void QvtkStlAlgorithmTest::LoadAsync(const std::string& path)
+{
+    m_bCancelLoad = true;
+    if(m_loadThread.joinable())
+        m_loadThread.join();
+    m_bCancelLoad = false;
+    m_bPreviewShown = false;
+    // the callbacks of an older load may still be queued, they carry its generation and are dropped
+    const unsigned generation = ++m_nLoadGeneration;
+    m_loadStart = std::chrono::steady_clock::now();
+    m_selection->RemoveAllInputs();//nothing to select on the preview
+    m_loadProgress->setValue(0);
+    m_loadProgress->show();
+    m_cancelLoad->setEnabled(true);
+    m_cancelLoad->show();
+    statusBar()->showMessage(tr("Loading %1").arg(QString::fromStdString(path)));
+
+    m_loadThread = std::thread([this, path, generation]()
+    {
+        // the reader takes 90% of the progress bar, the normals and the index the rest
+        auto progress = [this, generation](int value)
+        {
+            QMetaObject::invokeMethod(this, [this, generation, value]()
+            {
+                if(generation == m_nLoadGeneration)
+                    m_loadProgress->setValue(value);
+            }, Qt::QueuedConnection);
+            return !m_bCancelLoad;
+        };
+        CStlReader stlReader;
+        stlReader.SetProgressCallback([progress](double fraction) { return progress(static_cast<int>(90.0 * fraction)); });
+        stlReader.SetPreviewCallback([this, generation](vtkSmartPointer<vtkPolyData> preview)
+        {
+            QMetaObject::invokeMethod(this, [this, generation, preview]()
+            {
+                if(generation == m_nLoadGeneration)
+                    OnPreviewLoaded(preview);
+            }, Qt::QueuedConnection);
+        });
+        // the sidecar cache skips the reader, the normals and the point index when the file was opened before
+        CMeshCache meshCache;
+        meshCache.SetProgressCallback([progress](double fraction) { return progress(90 + static_cast<int>(10.0 * fraction)); });
+        // shared because the queued call is copied, the selection adopts the index instead of building its own
+        auto index = std::make_shared<CPointGridIndex>();
+        auto polydata = meshCache.Load(path, stlReader, index.get());
+        std::string errorMessage = meshCache.ErrorMessage();
+        if(polydata && m_bCancelLoad)
+        {
+            polydata = nullptr;
+            errorMessage = "reading " + path + " was canceled";
+        }
+        QMetaObject::invokeMethod(this, [this, generation, polydata, index, errorMessage]()
+        {
+            if(generation == m_nLoadGeneration)
+                OnMeshLoaded(polydata, index, errorMessage);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void QvtkStlAlgorithmTest::OnPreviewLoaded(vtkSmartPointer<vtkPolyData> preview)
+{
+    if(m_bCancelLoad)
+        return;
+    m_displayWidget->Mapper<0>()->SetInputData(preview);
+    m_displayWidget->Renderer()->ResetCamera();
+    m_displayWidget->Render();
+    m_bPreviewShown = true;
+    const double firstFrame = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_loadStart).count();
+    std::cout << "time to first frame: " << firstFrame << " s" << std::endl;
+}
+
+void QvtkStlAlgorithmTest::OnMeshLoaded(vtkSmartPointer<vtkPolyData> polydata, std::shared_ptr<CPointGridIndex> index, const std::string& errorMessage)
+{
+    // only called for the current load, whose worker queued this as its last step
+    if(m_loadThread.joinable())
+        m_loadThread.join();
+    m_loadProgress->hide();
+    m_cancelLoad->hide();
+    if(!polydata)
+    {
+        m_displayWidget->Mapper<0>()->SetInputData(vtkSmartPointer<vtkPolyData>::New());
+        m_displayWidget->Render();
+        std::cout << errorMessage << std::endl;
+        statusBar()->showMessage(QString::fromStdString(errorMessage));
+        return;
+    }
+
+    m_displayWidget->Mapper<0>()->SetInputData(polydata);
+    m_selection->SetInputData(polydata);
+    m_selection->ClearSelection();
+    m_selection->AdoptPointIndex(std::move(*index));
+    if(!m_bPreviewShown)
+        m_displayWidget->Renderer()->ResetCamera();
+    m_displayWidget->Render();
+    const double interactive = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_loadStart).count();
+    std::cout << "time to interactive: " << interactive << " s" << std::endl;
+    statusBar()->showMessage(tr("%1 triangles, interactive after %2 s")
+        .arg(polydata->GetNumberOfPolys())
+        .arg(interactive, 0, 'f', 3));
 }
 
 void QvtkStlAlgorithmTest::OnMouseLeftClick(bool b, double x, double y, double z)
@@ -1,5 +1,10 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
 #include <QtWidgets/QMainWindow>
 #include "ui_QvtkStlAlgorithmTest.h"
 #include "vtkPolyDataMapper.h"
@@ -8,19 +13,37 @@
 
 class vtkPolyDataMapper;
 class vtkActor;
+class vtkPolyData;
 class InteractorStyleMouseListener;
+class vtkAppendableSelection;
+class CPointGridIndex;
+class QProgressBar;
+class QPushButton;
 class QvtkStlAlgorithmTest : public QMainWindow
 {
     Q_OBJECT
 
 public:
     QvtkStlAlgorithmTest(QWidget *parent = Q_NULLPTR);
+    ~QvtkStlAlgorithmTest();
 
 private:
     void OnMouseLeftClick(bool b, double x, double y, double z);
+    // reads, welds and computes the normals on m_loadThread, the preview and the mesh come back through the event loop
+    void LoadAsync(const std::string& path);
+    void OnPreviewLoaded(vtkSmartPointer<vtkPolyData> preview);
+    void OnMeshLoaded(vtkSmartPointer<vtkPolyData> polydata, std::shared_ptr<CPointGridIndex> index, const std::string& errorMessage);
 private:
     Ui::QvtkStlAlgorithmTestClass ui;
     using DisplayWidgetType = QVTKDisplayWidget<vtkPolyDataMapper, vtkActor>;
     std::unique_ptr<DisplayWidgetType> m_displayWidget;
     vtkSmartPointer<InteractorStyleMouseListener> m_mouseListener;
+    vtkSmartPointer<vtkAppendableSelection> m_selection;//on the loaded mesh, with the point index of the mesh cache
+    QProgressBar* m_loadProgress;
+    QPushButton* m_cancelLoad;
+    std::thread m_loadThread;
+    std::atomic<bool> m_bCancelLoad;
+    bool m_bPreviewShown;
+    unsigned m_nLoadGeneration;//of the current load, bumped by LoadAsync() on the GUI thread
+    std::chrono::steady_clock::time_point m_loadStart;
 };
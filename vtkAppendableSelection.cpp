@@ -1,132 +1,422 @@
 #include "vtkAppendableSelection.h"
+#include "vtkHelperFunctions.h"
 
-#include <set>
-#include <queue>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
 
 #include <vtkInformation.h>
 #include <vtkInformationVector.h>
 #include <vtkDemandDrivenPipeline.h>
 #include <vtkPolyData.h>
 #include <vtkCellData.h>
-#include <vtkSelectionNode.h>
-#include <vtkSelection.h>
-#include <vtkExtractSelection.h>
-#include <vtkGeometryFilter.h>
-#include <vtkPointLocator.h>
+#include <vtkPointData.h>
+#include <vtkCellArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkPoints.h>
+#include <vtkSMPTools.h>
+#include <vtkPlanes.h>
+#include <vtkDataArray.h>
+#include <vtkMath.h>
 
 vtkStandardNewMacro(vtkAppendableSelection);
 
-static bool GetCellIdsInRegion(vtkPolyData* polydata, std::array<double, 3> pos3d, double radius, vtkIdList* outIds)
+namespace
 {
-	// input check
-	if(!polydata|| radius <= 0.0 || !outIds)
-		return false;
-	std::set<vtkIdType> visitedCells;
+constexpr vtkIdType MarkedPointsBlockSize = 1024;
+
+// lasso polygon in normalized view coordinates, extruded along the view direction between the clipping planes
+class LassoRegion
+{
+public:
+	LassoRegion(const std::vector<std::array<double, 2>>& polygon, const std::array<double, 16>& worldToView)
+		: m_polygon(polygon)
+		, m_matrix(worldToView)
+		, m_bConvex(true)
+	{
+		m_lower = {polygon[0][0], polygon[0][1]};
+		m_upper = m_lower;
+		// turning the same way at every vertex is not enough, a self intersecting lasso like a pentagram
+		// does too, but turns around more than once
+		int turn(0);
+		double turning(0.0);
+		const std::size_t n = polygon.size();
+		for(std::size_t i = 0; i < n; ++i)
+		{
+			const auto& a = polygon[i];
+			const auto& b = polygon[(i + 1) % n];
+			const auto& c = polygon[(i + 2) % n];
+			for(int j = 0; j < 2; ++j)
+			{
+				m_lower[j] = std::min(m_lower[j], a[j]);
+				m_upper[j] = std::max(m_upper[j], a[j]);
+			}
+			const double cross = (b[0] - a[0]) * (c[1] - b[1]) - (b[1] - a[1]) * (c[0] - b[0]);
+			const double dot = (b[0] - a[0]) * (c[0] - b[0]) + (b[1] - a[1]) * (c[1] - b[1]);
+			turning += std::atan2(cross, dot);
+			const int sign = cross > 0.0 ? 1 : (cross < 0.0 ? -1 : 0);
+			if(sign != 0 && turn != 0 && sign != turn)
+				m_bConvex = false;
+			if(sign != 0)
+				turn = sign;
+		}
+		if(std::abs(std::abs(turning) - 2.0 * vtkMath::Pi()) > 1e-6)
+			m_bConvex = false;
+	}
 
-	auto pointLocator = vtkSmartPointer<vtkPointLocator>::New();
-	pointLocator->SetDataSet(polydata);
-	pointLocator->AutomaticOn();
-	pointLocator->SetNumberOfPointsPerBucket(2);
-	pointLocator->BuildLocator();
+	// false when the point is behind the camera or outside the clipping range
+	bool Project(const double x[3], double view[3]) const
+	{
+		double v[4];
+		for(int i = 0; i < 4; ++i)
+			v[i] = m_matrix[4*i] * x[0] + m_matrix[4*i+1] * x[1] + m_matrix[4*i+2] * x[2] + m_matrix[4*i+3];
+		if(v[3] <= 0.0)
+			return false;
+		for(int i = 0; i < 3; ++i)
+			view[i] = v[i] / v[3];
+		return view[2] >= -1.0 && view[2] <= 1.0;
+	}
+
+	bool IsInsidePolygon(double px, double py) const
+	{
+		bool inside(false);
+		const std::size_t n = m_polygon.size();
+		for(std::size_t i = 0, j = n - 1; i < n; j = i++)
+		{
+			const auto& a = m_polygon[i];
+			const auto& b = m_polygon[j];
+			if(((a[1] > py) != (b[1] > py)) && (px < (b[0] - a[0]) * (py - a[1]) / (b[1] - a[1]) + a[0]))
+				inside = !inside;
+		}
+		return inside;
+	}
 
-	auto pointsInRadius = vtkSmartPointer<vtkIdList>::New();
-	pointLocator->FindPointsWithinRadius(radius, pos3d.data(), pointsInRadius);
+	bool IsInside(const double x[3]) const
+	{
+		double view[3];
+		return Project(x, view) && IsInsidePolygon(view[0], view[1]);
+	}
 
-	const vtkIdType pointCnt = pointsInRadius->GetNumberOfIds();
-	vtkSmartPointer<vtkIdList> tmpCells = vtkSmartPointer<vtkIdList>::New();
-	vtkSmartPointer<vtkIdList> tmpCellPoints = vtkSmartPointer<vtkIdList>::New();
-	for(vtkIdType i = 0; i < pointCnt; ++i)
+	// a box is only accepted whole for a convex lasso, whose inside contains the hull of the projected corners
+	CCellBVH::Overlap BoxOverlap(const double bounds[6]) const
 	{
-		tmpCells->Initialize();
-		polydata->GetPointCells(pointsInRadius->GetId(i), tmpCells);
-		const vtkIdType cellCount = tmpCells->GetNumberOfIds();
-		for(vtkIdType j = 0; j < cellCount; ++j)
+		std::array<double, 2> lower = {VTK_DOUBLE_MAX, VTK_DOUBLE_MAX};
+		std::array<double, 2> upper = {-VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX};
+		double nearest(VTK_DOUBLE_MAX), farthest(-VTK_DOUBLE_MAX);
+		bool allCornersInside(true);
+		for(int c = 0; c < 8; ++c)
 		{
-			const vtkIdType cellId = tmpCells->GetId(j);
-			if(visitedCells.count(cellId) == 0)
+			const double x[3] = {bounds[(c & 1) ? 1 : 0], bounds[(c & 2) ? 3 : 2], bounds[(c & 4) ? 5 : 4]};
+			double v[4];
+			for(int i = 0; i < 4; ++i)
+				v[i] = m_matrix[4*i] * x[0] + m_matrix[4*i+1] * x[1] + m_matrix[4*i+2] * x[2] + m_matrix[4*i+3];
+			if(v[3] <= 0.0)
+				return CCellBVH::Overlap::Partial;
+			const double view[3] = {v[0] / v[3], v[1] / v[3], v[2] / v[3]};
+			for(int j = 0; j < 2; ++j)
 			{
-				visitedCells.insert(cellId);
-				tmpCellPoints->Initialize();
-				polydata->GetCellPoints(cellId, tmpCellPoints);
-				bool allVertexWithinRadius(true);
-				for(int k = 0; k < tmpCellPoints->GetNumberOfIds(); ++k)
-				{
-					if(-1 == pointsInRadius->IsId(tmpCellPoints->GetId(k)))
-					{
-						allVertexWithinRadius = false;
-						break;
-					}
-				}
-				if(allVertexWithinRadius)
-					outIds->InsertUniqueId(cellId);
+				lower[j] = std::min(lower[j], view[j]);
+				upper[j] = std::max(upper[j], view[j]);
 			}
+			nearest = std::min(nearest, view[2]);
+			farthest = std::max(farthest, view[2]);
+			if(view[2] < -1.0 || view[2] > 1.0 || !IsInsidePolygon(view[0], view[1]))
+				allCornersInside = false;
 		}
+		if(upper[0] < m_lower[0] || lower[0] > m_upper[0] || upper[1] < m_lower[1] || lower[1] > m_upper[1] || farthest < -1.0 || nearest > 1.0)
+			return CCellBVH::Overlap::Outside;
+		return (allCornersInside && m_bConvex) ? CCellBVH::Overlap::Inside : CCellBVH::Overlap::Partial;
 	}
-	return true;
-}
 
-vtkSmartPointer<vtkPolyData> GetCellsPolyData(vtkPolyData* pd, vtkIdTypeArray* ids)
+private:
+	const std::vector<std::array<double, 2>>& m_polygon;
+	const std::array<double, 16>& m_matrix;
+	std::array<double, 2> m_lower;
+	std::array<double, 2> m_upper;
+	bool m_bConvex;
+};
+
+// sorted ids are stored as LEB128 varints of the gaps between neighbours
+std::vector<unsigned char> EncodeSortedIds(const std::vector<vtkIdType>& ids)
 {
-	auto ret = vtkSmartPointer<vtkPolyData>::New();
-	if(pd && ids)
+	std::vector<unsigned char> ret;
+	ret.reserve(ids.size() * 2);
+	vtkIdType last(0);
+	for(const auto id : ids)
 	{
-		auto selectionNode = vtkSmartPointer<vtkSelectionNode>::New();
-		selectionNode->SetFieldType(vtkSelectionNode::CELL);	
-		selectionNode->SetContentType(vtkSelectionNode::INDICES);
-		selectionNode->SetSelectionList(ids);
-		selectionNode->GetProperties()->Set(vtkSelectionNode::CONTAINING_CELLS(), 1);
-		selectionNode->GetProperties()->Set(vtkSelectionNode::INVERSE(), 0);
+		auto gap = static_cast<unsigned long long>(id - last);
+		last = id;
+		while(gap >= 0x80)
+		{
+			ret.push_back(static_cast<unsigned char>(gap | 0x80));
+			gap >>= 7;
+		}
+		ret.push_back(static_cast<unsigned char>(gap));
+	}
+	ret.shrink_to_fit();
+	return ret;
+}
 
-		auto selection = vtkSmartPointer<vtkSelection>::New();
-		selection->AddNode(selectionNode);
+std::vector<vtkIdType> DecodeSortedIds(const std::vector<unsigned char>& bytes, vtkIdType count)
+{
+	std::vector<vtkIdType> ret;
+	ret.reserve(count);
+	vtkIdType last(0);
+	std::size_t pos(0);
+	for(vtkIdType i = 0; i < count && pos < bytes.size(); ++i)
+	{
+		unsigned long long gap(0);
+		int shift(0);
+		while(bytes[pos] & 0x80)
+		{
+			gap |= static_cast<unsigned long long>(bytes[pos++] & 0x7f) << shift;
+			shift += 7;
+		}
+		gap |= static_cast<unsigned long long>(bytes[pos++]) << shift;
+		last += static_cast<vtkIdType>(gap);
+		ret.push_back(last);
+	}
+	return ret;
+}
 
-		auto extractSelection = vtkSmartPointer<vtkExtractSelection>::New();
-		extractSelection->SetInputData(0, pd);
-		extractSelection->SetInputData(1, selection);
-		extractSelection->Update();
+// shrink an array without reallocating it, Reset() keeps the buffer and WriteVoidPointer() moves the end back
+void TruncateArray(vtkAbstractArray* array, vtkIdType numTuples)
+{
+	if(!array)
+		return;
+	const vtkIdType numValues = numTuples * array->GetNumberOfComponents();
+	array->Reset();
+	if(numValues > 0)
+		array->WriteVoidPointer(0, numValues);
+	array->Modified();
+}
 
-		auto geometryFilter = vtkSmartPointer<vtkGeometryFilter>::New();
-		geometryFilter->SetInputData(extractSelection->GetOutput());
-		geometryFilter->Update();
+// a cell is reported only by the marked point that is its first vertex, so every cell is found
+// exactly once and the blocks need no shared visited set
+class CellsOfMarkedPointsFunctor
+{
+public:
+	CellsOfMarkedPointsFunctor(vtkPolyData* polydata, const std::vector<vtkIdType>& points, const CEpochMask& pointMask, std::vector<std::vector<vtkIdType>>& blockCells)
+		: m_polydata(polydata)
+		, m_points(points)
+		, m_pointMask(pointMask)
+		, m_blockCells(blockCells)
+	{
+	}
 
-		ret->ShallowCopy(geometryFilter->GetOutput());
+	void operator()(vtkIdType beginBlock, vtkIdType endBlock) const
+	{
+		const vtkIdType pointCount = static_cast<vtkIdType>(m_points.size());
+		unsigned short cellCount(0);
+		vtkIdType* cells(nullptr);
+		vtkIdType nPoints(0);
+		vtkIdType* pts(nullptr);
+		for(vtkIdType b = beginBlock; b < endBlock; ++b)
+		{
+			auto& blockCells = m_blockCells[b];
+			blockCells.clear();
+			const vtkIdType last = std::min(pointCount, (b + 1) * MarkedPointsBlockSize);
+			for(vtkIdType i = b * MarkedPointsBlockSize; i < last; ++i)
+			{
+				const vtkIdType ptId = m_points[i];
+				m_polydata->GetPointCells(ptId, cellCount, cells);
+				for(unsigned short j = 0; j < cellCount; ++j)
+				{
+					m_polydata->GetCellPoints(cells[j], nPoints, pts);
+					if(nPoints == 0 || pts[0] != ptId)
+						continue;
+					bool allVertexWithinRadius(true);
+					bool repeated(false);
+					for(vtkIdType k = 1; k < nPoints; ++k)
+					{
+						repeated = repeated || pts[k] == ptId;
+						if(!m_pointMask.IsMarked(pts[k]))
+						{
+							allVertexWithinRadius = false;
+							break;
+						}
+					}
+					// a degenerate cell that repeats its first vertex is linked to it once per occurrence,
+					// only then the earlier links are searched
+					if(allVertexWithinRadius && (!repeated || std::find(cells, cells + j, cells[j]) == cells + j))
+						blockCells.push_back(cells[j]);
+				}
+			}
+		}
 	}
 
-	return ret;
+private:
+	vtkPolyData* m_polydata;
+	const std::vector<vtkIdType>& m_points;
+	const CEpochMask& m_pointMask;
+	std::vector<std::vector<vtkIdType>>& m_blockCells;
+};
 }
 
 vtkAppendableSelection::vtkAppendableSelection()
 	: vtkPolyDataAlgorithm()
-	, m_pos3d({0.0, 0.0, 0.0})
+	, m_shape(SHAPE_SPHERE)
+	, m_worldToView({1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0})
 	, m_dRadius(0.0)
 	, m_bAppend(false)
+	, m_bSweep(false)
+	, m_bGeodesicDistance(true)
+	, m_pickedCell(-1)
+	, m_bParallelSelection(true)
 	, m_bSetSelection(false)
 	, m_bClearSelection(false)
 	, m_selectedRegion(vtkSmartPointer<vtkIdList>::New())
 	, m_applyRegion(vtkSmartPointer<vtkIdList>::New())
+	, m_indexMTime(0)
+	, m_bIndexAdopted(false)
+	, m_bvhMTime(0)
+	, m_adjacencyMTime(0)
+	, m_accumulated(vtkSmartPointer<vtkPolyData>::New())
+	, m_historyBudget(64 * 1024 * 1024)
+	, m_historySize(0)
 {
     SetNumberOfInputPorts(1);
     SetNumberOfOutputPorts(2);
 }
 
-void vtkAppendableSelection::SelectionSetting(std::array<double, 3> pos3d, double radius, bool append)
+void vtkAppendableSelection::SelectionSetting(const std::vector<std::array<double, 3>>& centers, double radius, bool append, bool sweep)
 {
-	std::copy(pos3d.cbegin(), pos3d.cend(), m_pos3d.begin());
+	m_shape = SHAPE_SPHERE;
+	m_centers = centers;
 	m_dRadius = radius;
 	m_bAppend = append;
+	m_bSweep = sweep;
 
+	// a pending selection is replaced, the steps requested after it now come before the new one
+	m_historySteps.insert(m_historySteps.end(), m_historyStepsAfter.cbegin(), m_historyStepsAfter.cend());
+	m_historyStepsAfter.clear();
 	m_bSetSelection = true;
 	this->Modified();
 }
 
 void vtkAppendableSelection::NoAppendSelection(std::array<double, 3> pos3d, double radius)
 {
-	SelectionSetting(pos3d, radius, false);
+	SelectionSetting({pos3d}, radius, false, false);
 }
 
 void vtkAppendableSelection::AppendSelection(std::array<double, 3> pos3d, double radius)
 {
-	SelectionSetting(pos3d, radius, true);
+	SelectionSetting({pos3d}, radius, true, false);
+}
+
+void vtkAppendableSelection::NoAppendStroke(const std::vector<std::array<double, 3>>& centers, double radius, bool sweep)
+{
+	SelectionSetting(centers, radius, false, sweep);
+}
+
+void vtkAppendableSelection::AppendStroke(const std::vector<std::array<double, 3>>& centers, double radius, bool sweep)
+{
+	SelectionSetting(centers, radius, true, sweep);
+}
+
+void vtkAppendableSelection::ShapeSetting(int shape, bool append)
+{
+	m_shape = shape;
+	m_centers.clear();
+	m_bAppend = append;
+
+	// a pending selection is replaced, the steps requested after it now come before the new one
+	m_historySteps.insert(m_historySteps.end(), m_historyStepsAfter.cbegin(), m_historyStepsAfter.cend());
+	m_historyStepsAfter.clear();
+	m_bSetSelection = true;
+	this->Modified();
+}
+
+static std::vector<std::array<double, 4>> InwardPlanes(vtkPlanes* frustum)
+{
+	// vtkPlanes keeps outward normals, the inside is where every plane function is negative
+	std::vector<std::array<double, 4>> ret;
+	if(!frustum || !frustum->GetPoints() || !frustum->GetNormals())
+		return ret;
+	double origin[3], normal[3];
+	for(int i = 0; i < frustum->GetNumberOfPlanes(); ++i)
+	{
+		frustum->GetPoints()->GetPoint(i, origin);
+		frustum->GetNormals()->GetTuple(i, normal);
+		ret.push_back({-normal[0], -normal[1], -normal[2], normal[0]*origin[0] + normal[1]*origin[1] + normal[2]*origin[2]});
+	}
+	return ret;
+}
+
+static std::vector<std::array<double, 4>> BoxPlanes(const std::array<double, 3>& center, const std::array<std::array<double, 3>, 3>& axes, const std::array<double, 3>& halfLengths)
+{
+	std::vector<std::array<double, 4>> ret;
+	for(int i = 0; i < 3; ++i)
+	{
+		std::array<double, 3> axis = axes[i];
+		const double length = std::sqrt(axis[0]*axis[0] + axis[1]*axis[1] + axis[2]*axis[2]);
+		if(length == 0.0)
+			continue;
+		for(auto& iter : axis)
+			iter /= length;
+		const double c = axis[0]*center[0] + axis[1]*center[1] + axis[2]*center[2];
+		ret.push_back({axis[0], axis[1], axis[2], halfLengths[i] - c});
+		ret.push_back({-axis[0], -axis[1], -axis[2], halfLengths[i] + c});
+	}
+	return ret;
+}
+
+// the frustum is usually vtkAreaPicker::GetFrustum() of a rubber band rectangle
+void vtkAppendableSelection::NoAppendFrustumSelection(vtkPlanes* frustum)
+{
+	m_planes = InwardPlanes(frustum);
+	ShapeSetting(SHAPE_CONVEX, false);
+}
+
+void vtkAppendableSelection::AppendFrustumSelection(vtkPlanes* frustum)
+{
+	m_planes = InwardPlanes(frustum);
+	ShapeSetting(SHAPE_CONVEX, true);
+}
+
+void vtkAppendableSelection::NoAppendBoxSelection(std::array<double, 3> center, std::array<std::array<double, 3>, 3> axes, std::array<double, 3> halfLengths)
+{
+	m_planes = BoxPlanes(center, axes, halfLengths);
+	ShapeSetting(SHAPE_CONVEX, false);
+}
+
+void vtkAppendableSelection::AppendBoxSelection(std::array<double, 3> center, std::array<std::array<double, 3>, 3> axes, std::array<double, 3> halfLengths)
+{
+	m_planes = BoxPlanes(center, axes, halfLengths);
+	ShapeSetting(SHAPE_CONVEX, true);
+}
+
+// worldToView is the row major camera->GetCompositeProjectionTransformMatrix(aspect, -1, 1),
+// the polygon is given in the same normalized view coordinates, x and y in [-1, 1]
+void vtkAppendableSelection::NoAppendLassoSelection(const std::vector<std::array<double, 2>>& polygon, const std::array<double, 16>& worldToView)
+{
+	m_lasso = polygon;
+	m_worldToView = worldToView;
+	ShapeSetting(SHAPE_LASSO, false);
+}
+
+void vtkAppendableSelection::AppendLassoSelection(const std::vector<std::array<double, 2>>& polygon, const std::array<double, 16>& worldToView)
+{
+	m_lasso = polygon;
+	m_worldToView = worldToView;
+	ShapeSetting(SHAPE_LASSO, true);
+}
+
+void vtkAppendableSelection::NoAppendGeodesicSelection(std::array<double, 3> pos3d, double radius, bool geodesicDistance, vtkIdType pickedCell)
+{
+	SelectionSetting({pos3d}, radius, false, false);
+	m_shape = SHAPE_GEODESIC;
+	m_bGeodesicDistance = geodesicDistance;
+	m_pickedCell = pickedCell;
+}
+
+void vtkAppendableSelection::AppendGeodesicSelection(std::array<double, 3> pos3d, double radius, bool geodesicDistance, vtkIdType pickedCell)
+{
+	SelectionSetting({pos3d}, radius, true, false);
+	m_shape = SHAPE_GEODESIC;
+	m_bGeodesicDistance = geodesicDistance;
+	m_pickedCell = pickedCell;
 }
 
 void vtkAppendableSelection::ClearSelection()
@@ -136,6 +426,39 @@ void vtkAppendableSelection::ClearSelection()
 	this->Modified();
 }
 
+void vtkAppendableSelection::Undo()
+{
+	(m_bSetSelection ? m_historyStepsAfter : m_historySteps).push_back(-1);
+	this->Modified();
+}
+
+void vtkAppendableSelection::Redo()
+{
+	(m_bSetSelection ? m_historyStepsAfter : m_historySteps).push_back(1);
+	this->Modified();
+}
+
+bool vtkAppendableSelection::CanUndo() const
+{
+	return PendingStackDepths().first > 0;
+}
+
+bool vtkAppendableSelection::CanRedo() const
+{
+	return PendingStackDepths().second > 0;
+}
+
+void vtkAppendableSelection::SetHistoryMemoryBudget(std::size_t bytes)
+{
+	m_historyBudget = bytes;
+	TrimHistory();
+}
+
+std::size_t vtkAppendableSelection::GetHistoryMemorySize() const
+{
+	return m_historySize;
+}
+
 vtkSmartPointer<vtkIdList> vtkAppendableSelection::GetAppliedRegionIds()
 {
 	return m_applyRegion;
@@ -146,6 +469,592 @@ std::vector<std::array<double, 3>> vtkAppendableSelection::SelectedCenters() con
 	return m_selectedCeneters;
 }
 
+vtkAppendableSelection::SelectionTimings vtkAppendableSelection::GetLastTimings() const
+{
+	return m_timings;
+}
+
+double vtkAppendableSelection::GetIndexBuildTime() const
+{
+	return m_pointIndex.BuildTime();
+}
+
+std::size_t vtkAppendableSelection::GetIndexMemorySize() const
+{
+	return m_pointIndex.MemorySize();
+}
+
+void vtkAppendableSelection::UpdatePointIndex(vtkPolyData* polydata)
+{
+	// the index, the cell links and the mask sizes only depend on the input, so they survive
+	// selection requests and are rebuilt when the input polydata (or its point set) has changed
+	if(!polydata)
+	{
+		m_pointIndex.Clear();
+		m_indexMTime = 0;
+		m_bIndexAdopted = false;
+		return;
+	}
+	if(m_pointIndex.IsBuilt() && m_pointIndex.Points() == polydata->GetPoints() && m_indexMTime == polydata->GetMTime())
+		return;
+
+	if(!m_bIndexAdopted || m_pointIndex.Points() != polydata->GetPoints())
+		m_pointIndex.Build(polydata->GetPoints());
+	m_bIndexAdopted = false;
+	polydata->BuildLinks();
+	m_pointMask.Resize(polydata->GetNumberOfPoints());
+	m_indexMTime = polydata->GetMTime();
+}
+
+// mark the points inside the union of the spheres (or swept capsules) of the stroke,
+// a cell is selected when all its vertices are inside that union
+bool vtkAppendableSelection::GetCellIdsInRegion(vtkPolyData* polydata, const std::vector<std::array<double, 3>>& centers, double radius, bool sweep, vtkIdList* outIds)
+{
+	// input check
+	if(!polydata|| radius <= 0.0 || !outIds || !m_pointIndex.IsBuilt() || centers.empty())
+		return false;
+
+	m_pointMask.NextEpoch();
+	m_pointsInRadius.clear();
+	const std::size_t queryCount = (sweep && centers.size() > 1) ? centers.size() - 1 : centers.size();
+	for(std::size_t i = 0; i < queryCount; ++i)
+	{
+		if(sweep && centers.size() > 1)
+			m_pointIndex.FindPointsWithinCapsule(centers[i], centers[i+1], radius, m_queryResult);
+		else
+			m_pointIndex.FindPointsWithinRadius(centers[i], radius, m_queryResult);
+		for(const auto ptId : m_queryResult)
+		{
+			if(m_pointMask.TestAndMark(ptId))
+				m_pointsInRadius.push_back(ptId);
+		}
+	}
+
+	GetCellIdsOfMarkedPoints(polydata, outIds);
+	return true;
+}
+
+void vtkAppendableSelection::AdoptPointIndex(CPointGridIndex index)
+{
+	m_pointIndex = std::move(index);
+	m_indexMTime = 0;
+	m_bIndexAdopted = m_pointIndex.IsBuilt();
+}
+
+void vtkAppendableSelection::SetParallelSelection(bool parallel)
+{
+	m_bParallelSelection = parallel;
+}
+
+bool vtkAppendableSelection::GetParallelSelection() const
+{
+	return m_bParallelSelection;
+}
+
+// every cell around m_pointsInRadius is accepted when all its vertices are marked.
+// The points are processed in fixed blocks, each block writes its own cell list and the lists are
+// joined in block order, so the serial and the vtkSMPTools path give exactly the same output.
+void vtkAppendableSelection::GetCellIdsOfMarkedPoints(vtkPolyData* polydata, vtkIdList* outIds)
+{
+	const vtkIdType pointCount = static_cast<vtkIdType>(m_pointsInRadius.size());
+	const vtkIdType blockCount = (pointCount + MarkedPointsBlockSize - 1) / MarkedPointsBlockSize;
+	if(static_cast<vtkIdType>(m_blockCells.size()) < blockCount)
+		m_blockCells.resize(blockCount);
+
+	CellsOfMarkedPointsFunctor functor(polydata, m_pointsInRadius, m_pointMask, m_blockCells);
+	if(m_bParallelSelection && pointCount > MarkedPointsBlockSize)
+		vtkSMPTools::For(0, blockCount, 1, functor);
+	else
+		functor(0, blockCount);
+
+	std::size_t total(0);
+	for(vtkIdType b = 0; b < blockCount; ++b)
+		total += m_blockCells[b].size();
+	vtkIdType* out = outIds->WritePointer(outIds->GetNumberOfIds(), static_cast<vtkIdType>(total));
+	for(vtkIdType b = 0; b < blockCount; ++b)
+		out = std::copy(m_blockCells[b].cbegin(), m_blockCells[b].cend(), out);
+}
+
+double vtkAppendableSelection::GetBVHBuildTime() const
+{
+	return m_cellBVH.BuildTime();
+}
+
+std::size_t vtkAppendableSelection::GetBVHMemorySize() const
+{
+	return m_cellBVH.MemorySize();
+}
+
+void vtkAppendableSelection::UpdateCellBVH(vtkPolyData* polydata)
+{
+	// only built once a frustum, box or lasso selection needs it, and kept until the input changes
+	if(!polydata)
+	{
+		m_cellBVH.Clear();
+		m_bvhMTime = 0;
+		return;
+	}
+	if(m_cellBVH.IsBuilt() && m_cellBVH.PolyData() == polydata && m_bvhMTime == polydata->GetMTime())
+		return;
+
+	m_cellBVH.Build(polydata);
+	m_bvhMTime = polydata->GetMTime();
+}
+
+bool vtkAppendableSelection::HasValidRequest() const
+{
+	switch(m_shape)
+	{
+	case SHAPE_SPHERE:
+	case SHAPE_GEODESIC: return m_dRadius > 0.0 && !m_centers.empty();
+	case SHAPE_CONVEX: return !m_planes.empty();
+	case SHAPE_LASSO: return m_lasso.size() >= 3;
+	default: return false;
+	}
+}
+
+void vtkAppendableSelection::GetCellIdsInShape(vtkPolyData* polydata, vtkIdList* outIds)
+{
+	m_queryResult.clear();
+	vtkPoints* points = polydata->GetPoints();
+	if(m_shape == SHAPE_CONVEX)
+	{
+		const auto& planes = m_planes;
+		auto cellTest = [polydata, points, &planes](vtkIdType cellId)
+		{
+			vtkIdType nPoints(0);
+			vtkIdType* pts(nullptr);
+			double x[3];
+			polydata->GetCellPoints(cellId, nPoints, pts);
+			for(vtkIdType k = 0; k < nPoints; ++k)
+			{
+				points->GetPoint(pts[k], x);
+				for(const auto& plane : planes)
+				{
+					if(plane[0]*x[0] + plane[1]*x[1] + plane[2]*x[2] + plane[3] < 0.0)
+						return false;
+				}
+			}
+			return nPoints > 0;
+		};
+		m_cellBVH.FindCells([&planes](const double bounds[6]) { return CCellBVH::BoxOverlapPlanes(bounds, planes); }, cellTest, m_queryResult);
+	}
+	else if(m_shape == SHAPE_LASSO)
+	{
+		const LassoRegion lasso(m_lasso, m_worldToView);
+		auto cellTest = [polydata, points, &lasso](vtkIdType cellId)
+		{
+			vtkIdType nPoints(0);
+			vtkIdType* pts(nullptr);
+			double x[3];
+			polydata->GetCellPoints(cellId, nPoints, pts);
+			for(vtkIdType k = 0; k < nPoints; ++k)
+			{
+				points->GetPoint(pts[k], x);
+				if(!lasso.IsInside(x))
+					return false;
+			}
+			return nPoints > 0;
+		};
+		m_cellBVH.FindCells([&lasso](const double bounds[6]) { return lasso.BoxOverlap(bounds); }, cellTest, m_queryResult);
+	}
+
+	vtkIdType* out = outIds->WritePointer(outIds->GetNumberOfIds(), static_cast<vtkIdType>(m_queryResult.size()));
+	std::copy(m_queryResult.cbegin(), m_queryResult.cend(), out);
+}
+
+double vtkAppendableSelection::GetAdjacencyBuildTime() const
+{
+	return m_cellAdjacency.BuildTime();
+}
+
+std::size_t vtkAppendableSelection::GetAdjacencyMemorySize() const
+{
+	return m_cellAdjacency.MemorySize();
+}
+
+void vtkAppendableSelection::UpdateCellAdjacency(vtkPolyData* polydata)
+{
+	// relies on the point links built by UpdatePointIndex(), kept until the input changes
+	if(!polydata)
+	{
+		m_cellAdjacency.Clear();
+		m_adjacencyMTime = 0;
+		return;
+	}
+	if(m_cellAdjacency.IsBuilt() && m_cellAdjacency.PolyData() == polydata && m_adjacencyMTime == polydata->GetMTime())
+		return;
+
+	m_cellAdjacency.Build(polydata, m_bParallelSelection);
+	m_cellMask.Resize(polydata->GetNumberOfCells());
+	m_cellDistance.resize(polydata->GetNumberOfCells());
+	m_adjacencyMTime = polydata->GetMTime();
+}
+
+// Dijkstra over the cells from the seed cells, the distance of a cell is the length of the path from the pick
+// through the centers of the cells crossed, an approximation of the geodesic distance on the surface.
+// With m_bGeodesicDistance false a cell is reached when all its vertices are within the radius of the pick,
+// the result is the part of the sphere selection connected to the pick.
+// Only the reached cells and their neighbours are visited.
+void vtkAppendableSelection::GetCellIdsGeodesic(vtkPolyData* polydata, vtkIdList* outIds)
+{
+	m_queryResult.clear();
+	const std::array<double, 3>& center = m_centers.front();
+	const double radius = m_dRadius;
+	const double radius2 = radius * radius;
+	vtkPoints* points = polydata->GetPoints();
+	vtkIdType nPoints(0);
+	vtkIdType* pts(nullptr);
+	auto cellCenter = [polydata, points, &nPoints, &pts](vtkIdType cellId, double c[3])
+	{
+		double x[3];
+		c[0] = c[1] = c[2] = 0.0;
+		polydata->GetCellPoints(cellId, nPoints, pts);
+		for(vtkIdType k = 0; k < nPoints; ++k)
+		{
+			points->GetPoint(pts[k], x);
+			for(int j = 0; j < 3; ++j)
+				c[j] += x[j];
+		}
+		for(int j = 0; nPoints > 0 && j < 3; ++j)
+			c[j] /= nPoints;
+	};
+	auto verticesInRadius = [polydata, points, &nPoints, &pts, &center, radius2](vtkIdType cellId)
+	{
+		double x[3];
+		polydata->GetCellPoints(cellId, nPoints, pts);
+		for(vtkIdType k = 0; k < nPoints; ++k)
+		{
+			points->GetPoint(pts[k], x);
+			if((x[0]-center[0])*(x[0]-center[0]) + (x[1]-center[1])*(x[1]-center[1]) + (x[2]-center[2])*(x[2]-center[2]) > radius2)
+				return false;
+		}
+		return nPoints > 0;
+	};
+
+	// seeds: the picked cell, or the cells around the point nearest to the pick
+	std::vector<vtkIdType> seeds;
+	if(m_pickedCell >= 0 && m_pickedCell < polydata->GetNumberOfCells())
+	{
+		seeds.push_back(m_pickedCell);
+	}
+	else
+	{
+		m_pointIndex.FindPointsWithinRadius(center, radius, m_pointsInRadius);
+		vtkIdType nearest(-1);
+		double nearestDist2(VTK_DOUBLE_MAX);
+		double x[3];
+		for(const auto ptId : m_pointsInRadius)
+		{
+			points->GetPoint(ptId, x);
+			const double dist2 = (x[0]-center[0])*(x[0]-center[0]) + (x[1]-center[1])*(x[1]-center[1]) + (x[2]-center[2])*(x[2]-center[2]);
+			if(dist2 < nearestDist2)
+			{
+				nearestDist2 = dist2;
+				nearest = ptId;
+			}
+		}
+		if(nearest >= 0)
+		{
+			unsigned short cellCount(0);
+			vtkIdType* cells(nullptr);
+			polydata->GetPointCells(nearest, cellCount, cells);
+			seeds.assign(cells, cells + cellCount);
+		}
+	}
+
+	auto greater = std::greater<std::pair<double, vtkIdType>>();
+	m_geodesicQueue.clear();
+	m_cellMask.NextEpoch();
+	double c[3], neighborCenter[3];
+	for(const auto cellId : seeds)
+	{
+		cellCenter(cellId, c);
+		const double dist = std::sqrt(vtkMath::Distance2BetweenPoints(c, center.data()));
+		if(m_bGeodesicDistance ? dist > radius : !verticesInRadius(cellId))
+			continue;
+		if(!m_cellMask.TestAndMark(cellId))
+			continue;
+		m_cellDistance[cellId] = dist;
+		m_geodesicQueue.emplace_back(dist, cellId);
+		std::push_heap(m_geodesicQueue.begin(), m_geodesicQueue.end(), greater);
+	}
+	while(!m_geodesicQueue.empty())
+	{
+		std::pop_heap(m_geodesicQueue.begin(), m_geodesicQueue.end(), greater);
+		const auto entry = m_geodesicQueue.back();
+		m_geodesicQueue.pop_back();
+		if(entry.first > m_cellDistance[entry.second])
+			continue;//a shorter path reached the cell after this entry was queued
+		m_queryResult.push_back(entry.second);
+
+		vtkIdType neighborCount(0);
+		const vtkIdType* neighbors = m_cellAdjacency.GetNeighbors(entry.second, neighborCount);
+		cellCenter(entry.second, c);
+		for(vtkIdType i = 0; i < neighborCount; ++i)
+		{
+			const vtkIdType neighbor = neighbors[i];
+			const bool reached = m_cellMask.IsMarked(neighbor);
+			if(reached && !m_bGeodesicDistance)
+				continue;
+			cellCenter(neighbor, neighborCenter);
+			const double dist = entry.first + std::sqrt(vtkMath::Distance2BetweenPoints(c, neighborCenter));
+			if(m_bGeodesicDistance ? (dist > radius || (reached && dist >= m_cellDistance[neighbor])) : !verticesInRadius(neighbor))
+				continue;
+			m_cellMask.Mark(neighbor);
+			m_cellDistance[neighbor] = dist;
+			m_geodesicQueue.emplace_back(dist, neighbor);
+			std::push_heap(m_geodesicQueue.begin(), m_geodesicQueue.end(), greater);
+		}
+	}
+
+	// in id order like the other modes, the extraction then walks the input mostly forward
+	std::sort(m_queryResult.begin(), m_queryResult.end());
+	vtkIdType* out = outIds->WritePointer(outIds->GetNumberOfIds(), static_cast<vtkIdType>(m_queryResult.size()));
+	std::copy(m_queryResult.cbegin(), m_queryResult.cend(), out);
+}
+
+void vtkAppendableSelection::ResetAccumulated()
+{
+	m_accumulated->Initialize();
+	m_accConnectivity = nullptr;
+	m_accPointMask.NextEpoch();
+}
+
+void vtkAppendableSelection::AppendAccumulatedCells(vtkPolyData* polydata, const vtkIdType* cellIds, vtkIdType count)
+{
+	// output(1) owns its points and connectivity, new cells are appended at the end and the
+	// input points they use are copied once, later cells reuse them through m_accPointMap
+	if(!polydata || count <= 0)
+		return;
+	if(!m_accConnectivity)
+	{
+		auto points = vtkSmartPointer<vtkPoints>::New();
+		points->SetDataType(polydata->GetPoints()->GetDataType());
+		m_accConnectivity = vtkSmartPointer<vtkIdTypeArray>::New();
+		auto polys = vtkSmartPointer<vtkCellArray>::New();
+		polys->SetCells(0, m_accConnectivity);
+		m_accumulated->SetPoints(points);
+		m_accumulated->SetPolys(polys);
+		m_accumulated->GetPointData()->CopyAllocate(polydata->GetPointData());
+		m_accumulated->GetCellData()->CopyAllocate(polydata->GetCellData());
+	}
+	m_accPointMask.Resize(polydata->GetNumberOfPoints());
+	m_accPointMap.resize(polydata->GetNumberOfPoints());
+
+	vtkPoints* inPoints = polydata->GetPoints();
+	vtkPoints* outPoints = m_accumulated->GetPoints();
+	vtkPointData* inPD = polydata->GetPointData();
+	vtkPointData* outPD = m_accumulated->GetPointData();
+	vtkCellData* inCD = polydata->GetCellData();
+	vtkCellData* outCD = m_accumulated->GetCellData();
+	vtkCellArray* polys = m_accumulated->GetPolys();
+	vtkIdType numCells = polys->GetNumberOfCells();
+	vtkIdType nPoints(0);
+	vtkIdType* pts(nullptr);
+	double x[3];
+	for(vtkIdType i = 0; i < count; ++i)
+	{
+		const vtkIdType cellId = cellIds[i];
+		const int cellType = polydata->GetCellType(cellId);
+		if(cellType != VTK_TRIANGLE && cellType != VTK_QUAD && cellType != VTK_POLYGON)
+			continue;
+		polydata->GetCellPoints(cellId, nPoints, pts);
+		m_accConnectivity->InsertNextValue(nPoints);
+		for(vtkIdType k = 0; k < nPoints; ++k)
+		{
+			const vtkIdType inId = pts[k];
+			if(m_accPointMask.TestAndMark(inId))
+			{
+				inPoints->GetPoint(inId, x);
+				m_accPointMap[inId] = outPoints->InsertNextPoint(x);
+				outPD->CopyData(inPD, inId, m_accPointMap[inId]);
+			}
+			m_accConnectivity->InsertNextValue(m_accPointMap[inId]);
+		}
+		outCD->CopyData(inCD, cellId, numCells++);
+	}
+	polys->SetCells(numCells, m_accConnectivity);
+	outPoints->Modified();
+	m_accumulated->DeleteCells();
+	m_accumulated->Modified();
+}
+
+void vtkAppendableSelection::TruncateAccumulated(vtkIdType numPoints, vtkIdType numCells, vtkIdType connectivitySize)
+{
+	if(!m_accConnectivity)
+		return;
+	TruncateArray(m_accConnectivity, connectivitySize);
+	m_accumulated->GetPolys()->SetCells(numCells, m_accConnectivity);
+	TruncateArray(m_accumulated->GetPoints()->GetData(), numPoints);
+	m_accumulated->GetPoints()->Modified();
+	for(int i = 0; i < m_accumulated->GetPointData()->GetNumberOfArrays(); ++i)
+		TruncateArray(m_accumulated->GetPointData()->GetAbstractArray(i), numPoints);
+	for(int i = 0; i < m_accumulated->GetCellData()->GetNumberOfArrays(); ++i)
+		TruncateArray(m_accumulated->GetCellData()->GetAbstractArray(i), numCells);
+	m_accumulated->DeleteCells();
+	m_accumulated->Modified();
+}
+
+std::size_t vtkAppendableSelection::StrokeRecordSize(const StrokeRecord& record)
+{
+	return sizeof(record) + record.centers.capacity() * sizeof(record.centers[0]) + record.encodedCells.capacity();
+}
+
+vtkAppendableSelection::StrokeRecord vtkAppendableSelection::BeginStroke() const
+{
+	StrokeRecord ret;
+	ret.cellCount = m_applyRegion->GetNumberOfIds();
+	ret.centerCount = static_cast<vtkIdType>(m_selectedCeneters.size());
+	ret.accPointCount = m_accConnectivity ? m_accumulated->GetNumberOfPoints() : 0;
+	ret.accCellCount = m_accConnectivity ? m_accumulated->GetPolys()->GetNumberOfCells() : 0;
+	ret.accConnectivitySize = m_accConnectivity ? m_accConnectivity->GetNumberOfValues() : 0;
+	return ret;
+}
+
+// record is the state from BeginStroke(), the counts are turned into the size of the stroke here
+void vtkAppendableSelection::PushStroke(StrokeRecord record)
+{
+	record.cellCount = m_applyRegion->GetNumberOfIds() - record.cellCount;
+	record.centerCount = static_cast<vtkIdType>(m_selectedCeneters.size()) - record.centerCount;
+	if(record.cellCount == 0 && record.centerCount == 0)
+		return;
+	for(const auto& iter : m_redoStack)
+		m_historySize -= StrokeRecordSize(iter);
+	m_redoStack.clear();
+	m_historySize += StrokeRecordSize(record);
+	m_undoStack.push_back(std::move(record));
+	TrimHistory();
+}
+
+// the strokes are stacked, so undoing the last one only cuts the tails it appended to
+// m_applyRegion, m_selectedCeneters and output(1), and costs time proportional to the stroke
+void vtkAppendableSelection::UndoStroke(vtkPolyData* polydata)
+{
+	StrokeRecord record = std::move(m_undoStack.back());
+	m_undoStack.pop_back();
+	m_historySize -= StrokeRecordSize(record);
+
+	const vtkIdType first = m_applyRegion->GetNumberOfIds() - record.cellCount;
+	std::vector<vtkIdType> cellIds(m_applyRegion->GetPointer(first), m_applyRegion->GetPointer(first) + record.cellCount);
+	vtkIdType nPoints(0);
+	vtkIdType* pts(nullptr);
+	for(const auto cellId : cellIds)
+	{
+		m_appliedCells.Reset(cellId);
+		polydata->GetCellPoints(cellId, nPoints, pts);
+		for(vtkIdType k = 0; k < nPoints; ++k)
+		{
+			if(m_accPointMask.IsMarked(pts[k]) && m_accPointMap[pts[k]] >= record.accPointCount)
+				m_accPointMask.Unmark(pts[k]);
+		}
+	}
+	m_applyRegion->SetNumberOfIds(first);
+	TruncateAccumulated(record.accPointCount, record.accCellCount, record.accConnectivitySize);
+
+	record.centers.assign(m_selectedCeneters.end() - record.centerCount, m_selectedCeneters.end());
+	m_selectedCeneters.resize(m_selectedCeneters.size() - record.centerCount);
+	std::sort(cellIds.begin(), cellIds.end());
+	record.encodedCells = EncodeSortedIds(cellIds);
+
+	m_historySize += StrokeRecordSize(record);
+	m_redoStack.push_back(std::move(record));
+	TrimHistory();
+}
+
+void vtkAppendableSelection::RedoStroke(vtkPolyData* polydata)
+{
+	StrokeRecord record = std::move(m_redoStack.back());
+	m_redoStack.pop_back();
+	m_historySize -= StrokeRecordSize(record);
+
+	const auto cellIds = DecodeSortedIds(record.encodedCells, record.cellCount);
+	record.encodedCells = std::vector<unsigned char>();
+	record.accPointCount = m_accConnectivity ? m_accumulated->GetNumberOfPoints() : 0;
+	record.accCellCount = m_accConnectivity ? m_accumulated->GetPolys()->GetNumberOfCells() : 0;
+	record.accConnectivitySize = m_accConnectivity ? m_accConnectivity->GetNumberOfValues() : 0;
+	for(const auto cellId : cellIds)
+	{
+		m_appliedCells.Set(cellId);
+		m_applyRegion->InsertNextId(cellId);
+	}
+	AppendAccumulatedCells(polydata, cellIds.data(), static_cast<vtkIdType>(cellIds.size()));
+	m_selectedCeneters.insert(m_selectedCeneters.end(), record.centers.cbegin(), record.centers.cend());
+	record.centers = std::vector<std::array<double, 3>>();
+
+	m_historySize += StrokeRecordSize(record);
+	m_undoStack.push_back(std::move(record));
+}
+
+// over budget the oldest undo strokes become permanent, then the deepest redo strokes are dropped
+void vtkAppendableSelection::TrimHistory()
+{
+	while(m_historySize > m_historyBudget && !m_undoStack.empty())
+	{
+		m_historySize -= StrokeRecordSize(m_undoStack.front());
+		m_undoStack.pop_front();
+	}
+	while(m_historySize > m_historyBudget && !m_redoStack.empty())
+	{
+		m_historySize -= StrokeRecordSize(m_redoStack.front());
+		m_redoStack.pop_front();
+	}
+}
+
+void vtkAppendableSelection::ResetHistory()
+{
+	m_undoStack.clear();
+	m_redoStack.clear();
+	m_historySize = 0;
+	m_historySteps.clear();
+	m_historyStepsAfter.clear();
+}
+
+// steps are replayed in call order and consumed, a step on an empty stack is ignored like it would have
+// been if Update() had run after each call
+void vtkAppendableSelection::ApplyHistorySteps(vtkPolyData* polydata, std::vector<signed char>& steps)
+{
+	for(const auto step : steps)
+	{
+		if(step < 0 && !m_undoStack.empty())
+			UndoStroke(polydata);
+		else if(step > 0 && !m_redoStack.empty())
+			RedoStroke(polydata);
+	}
+	steps.clear();
+}
+
+// a pending append is assumed to record a stroke, it does unless it selects nothing
+std::pair<std::size_t, std::size_t> vtkAppendableSelection::PendingStackDepths() const
+{
+	std::size_t undoDepth = m_undoStack.size();
+	std::size_t redoDepth = m_redoStack.size();
+	auto replay = [&undoDepth, &redoDepth](const std::vector<signed char>& steps)
+	{
+		for(const auto step : steps)
+		{
+			if(step < 0 && undoDepth > 0)
+			{
+				--undoDepth;
+				++redoDepth;
+			}
+			else if(step > 0 && redoDepth > 0)
+			{
+				--redoDepth;
+				++undoDepth;
+			}
+		}
+	};
+	replay(m_historySteps);
+	if(m_bSetSelection && m_bAppend)
+	{
+		++undoDepth;
+		redoDepth = 0;
+	}
+	replay(m_historyStepsAfter);
+	return {undoDepth, redoDepth};
+}
+
 int vtkAppendableSelection::ProcessRequest(vtkInformation* request, vtkInformationVector** inputVector, vtkInformationVector* outputVector)
 {
 	if (request->Has(vtkDemandDrivenPipeline::REQUEST_DATA()))
@@ -162,46 +1071,78 @@ int vtkAppendableSelection::ProcessRequest(vtkInformation* request, vtkInformati
 			m_bClearSelection = false;
 			m_selectedRegion->Initialize();
 			m_applyRegion->Initialize();
+			m_appliedCells.Clear();
+			ResetAccumulated();
+			ResetHistory();
 			resultA->Initialize();
 			resultB->Initialize();
 		}
-		else if(m_bSetSelection)
+		else if(m_bSetSelection || !m_historySteps.empty() || !m_historyStepsAfter.empty())
 		{
-			m_bSetSelection = false;
-			if(m_dRadius > 0.0)
+			// Undo() then AppendSelection() undoes the stroke before the new one, and the new stroke
+			// then clears the redo stack
+			ApplyHistorySteps(pdA, m_historySteps);
+			if(m_bSetSelection)
 			{
-				m_selectedRegion->Initialize();
-				GetCellIdsInRegion(pdA, m_pos3d, m_dRadius, m_selectedRegion);
-				if(m_bAppend)
+				m_bSetSelection = false;
+				if(pdA && HasValidRequest())
 				{
-					for(vtkIdType i = 0; i < m_selectedRegion->GetNumberOfIds(); ++i)
+					using Clock = std::chrono::steady_clock;
+					auto seconds = [](Clock::time_point from, Clock::time_point to) { return std::chrono::duration<double>(to - from).count(); };
+					m_timings = SelectionTimings();
+					m_selectedRegion->Initialize();
+					auto t0 = Clock::now();
+					if(m_shape == SHAPE_SPHERE || m_shape == SHAPE_GEODESIC)
+						UpdatePointIndex(pdA);
+					if(m_shape == SHAPE_GEODESIC)
+						UpdateCellAdjacency(pdA);
+					else if(m_shape != SHAPE_SPHERE)
+						UpdateCellBVH(pdA);
+					auto t1 = Clock::now();
+					m_timings.indexBuild = seconds(t0, t1);
+					if(m_shape == SHAPE_SPHERE)
+						GetCellIdsInRegion(pdA, m_centers, m_dRadius, m_bSweep, m_selectedRegion);
+					else if(m_shape == SHAPE_GEODESIC)
+						GetCellIdsGeodesic(pdA, m_selectedRegion);
+					else
+						GetCellIdsInShape(pdA, m_selectedRegion);
+					t0 = Clock::now();
+					m_timings.regionQuery = seconds(t1, t0);
+					if(m_bAppend)
 					{
-						m_applyRegion->InsertUniqueId(m_selectedRegion->GetId(i));
+						m_appliedCells.Resize(pdA->GetNumberOfCells());
+						auto stroke = BeginStroke();
+						const vtkIdType appliedCount = m_applyRegion->GetNumberOfIds();
+						for(vtkIdType i = 0; i < m_selectedRegion->GetNumberOfIds(); ++i)
+						{
+							const vtkIdType cellId = m_selectedRegion->GetId(i);
+							if(m_appliedCells.TestAndSet(cellId))
+								m_applyRegion->InsertNextId(cellId);
+						}
+						t1 = Clock::now();
+						m_timings.dedup = seconds(t0, t1);
+						t0 = t1;
+						const vtkIdType newCount = m_applyRegion->GetNumberOfIds() - appliedCount;
+						if(newCount > 0)
+							AppendAccumulatedCells(pdA, m_applyRegion->GetPointer(appliedCount), newCount);
+						if(m_selectedRegion->GetNumberOfIds() > 0)
+							m_selectedCeneters.insert(m_selectedCeneters.end(), m_centers.cbegin(), m_centers.cend());
+						PushStroke(std::move(stroke));
 					}
-					if(m_selectedRegion->GetNumberOfIds() > 0)
-						m_selectedCeneters.push_back(m_pos3d);
-				}
-
-				{
-					auto ids = vtkSmartPointer<vtkIdTypeArray>::New();
-					for(vtkIdType i = 0; i < m_selectedRegion->GetNumberOfIds(); ++i)
-						ids->InsertNextValue(m_selectedRegion->GetId(i));
-					auto selectedPolyData = GetCellsPolyData(pdA, ids);
-					resultA->ShallowCopy(selectedPolyData);
-				}
-				{
-					auto ids = vtkSmartPointer<vtkIdTypeArray>::New();
-					for(vtkIdType i = 0; i < m_applyRegion->GetNumberOfIds(); ++i)
-						ids->InsertNextValue(m_applyRegion->GetId(i));
-					auto applyPolyData = GetCellsPolyData(pdA, ids);
-					resultB->ShallowCopy(applyPolyData);
+					resultA->ShallowCopy(extractCellsPolyData(pdA, m_selectedRegion->GetPointer(0), m_selectedRegion->GetNumberOfIds()));
+					m_timings.extraction = seconds(t0, Clock::now());
 				}
 			}
+			ApplyHistorySteps(pdA, m_historyStepsAfter);
+			resultB->ShallowCopy(m_accumulated);
 		}
 		else //other case, maybe inputpoly data modified
 		{
 			m_selectedRegion->Initialize();
 			m_applyRegion->Initialize();
+			m_appliedCells.Clear();
+			ResetAccumulated();
+			ResetHistory();
 			resultA->Initialize();
 			resultB->Initialize();
 		}
@@ -2,35 +2,168 @@
 #include <vtkPolyDataAlgorithm.h>
 #include <array>
 #include <vector>
+#include <deque>
+#include <utility>
+#include "CPointGridIndex.h"
+#include "CEpochMask.h"
+#include "CBitSet.h"
+#include "CCellBVH.h"
+#include "CCellAdjacency.h"
 
 class vtkIdList;
+class vtkIdTypeArray;
+class vtkPolyData;
+class vtkPlanes;
 
 // *****
 // This algorithm calculate all cell which one vertex is inner the given sphere.
 // The method NoAppendSelection() and AppendSelection() receive a sphere by point and radius.
+// The method NoAppendStroke() and AppendStroke() receive a whole brush stroke, the spheres at each center
+// (or the capsules swept between consecutive centers) are resolved together in one update.
 // There are two output for this algorithm.
 // Output(0) is cell polydata the last time call NoAppendSelection() or AppendSelection().
 // Output(1) is cell polydata the accumulated area call AppendSelection().
+// Output(1) is built incrementally, each AppendSelection() only extracts its new cells.
+// Each append is recorded as a stroke, Undo() and Redo() remove or re-apply the last strokes.
+// Frustum, oriented box and lasso selections also select the cells whose vertices are all inside the
+// shape, they are resolved through a cell BVH and share the outputs, append and undo of the sphere mode.
+// Geodesic selections grow from the picked cell across shared edges (cached edge adjacency), so the
+// other side of a thin wall is not selected unless it is connected within the radius.
 // *****
 class vtkAppendableSelection : public vtkPolyDataAlgorithm
 {
 private:
-	std::array<double, 3> m_pos3d;
+	enum SelectionShape
+	{
+		SHAPE_SPHERE,
+		SHAPE_CONVEX,
+		SHAPE_LASSO,
+		SHAPE_GEODESIC
+	};
+	int m_shape;
+	std::vector<std::array<double, 3>> m_centers;
+	std::vector<std::array<double, 4>> m_planes;//inside at a*x+b*y+c*z+d >= 0
+	std::vector<std::array<double, 2>> m_lasso;
+	std::array<double, 16> m_worldToView;
 	double m_dRadius;
 	bool m_bAppend;
+	bool m_bSweep;
+	bool m_bGeodesicDistance;
+	vtkIdType m_pickedCell;
+	bool m_bParallelSelection;
 	bool m_bSetSelection;
 	bool m_bClearSelection;
 	vtkSmartPointer<vtkIdList> m_selectedRegion;
 	vtkSmartPointer<vtkIdList> m_applyRegion;
 	std::vector<std::array<double, 3>> m_selectedCeneters;
-	void SelectionSetting(std::array<double, 3> pos3d, double radius, bool append);
+	CPointGridIndex m_pointIndex;
+	vtkMTimeType m_indexMTime;
+	bool m_bIndexAdopted;//m_pointIndex came from AdoptPointIndex() and was not used yet
+	CCellBVH m_cellBVH;
+	vtkMTimeType m_bvhMTime;
+	CCellAdjacency m_cellAdjacency;
+	vtkMTimeType m_adjacencyMTime;
+	CEpochMask m_cellMask;//cells reached by the geodesic traversal
+	std::vector<double> m_cellDistance;//distance of the reached cells, valid where m_cellMask is marked
+	std::vector<std::pair<double, vtkIdType>> m_geodesicQueue;
+	std::vector<vtkIdType> m_pointsInRadius;
+	std::vector<vtkIdType> m_queryResult;
+	CEpochMask m_pointMask;
+	std::vector<std::vector<vtkIdType>> m_blockCells;
+	CBitSet m_appliedCells;//cells already in m_applyRegion
+	vtkSmartPointer<vtkPolyData> m_accumulated;//content of output(1), grows with each AppendSelection()
+	vtkSmartPointer<vtkIdTypeArray> m_accConnectivity;
+	CEpochMask m_accPointMask;//input points already copied into m_accumulated
+	std::vector<vtkIdType> m_accPointMap;//input point id -> m_accumulated point id
+
+	struct StrokeRecord
+	{
+		vtkIdType cellCount;//ids the stroke appended at the end of m_applyRegion
+		vtkIdType centerCount;//centers the stroke appended at the end of m_selectedCeneters
+		vtkIdType accPointCount;//size of m_accumulated before the stroke
+		vtkIdType accCellCount;
+		vtkIdType accConnectivitySize;
+		std::vector<std::array<double, 3>> centers;//only kept while the stroke is on the redo stack
+		std::vector<unsigned char> encodedCells;//sorted cell ids as varint deltas, only kept on the redo stack
+	};
+	std::deque<StrokeRecord> m_undoStack;
+	std::deque<StrokeRecord> m_redoStack;
+	std::size_t m_historyBudget;
+	std::size_t m_historySize;
+	std::vector<signed char> m_historySteps;//pending Undo() (-1) and Redo() (+1) in call order, requested before the pending selection
+	std::vector<signed char> m_historyStepsAfter;//the same, requested after the pending selection
+	void SelectionSetting(const std::vector<std::array<double, 3>>& centers, double radius, bool append, bool sweep);
+	void ShapeSetting(int shape, bool append);
+	void UpdatePointIndex(vtkPolyData* polydata);
+	void UpdateCellBVH(vtkPolyData* polydata);
+	void UpdateCellAdjacency(vtkPolyData* polydata);
+	bool HasValidRequest() const;
+	void GetCellIdsInShape(vtkPolyData* polydata, vtkIdList* outIds);
+	void GetCellIdsGeodesic(vtkPolyData* polydata, vtkIdList* outIds);
+	void ResetAccumulated();
+	void AppendAccumulatedCells(vtkPolyData* polydata, const vtkIdType* cellIds, vtkIdType count);
+	void TruncateAccumulated(vtkIdType numPoints, vtkIdType numCells, vtkIdType connectivitySize);
+	static std::size_t StrokeRecordSize(const StrokeRecord& record);
+	StrokeRecord BeginStroke() const;
+	void PushStroke(StrokeRecord record);
+	void UndoStroke(vtkPolyData* polydata);
+	void RedoStroke(vtkPolyData* polydata);
+	void ApplyHistorySteps(vtkPolyData* polydata, std::vector<signed char>& steps);
+	// depths of the stacks once the pending steps and selection are applied
+	std::pair<std::size_t, std::size_t> PendingStackDepths() const;
+	void TrimHistory();
+	void ResetHistory();
+	bool GetCellIdsInRegion(vtkPolyData* polydata, const std::vector<std::array<double, 3>>& centers, double radius, bool sweep, vtkIdList* outIds);
+	void GetCellIdsOfMarkedPoints(vtkPolyData* polydata, vtkIdList* outIds);
+
+public:
+	// seconds spent by the phases of the last selection request, indexBuild is 0 when the cached index was reused
+	struct SelectionTimings
+	{
+		double indexBuild = 0.0;
+		double regionQuery = 0.0;
+		double dedup = 0.0;
+		double extraction = 0.0;
+	};
+
+private:
+	SelectionTimings m_timings;
 
 public:
 	void NoAppendSelection(std::array<double, 3> pos3d, double radius);
 	void AppendSelection(std::array<double, 3> pos3d, double radius);
+	void NoAppendStroke(const std::vector<std::array<double, 3>>& centers, double radius, bool sweep = false);
+	void AppendStroke(const std::vector<std::array<double, 3>>& centers, double radius, bool sweep = false);
+	void NoAppendFrustumSelection(vtkPlanes* frustum);
+	void AppendFrustumSelection(vtkPlanes* frustum);
+	void NoAppendBoxSelection(std::array<double, 3> center, std::array<std::array<double, 3>, 3> axes, std::array<double, 3> halfLengths);
+	void AppendBoxSelection(std::array<double, 3> center, std::array<std::array<double, 3>, 3> axes, std::array<double, 3> halfLengths);
+	void NoAppendLassoSelection(const std::vector<std::array<double, 2>>& polygon, const std::array<double, 16>& worldToView);
+	void AppendLassoSelection(const std::vector<std::array<double, 2>>& polygon, const std::array<double, 16>& worldToView);
+	// geodesicDistance false keeps the sphere test (all vertices within radius) but only for the cells connected to the pick,
+	// pickedCell is the cell under the cursor (vtkCellPicker), -1 starts from the cells of the point nearest to pos3d
+	void NoAppendGeodesicSelection(std::array<double, 3> pos3d, double radius, bool geodesicDistance = true, vtkIdType pickedCell = -1);
+	void AppendGeodesicSelection(std::array<double, 3> pos3d, double radius, bool geodesicDistance = true, vtkIdType pickedCell = -1);
 	void ClearSelection();
+	void Undo();
+	void Redo();
+	bool CanUndo() const;
+	bool CanRedo() const;
+	void SetHistoryMemoryBudget(std::size_t bytes);//oldest strokes become permanent once the history exceeds it
+	std::size_t GetHistoryMemorySize() const;
 	vtkSmartPointer<vtkIdList> GetAppliedRegionIds();
 	std::vector<std::array<double, 3>> SelectedCenters() const;
+	void SetParallelSelection(bool parallel);//use vtkSMPTools for large regions, on by default
+	bool GetParallelSelection() const;
+	SelectionTimings GetLastTimings() const;
+	double GetIndexBuildTime() const;//seconds spent in the last build of the point index
+	std::size_t GetIndexMemorySize() const;//bytes held by the point index
+	// prebuilt index (CMeshCache), used instead of a build by the next request if it indexes the points of the input
+	void AdoptPointIndex(CPointGridIndex index);
+	double GetBVHBuildTime() const;//seconds spent in the last build of the cell BVH
+	std::size_t GetBVHMemorySize() const;//bytes held by the cell BVH
+	double GetAdjacencyBuildTime() const;//seconds spent in the last build of the cell adjacency
+	std::size_t GetAdjacencyMemorySize() const;//bytes held by the cell adjacency
 
 public:
     vtkTypeMacro(vtkAppendableSelection, vtkPolyDataAlgorithm);
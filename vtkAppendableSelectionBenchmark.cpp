@@ -0,0 +1,300 @@
+// Headless latency benchmark of vtkAppendableSelection, no Qt needed.
+// It generates synthetic meshes, drives NoAppendSelection / AppendSelection / ClearSelection through Update()
+// and writes p50/p95/p99 of every phase as JSON.
+//
+// usage: vtkAppendableSelectionBenchmark [--mesh sphere|grid] [--sizes 10000,100000,1000000]
+//        [--repeat 50] [--radius 0.02] [--serial] [--output result.json]
+#include "vtkAppendableSelection.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+#include <vtkPoints.h>
+#include <vtkCellArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkMath.h>
+#include <vtkPlaneSource.h>
+#include <vtkTriangleFilter.h>
+
+namespace
+{
+struct BenchmarkOptions
+{
+	std::string mesh = "sphere";
+	std::vector<long long> sizes = {10000, 100000, 1000000};
+	int repeat = 50;
+	double radiusFraction = 0.02;//of the bounding box diagonal
+	bool parallel = true;
+	std::string output;
+};
+
+// per phase samples in seconds, keyed by phase name
+using PhaseSamples = std::map<std::string, std::vector<double>>;
+
+struct OperationResult
+{
+	std::string operation;
+	PhaseSamples phases;
+};
+
+bool ParseOptions(int argc, char* argv[], BenchmarkOptions& options)
+{
+	for(int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+		if(arg == "--mesh" && hasValue)
+			options.mesh = argv[++i];
+		else if(arg == "--sizes" && hasValue)
+		{
+			options.sizes.clear();
+			std::stringstream ss(argv[++i]);
+			std::string item;
+			while(std::getline(ss, item, ','))
+				options.sizes.push_back(std::stoll(item));
+		}
+		else if(arg == "--repeat" && hasValue)
+			options.repeat = std::max(1, std::stoi(argv[++i]));
+		else if(arg == "--radius" && hasValue)
+			options.radiusFraction = std::stod(argv[++i]);
+		else if(arg == "--serial")
+			options.parallel = false;
+		else if(arg == "--output" && hasValue)
+			options.output = argv[++i];
+		else
+		{
+			std::cerr << "unknown argument " << arg << std::endl;
+			return false;
+		}
+	}
+	return options.mesh == "sphere" || options.mesh == "grid";
+}
+
+// UV sphere of radius 0.5 like vtkSphereSource, which clamps its resolutions to 1024 (about 2M triangles)
+vtkSmartPointer<vtkPolyData> CreateSphere(long long triangles)
+{
+	const vtkIdType thetaResolution = std::max<vtkIdType>(3, static_cast<vtkIdType>(std::ceil(std::sqrt(triangles / 2.0))));
+	const vtkIdType phiResolution = std::max<vtkIdType>(3, static_cast<vtkIdType>(std::ceil(triangles / (2.0 * thetaResolution))) + 1);
+	const vtkIdType rings = phiResolution - 1;
+	auto ringPoint = [thetaResolution](vtkIdType ring, vtkIdType j) { return 2 + ring * thetaResolution + j % thetaResolution; };
+
+	auto points = vtkSmartPointer<vtkPoints>::New();
+	points->SetDataTypeToFloat();
+	points->SetNumberOfPoints(2 + rings * thetaResolution);
+	points->SetPoint(0, 0.0, 0.0, 0.5);
+	points->SetPoint(1, 0.0, 0.0, -0.5);
+	for(vtkIdType ring = 0; ring < rings; ++ring)
+	{
+		const double phi = vtkMath::Pi() * (ring + 1) / phiResolution;
+		for(vtkIdType j = 0; j < thetaResolution; ++j)
+		{
+			const double theta = 2.0 * vtkMath::Pi() * j / thetaResolution;
+			points->SetPoint(ringPoint(ring, j), 0.5 * std::sin(phi) * std::cos(theta), 0.5 * std::sin(phi) * std::sin(theta), 0.5 * std::cos(phi));
+		}
+	}
+
+	// a fan at each pole and two triangles per quad between the rings, all facing outwards
+	const vtkIdType numTriangles = 2 * thetaResolution * rings;
+	auto connectivity = vtkSmartPointer<vtkIdTypeArray>::New();
+	connectivity->SetNumberOfValues(4 * numTriangles);
+	vtkIdType* cell = connectivity->GetPointer(0);
+	auto addTriangle = [&cell](vtkIdType a, vtkIdType b, vtkIdType c)
+	{
+		cell[0] = 3;
+		cell[1] = a;
+		cell[2] = b;
+		cell[3] = c;
+		cell += 4;
+	};
+	for(vtkIdType j = 0; j < thetaResolution; ++j)
+		addTriangle(0, ringPoint(0, j), ringPoint(0, j + 1));
+	for(vtkIdType ring = 0; ring + 1 < rings; ++ring)
+	{
+		for(vtkIdType j = 0; j < thetaResolution; ++j)
+		{
+			addTriangle(ringPoint(ring, j), ringPoint(ring + 1, j), ringPoint(ring + 1, j + 1));
+			addTriangle(ringPoint(ring, j), ringPoint(ring + 1, j + 1), ringPoint(ring, j + 1));
+		}
+	}
+	for(vtkIdType j = 0; j < thetaResolution; ++j)
+		addTriangle(1, ringPoint(rings - 1, j + 1), ringPoint(rings - 1, j));
+	auto polys = vtkSmartPointer<vtkCellArray>::New();
+	polys->SetCells(numTriangles, connectivity);
+
+	auto ret = vtkSmartPointer<vtkPolyData>::New();
+	ret->SetPoints(points);
+	ret->SetPolys(polys);
+	return ret;
+}
+
+// a mesh with at least the requested number of triangles
+vtkSmartPointer<vtkPolyData> CreateMesh(const std::string& mesh, long long triangles)
+{
+	if(mesh == "sphere")
+		return CreateSphere(triangles);
+	auto ret = vtkSmartPointer<vtkPolyData>::New();
+	const int resolution = std::max(3, static_cast<int>(std::ceil(std::sqrt(triangles / 2.0))));
+	auto plane = vtkSmartPointer<vtkPlaneSource>::New();
+	plane->SetResolution(resolution, resolution);
+	auto triangle = vtkSmartPointer<vtkTriangleFilter>::New();
+	triangle->SetInputConnection(plane->GetOutputPort());
+	triangle->Update();
+	ret->ShallowCopy(triangle->GetOutput());
+	return ret;
+}
+
+double Percentile(std::vector<double> samples, double p)
+{
+	if(samples.empty())
+		return 0.0;
+	std::sort(samples.begin(), samples.end());
+	const std::size_t rank = static_cast<std::size_t>(std::ceil(p / 100.0 * samples.size()));
+	return samples[std::min(samples.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+void AddSample(PhaseSamples& phases, double update, const vtkAppendableSelection::SelectionTimings& timings)
+{
+	phases["update"].push_back(update);
+	phases["index_build"].push_back(timings.indexBuild);
+	phases["region_query"].push_back(timings.regionQuery);
+	phases["id_dedup"].push_back(timings.dedup);
+	phases["extraction"].push_back(timings.extraction);
+}
+
+template<class F>
+double TimeUpdate(vtkAppendableSelection* selection, F&& request)
+{
+	request();
+	const auto start = std::chrono::steady_clock::now();
+	selection->Update();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void WritePhases(std::ostream& os, const PhaseSamples& phases)
+{
+	os << "{";
+	bool first(true);
+	for(const auto& iter : phases)
+	{
+		os << (first ? "" : ", ") << "\"" << iter.first << "\": {"
+			<< "\"p50\": " << Percentile(iter.second, 50.0) << ", "
+			<< "\"p95\": " << Percentile(iter.second, 95.0) << ", "
+			<< "\"p99\": " << Percentile(iter.second, 99.0) << "}";
+		first = false;
+	}
+	os << "}";
+}
+}
+
+int main(int argc, char* argv[])
+{
+	BenchmarkOptions options;
+	if(!ParseOptions(argc, argv, options))
+	{
+		std::cerr << "usage: vtkAppendableSelectionBenchmark [--mesh sphere|grid] [--sizes n1,n2,...] [--repeat n] [--radius fraction] [--serial] [--output file]" << std::endl;
+		return 1;
+	}
+
+	std::ostringstream json;
+	json << std::setprecision(9);
+	json << "{\n  \"benchmark\": \"vtkAppendableSelection\",\n  \"unit\": \"seconds\",\n  \"mesh\": \"" << options.mesh << "\",\n"
+		<< "  \"parallel\": " << (options.parallel ? "true" : "false") << ",\n  \"results\": [";
+
+	std::mt19937 random(20240101);
+	for(std::size_t s = 0; s < options.sizes.size(); ++s)
+	{
+		auto mesh = CreateMesh(options.mesh, options.sizes[s]);
+		if(mesh->GetNumberOfCells() < options.sizes[s])
+		{
+			std::cerr << "the " << options.mesh << " mesh has " << mesh->GetNumberOfCells() << " triangles, " << options.sizes[s] << " requested" << std::endl;
+			return 1;
+		}
+		const double radius = options.radiusFraction * mesh->GetLength();
+		std::uniform_int_distribution<vtkIdType> pickPoint(0, mesh->GetNumberOfPoints() - 1);
+		auto randomCenter = [&]()
+		{
+			std::array<double, 3> ret;
+			mesh->GetPoint(pickPoint(random), ret.data());
+			return ret;
+		};
+
+		auto selection = vtkSmartPointer<vtkAppendableSelection>::New();
+		selection->SetInputData(mesh);
+		selection->SetParallelSelection(options.parallel);
+
+		// the first request builds the index, it is reported on its own
+		const double coldUpdate = TimeUpdate(selection, [&]() { selection->NoAppendSelection(randomCenter(), radius); });
+		const auto coldTimings = selection->GetLastTimings();
+
+		std::vector<OperationResult> results(3);
+		results[0].operation = "NoAppendSelection";
+		results[1].operation = "AppendSelection";
+		results[2].operation = "ClearSelection";
+		for(int i = 0; i < options.repeat; ++i)
+		{
+			const double update = TimeUpdate(selection, [&]() { selection->NoAppendSelection(randomCenter(), radius); });
+			AddSample(results[0].phases, update, selection->GetLastTimings());
+		}
+
+		// painting sessions of a few strokes, each closed by ClearSelection()
+		const int strokesPerSession = 5;
+		for(int i = 0; i < options.repeat; ++i)
+		{
+			const double update = TimeUpdate(selection, [&]() { selection->AppendSelection(randomCenter(), radius); });
+			AddSample(results[1].phases, update, selection->GetLastTimings());
+			if((i + 1) % strokesPerSession == 0 || i + 1 == options.repeat)
+			{
+				const double clearUpdate = TimeUpdate(selection, [&]() { selection->ClearSelection(); });
+				results[2].phases["update"].push_back(clearUpdate);
+			}
+		}
+
+		json << (s == 0 ? "\n" : ",\n") << "    {\"requested_triangles\": " << options.sizes[s]
+			<< ", \"triangles\": " << mesh->GetNumberOfCells()
+			<< ", \"points\": " << mesh->GetNumberOfPoints()
+			<< ", \"radius\": " << radius
+			<< ", \"index_build\": " << selection->GetIndexBuildTime()
+			<< ", \"index_memory_bytes\": " << selection->GetIndexMemorySize()
+			<< ", \"cold_update\": " << coldUpdate
+			<< ", \"cold_region_query\": " << coldTimings.regionQuery
+			<< ",\n     \"operations\": [";
+		for(std::size_t r = 0; r < results.size(); ++r)
+		{
+			json << (r == 0 ? "\n" : ",\n") << "       {\"operation\": \"" << results[r].operation
+				<< "\", \"samples\": " << results[r].phases["update"].size() << ", \"phases\": ";
+			WritePhases(json, results[r].phases);
+			json << "}";
+		}
+		json << "\n     ]}";
+		std::cerr << "done " << mesh->GetNumberOfCells() << " triangles" << std::endl;
+	}
+	json << "\n  ]\n}\n";
+
+	if(options.output.empty())
+	{
+		std::cout << json.str();
+	}
+	else
+	{
+		std::ofstream file(options.output);
+		if(!file)
+		{
+			std::cerr << "cannot write " << options.output << std::endl;
+			return 1;
+		}
+		file << json.str();
+	}
+	return 0;
+}
@@ -1,29 +1,36 @@
 #include "vtkHelperFunctions.h"
+#include "CMeshSlicer.h"
+#include "CMeshWelder.h"
+#include "CMeshTopology.h"
+#include "CMeshNormals.h"
+#include "CMeshFile.h"
+#include "CThicknessAnalyzer.h"
+#include "CTriangleNormalKernel.h"
 #include <iterator>
 #include <vtkPolyData.h>
 #include <vtkCleanPolyData.h>
 #include <vtkTriangleFilter.h>
-#include <vtkFeatureEdges.h>
 #include <vtkPolyDataNormals.h>
-#include <vtkUnstructuredGrid.h>
 #include <vtkCellArray.h>
-#include <vtkDataSetSurfaceFilter.h>
-#include <vtkTriangle.h>
 #include <vtkPlane.h>
-#include <vtkCutter.h>
 #include <vtkPoints.h>
 #include <vtkPolyLine.h>
 #include <vtkSphereSource.h>
 #include <vtkGlyph3D.h>
 #include <vtkFloatArray.h>
 #include <vtkPointData.h>
+#include <vtkCellData.h>
+#include <vtkIdTypeArray.h>
 #include <vtkLineSource.h>
 #include <vtkTubeFilter.h>
+#include <vtkSMPTools.h>
 
 #include <array>
-#include <map>
 #include <set>
 #include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
 
 void printPolydataInformation(std::ostream& os, vtkSmartPointer<vtkPolyData> polydata)
 {
@@ -35,103 +42,344 @@ void printPolydataInformation(std::ostream& os, vtkSmartPointer<vtkPolyData> pol
 
 void printPolydataDetail(std::ostream& os, vtkSmartPointer<vtkPolyData> polydata)
 {
+	// formatted into a large buffer written in blocks, std::endl would flush on every line
+	std::string buffer;
+	buffer.reserve(1 << 20);
+	auto flush = [&os, &buffer](std::size_t threshold)
+	{
+		if(buffer.size() >= threshold)
+		{
+			os.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+			buffer.clear();
+		}
+	};
+	char text[64];
 	auto numPoint = polydata->GetNumberOfPoints();
-	os << "There are " << numPoint << " points" << std::endl;
-	for(int i =0; i < numPoint; ++i)
+	buffer += "There are " + std::to_string(numPoint) + " points\n";
+	double x[3];
+	for(vtkIdType i = 0; i < numPoint; ++i)
 	{
-		os << polydata->GetPoint(i)[0] << ", ";
-		os << polydata->GetPoint(i)[1] << ", ";
-		os << polydata->GetPoint(i)[2] << ", " << std::endl;
+		polydata->GetPoint(i, x);
+		buffer.append(text, std::snprintf(text, sizeof(text), "%g, %g, %g, \n", x[0], x[1], x[2]));
+		flush(1 << 20);
 	}
 	auto numCell = polydata->GetNumberOfCells();
-	os << "There are " << numCell << " cells" << std::endl;
-	for(int i = 0; i < numCell; ++i)
+	buffer += "There are " + std::to_string(numCell) + " cells\n";
+	for(vtkIdType i = 0; i < numCell; ++i)
 	{
-		auto ids = polydata->GetCell(i)->GetPointIds();
-		for (int j = 0; j < polydata->GetCell(i)->GetNumberOfPoints(); ++j)
-		{
-			os << ids->GetId(j) << ", ";
-		}
-		os << std::endl;
+		vtkIdType numIds;
+		vtkIdType* ids;
+		polydata->GetCellPoints(i, numIds, ids);
+		for(vtkIdType j = 0; j < numIds; ++j)
+			buffer.append(text, std::snprintf(text, sizeof(text), "%lld, ", static_cast<long long>(ids[j])));
+		buffer += '\n';
+		flush(1 << 20);
 	}
+	flush(0);
+	os.flush();
 }
 
+// triangle meshes go through CMeshWelder (exact merge, degenerate triangles dropped),
+// anything else through vtkCleanPolyData and vtkTriangleFilter
 void cleanPolydata(vtkSmartPointer<vtkPolyData> polydata)
 {
 	if(polydata)
 	{
+		if(CMeshWelder::IsTriangleMesh(polydata))
+		{
+			CMeshWelder welder;
+			polydata->ShallowCopy(welder.Weld(polydata));
+			return;
+		}
+
 		auto triangle = vtkSmartPointer<vtkTriangleFilter>::New();
 		auto cleaner = vtkSmartPointer<vtkCleanPolyData>::New();
 		if(triangle && cleaner)
 		{
 			cleaner->SetInputData(polydata);
-			cleaner->Update();
 			cleaner->PointMergingOn();
 			cleaner->ConvertPolysToLinesOn();
 			cleaner->ConvertStripsToPolysOn();
 			cleaner->ToleranceIsAbsoluteOff();
-			triangle->SetInputData(cleaner->GetOutput());
+			triangle->SetInputConnection(cleaner->GetOutputPort());
 			triangle->Update();
 			polydata->ShallowCopy(triangle->GetOutput());
 		}
 	}
 }
 
+namespace
+{
+// every incoming file is validated, keep the last report so that asking again about the same mesh is free
+CMeshTopology& cachedTopology()
+{
+	static thread_local CMeshTopology topology;
+	return topology;
+}
+}
+
 bool isManifold(vtkSmartPointer<vtkPolyData> polydata)
 {
-	if(polydata)
+	// same criterion as vtkFeatureEdges with only the non-manifold edges: no edge is used by more than two polygons
+	return polydata && cachedTopology().Analyze(polydata).nonManifoldEdges.empty();
+}
+
+CMeshTopology::Report meshTopology(vtkSmartPointer<vtkPolyData> polydata)
+{
+	return cachedTopology().Analyze(polydata);
+}
+
+vtkSmartPointer<vtkPolyData> rebuildPolyData(vtkSmartPointer<vtkPolyData> polydata, bool parallel)
+{
+	vtkSmartPointer<vtkPolyData> ret = vtkSmartPointer<vtkPolyData>::New();
+	if(!polydata || !polydata->GetPoints() || polydata->GetNumberOfPolys() + polydata->GetNumberOfStrips() == 0)
+		return ret;
+
+	// one walk over the sizes tells whether the polys are all triangles and whether some need triangulating,
+	// GetMaxCellSize() would be a walk of its own
+	vtkCellArray* polys = polydata->GetPolys();
+	const vtkIdType* conn = polys->GetPointer();
+	vtkIdType numPolys = polys->GetNumberOfCells();
+	vtkIdType numTriangles(0);
+	bool largerPolygons = false;
+	for(vtkIdType c = 0, pos = 0; c < numPolys && !largerPolygons; ++c, pos += conn[pos] + 1)
 	{
-		auto feature = vtkSmartPointer<vtkFeatureEdges>::New();
-		feature->SetInputData(polydata);
-		feature->BoundaryEdgesOff();
-		feature->FeatureEdgesOff();
-		feature->ManifoldEdgesOff();
-		feature->NonManifoldEdgesOn();
-		feature->Update();
-		const auto numPoint = feature->GetOutput()->GetNumberOfPoints();
-		return numPoint == 0;
+		numTriangles += conn[pos] == 3;
+		largerPolygons = conn[pos] > 3;
 	}
-	else
+
+	// strips and polygons of more than three points still go through vtkTriangleFilter, which handles concave polygons
+	vtkSmartPointer<vtkPolyData> source = polydata;
+	if(polydata->GetNumberOfStrips() > 0 || largerPolygons)
 	{
-		return false;
+		auto tri = vtkSmartPointer<vtkTriangleFilter>::New();
+		tri->SetInputData(polydata);
+		tri->PassVertsOff();
+		tri->PassLinesOff();
+		tri->Update();
+		source = tri->GetOutput();
+		polys = source->GetPolys();
+		conn = polys->GetPointer();
+		numPolys = polys->GetNumberOfCells();
+		numTriangles = numPolys;//the filter outputs triangles only
+	}
+	auto run = [parallel](vtkIdType n, auto&& functor)
+	{
+		if(parallel)
+			vtkSMPTools::For(0, n, functor);
+		else
+			functor(0, n);
+	};
+
+	// position of every triangle in the legacy (3, a, b, c) connectivity, only walked for again when some polys
+	// have less than three points
+	const bool allTriangles = numTriangles == numPolys;
+	std::vector<vtkIdType> trianglePos;
+	if(!allTriangles)
+	{
+		trianglePos.reserve(numTriangles);
+		for(vtkIdType c = 0, pos = 0; c < numPolys; ++c, pos += conn[pos] + 1)
+		{
+			if(conn[pos] == 3)
+				trianglePos.push_back(pos);
+		}
 	}
+	if(numTriangles == 0)
+		return ret;
+	auto triangle = [conn, allTriangles, &trianglePos](vtkIdType t) { return conn + (allTriangles ? 4 * t : trianglePos[t]) + 1; };
+
+	// keep the used points only, in id order
+	vtkPoints* points = source->GetPoints();
+	const vtkIdType numPoints = points->GetNumberOfPoints();
+	std::vector<vtkIdType> newId(numPoints, -1);
+	for(vtkIdType t = 0; t < numTriangles; ++t)
+	{
+		const vtkIdType* ids = triangle(t);
+		newId[ids[0]] = newId[ids[1]] = newId[ids[2]] = 0;
+	}
+	vtkIdType numUsed(0);
+	for(auto& id : newId)
+	{
+		if(id == 0)
+			id = numUsed++;
+	}
+
+	auto outPoints = vtkSmartPointer<vtkPoints>::New();
+	outPoints->SetDataType(points->GetDataType());
+	outPoints->SetNumberOfPoints(numUsed);
+	run(numPoints, [points, &outPoints, &newId](vtkIdType begin, vtkIdType end)
+	{
+		double x[3];
+		for(vtkIdType i = begin; i < end; ++i)
+		{
+			if(newId[i] < 0)
+				continue;
+			points->GetPoint(i, x);
+			outPoints->SetPoint(newId[i], x);
+		}
+	});
+
+	auto connectivity = vtkSmartPointer<vtkIdTypeArray>::New();
+	connectivity->SetNumberOfValues(4 * numTriangles);
+	vtkIdType* outConn = connectivity->GetPointer(0);
+	run(numTriangles, [outConn, &newId, &triangle](vtkIdType begin, vtkIdType end)
+	{
+		for(vtkIdType t = begin; t < end; ++t)
+		{
+			const vtkIdType* ids = triangle(t);
+			vtkIdType* cell = outConn + 4 * t;
+			cell[0] = 3;
+			cell[1] = newId[ids[0]];
+			cell[2] = newId[ids[1]];
+			cell[3] = newId[ids[2]];
+		}
+	});
+	auto cells = vtkSmartPointer<vtkCellArray>::New();
+	cells->SetCells(numTriangles, connectivity);
+
+	ret->SetPoints(outPoints);
+	ret->SetPolys(cells);
+	return ret;
 }
 
-vtkSmartPointer<vtkPolyData> rebuildPolyData(vtkSmartPointer<vtkPolyData> polydata)
+vtkSmartPointer<vtkPolyData> extractCellsPolyData(vtkSmartPointer<vtkPolyData> polydata, vtkSmartPointer<vtkIdList> cellIds, bool compactPoints)
 {
-	vtkSmartPointer<vtkPolyData> ret = vtkSmartPointer<vtkPolyData>::New();
-
-	auto tri = vtkSmartPointer<vtkTriangleFilter>::New();
-	tri->SetInputData(polydata);
-	tri->Update();
+	if(!cellIds)
+		return vtkSmartPointer<vtkPolyData>::New();
+	return extractCellsPolyData(polydata.GetPointer(), cellIds->GetPointer(0), cellIds->GetNumberOfIds(), compactPoints);
+}
 
-	auto points = tri->GetOutput()->GetPoints();
-	auto num_cell = tri->GetOutput()->GetNumberOfCells();
-	auto cells = vtkSmartPointer<vtkCellArray>::New();
+// Build the subset polydata straight from the connectivity of the given cells.
+// By default the output shares the vtkPoints and point attributes of the input,
+// compactPoints copies only the referenced points and renumbers them.
+vtkSmartPointer<vtkPolyData> extractCellsPolyData(vtkPolyData* polydata, const vtkIdType* cellIds, vtkIdType count, bool compactPoints)
+{
+	auto ret = vtkSmartPointer<vtkPolyData>::New();
+	if(!polydata || !polydata->GetPoints() || !cellIds || count <= 0)
+		return ret;
 
-	if(points && cells && num_cell > 0)
+	// vtkPolyData numbers its cells verts, lines, polys, strips, so the cells are grouped the same way
+	enum { VERTS, LINES, POLYS, STRIPS, GROUP_COUNT };
+	auto groupOf = [](int cellType)
 	{
-		for(vtkIdType i = 0; i < num_cell; ++i)
+		switch(cellType)
 		{
-			auto cell = tri->GetOutput()->GetCell(i);
-			if(cell->GetCellType() == VTK_TRIANGLE)
-				cells->InsertNextCell(cell);
+		case VTK_VERTEX: case VTK_POLY_VERTEX: return VERTS;
+		case VTK_LINE: case VTK_POLY_LINE: return LINES;
+		case VTK_TRIANGLE_STRIP: return STRIPS;
+		default: return POLYS;
 		}
+	};
+	std::array<vtkIdType, GROUP_COUNT> groupCells = {0, 0, 0, 0};
+	std::array<vtkIdType, GROUP_COUNT> groupSize = {0, 0, 0, 0};
+	std::vector<unsigned char> cellGroup(count);
+	vtkIdType nPoints(0);
+	vtkIdType* pts(nullptr);
+	for(vtkIdType i = 0; i < count; ++i)
+	{
+		const int cellType = polydata->GetCellType(cellIds[i]);
+		if(cellType == VTK_EMPTY_CELL)
+		{
+			cellGroup[i] = GROUP_COUNT;
+			continue;
+		}
+		polydata->GetCellPoints(cellIds[i], nPoints, pts);
+		cellGroup[i] = static_cast<unsigned char>(groupOf(cellType));
+		++groupCells[cellGroup[i]];
+		groupSize[cellGroup[i]] += nPoints + 1;
+	}
 
-		auto usg = vtkSmartPointer<vtkUnstructuredGrid>::New();
-		usg->SetPoints(points);
-		usg->SetCells(VTK_TRIANGLE, cells);
+	std::array<vtkSmartPointer<vtkIdTypeArray>, GROUP_COUNT> connectivity;
+	std::array<vtkIdType*, GROUP_COUNT> writePos = {nullptr, nullptr, nullptr, nullptr};
+	for(int g = 0; g < GROUP_COUNT; ++g)
+	{
+		if(groupCells[g] == 0)
+			continue;
+		connectivity[g] = vtkSmartPointer<vtkIdTypeArray>::New();
+		writePos[g] = connectivity[g]->WritePointer(0, groupSize[g]);
+	}
 
-		vtkSmartPointer<vtkDataSetSurfaceFilter> surfacefilter = vtkSmartPointer<vtkDataSetSurfaceFilter>::New();
-		if(points->GetNumberOfPoints() != 0 && cells->GetNumberOfCells() != 0)
+	std::vector<vtkIdType> pointMap;
+	vtkIdType numOutPoints(0);
+	if(compactPoints)
+		pointMap.assign(polydata->GetNumberOfPoints(), -1);
+
+	std::array<vtkIdType, GROUP_COUNT> groupStart = {0, groupCells[VERTS], groupCells[VERTS] + groupCells[LINES], groupCells[VERTS] + groupCells[LINES] + groupCells[POLYS]};
+	auto fromCells = vtkSmartPointer<vtkIdList>::New();
+	auto toCells = vtkSmartPointer<vtkIdList>::New();
+	fromCells->SetNumberOfIds(groupStart[STRIPS] + groupCells[STRIPS]);
+	toCells->SetNumberOfIds(fromCells->GetNumberOfIds());
+	for(vtkIdType i = 0; i < count; ++i)
+	{
+		const int g = cellGroup[i];
+		if(g == GROUP_COUNT)
+			continue;
+		polydata->GetCellPoints(cellIds[i], nPoints, pts);
+		vtkIdType*& out = writePos[g];
+		*out++ = nPoints;
+		for(vtkIdType k = 0; k < nPoints; ++k)
 		{
-			surfacefilter->SetInputData(usg);
-			surfacefilter->Update();
+			if(compactPoints)
+			{
+				if(pointMap[pts[k]] < 0)
+					pointMap[pts[k]] = numOutPoints++;
+				*out++ = pointMap[pts[k]];
+			}
+			else
+			{
+				*out++ = pts[k];
+			}
 		}
+		fromCells->SetId(groupStart[g], cellIds[i]);
+		toCells->SetId(groupStart[g], groupStart[g]);
+		++groupStart[g];
+	}
 
-		ret->ShallowCopy(surfacefilter->GetOutput());
+	if(compactPoints)
+	{
+		auto points = vtkSmartPointer<vtkPoints>::New();
+		points->SetDataType(polydata->GetPoints()->GetDataType());
+		points->SetNumberOfPoints(numOutPoints);
+		auto fromPoints = vtkSmartPointer<vtkIdList>::New();
+		auto toPoints = vtkSmartPointer<vtkIdList>::New();
+		fromPoints->SetNumberOfIds(numOutPoints);
+		toPoints->SetNumberOfIds(numOutPoints);
+		double x[3];
+		for(vtkIdType i = 0; i < static_cast<vtkIdType>(pointMap.size()); ++i)
+		{
+			if(pointMap[i] < 0)
+				continue;
+			polydata->GetPoints()->GetPoint(i, x);
+			points->SetPoint(pointMap[i], x);
+			fromPoints->SetId(pointMap[i], i);
+			toPoints->SetId(pointMap[i], pointMap[i]);
+		}
+		ret->SetPoints(points);
+		ret->GetPointData()->CopyAllocate(polydata->GetPointData(), numOutPoints);
+		ret->GetPointData()->CopyData(polydata->GetPointData(), fromPoints, toPoints);
+	}
+	else
+	{
+		ret->SetPoints(polydata->GetPoints());
+		ret->GetPointData()->PassData(polydata->GetPointData());
 	}
 
+	for(int g = 0; g < GROUP_COUNT; ++g)
+	{
+		if(groupCells[g] == 0)
+			continue;
+		auto cells = vtkSmartPointer<vtkCellArray>::New();
+		cells->SetCells(groupCells[g], connectivity[g]);
+		switch(g)
+		{
+		case VERTS: ret->SetVerts(cells); break;
+		case LINES: ret->SetLines(cells); break;
+		case POLYS: ret->SetPolys(cells); break;
+		case STRIPS: ret->SetStrips(cells); break;
+		}
+	}
+	ret->GetCellData()->CopyAllocate(polydata->GetCellData(), fromCells->GetNumberOfIds());
+	ret->GetCellData()->CopyData(polydata->GetCellData(), fromCells, toCells);
 	return ret;
 }
 
@@ -148,45 +396,47 @@ void computeNormals(vtkSmartPointer<vtkPolyData> polydata)
 	polydata->ShallowCopy(normalGenerator->GetOutput());
 }
 
+void updateNormals(vtkSmartPointer<vtkPolyData> polydata, vtkSmartPointer<vtkIdList> dirtyCells)
+{
+	// keeps the incidence of the last mesh, so that updating after every edit costs the size of the edit
+	static thread_local CMeshNormals normals;
+	if(dirtyCells)
+		normals.Update(polydata, dirtyCells);
+	else
+		normals.Compute(polydata);
+}
+
+bool saveMeshFile(const std::string& path, vtkSmartPointer<vtkPolyData> polydata, vtkSmartPointer<vtkIdList> selection)
+{
+	CMeshFileWriter writer;
+	if(!polydata || !writer.Open(path))
+		return false;
+	bool ret = writer.WritePolyData(polydata);
+	if(ret && selection)
+		ret = writer.WriteIdList("selection", selection);
+	return writer.Close() && ret;
+}
+
+vtkSmartPointer<vtkPolyData> loadMeshFile(const std::string& path, vtkSmartPointer<vtkIdList> selection)
+{
+	CMeshFileReader reader;
+	if(!reader.Open(path))
+		return nullptr;
+	if(selection)
+	{
+		selection->Reset();
+		if(auto ids = reader.ReadIdList("selection"))
+			selection->DeepCopy(ids);
+	}
+	return reader.ReadPolyData();
+}
+
 std::array<double, 3> computeSelectedCellsNormal(vtkSmartPointer<vtkPolyData> polydata, vtkSmartPointer<vtkIdList> slectRegion)
 {
-    std::array<double, 3> totalNormal{0, 0, 0};
-    for (vtkIdType i = 0; i < slectRegion->GetNumberOfIds(); i++)
-    {
-        vtkIdType cellId = slectRegion->GetId(i);
-        vtkIdType nPoints;
-        vtkIdType* pts;
-        polydata->GetCellPoints(cellId, nPoints, pts);
-        if (nPoints != 3)
-            continue;
-
-        std::array<double, 3> pointPos[3];
-        for (vtkIdType j = 0; j < nPoints; j++)
-        {
-            polydata->GetPoint(pts[j], pointPos[j].data());
-        }
-        std::array<double, 3> vec1;
-		for(std::size_t i = 0; i < vec1.size(); ++i)
-			vec1[i] = pointPos[1][i] - pointPos[0][i];
-        std::array<double, 3> vec2;
-		for(std::size_t i = 0; i < vec2.size(); ++i)
-			vec2[i] = pointPos[2][i] - pointPos[1][i];
-        std::array<double, 3> normal =
-		{
-			vec1[1]*vec2[2]-vec1[2]*vec2[1],
-			vec1[2]*vec2[0]-vec1[0]*vec2[2],
-			vec1[0]*vec2[1]-vec1[1]*vec2[0]
-		};
-        double area = vtkTriangle::TriangleArea(pointPos[0].data(), pointPos[1].data(), pointPos[2].data());
-		double length = std::sqrt(normal[0]*normal[0]+normal[1]*normal[1]+normal[2]*normal[2]);
-		if(length!=0.0)
-		{
-			for(auto& iter :normal)
-				iter = iter / length;
-		}
-		for(std::size_t i = 0; i < 3; ++i)
-			totalNormal[i] += normal[i]*area;
-    }
+	// the sum of the raw cross products has the direction of the area weighted sum of the unit normals
+	std::array<double, 3> totalNormal{0, 0, 0};
+	if(polydata && slectRegion)
+		totalNormal = CTriangleNormalKernel::CrossProductSum(polydata, slectRegion->GetPointer(0), slectRegion->GetNumberOfIds());
 
 	{
 		double length = std::sqrt(totalNormal[0]*totalNormal[0]+totalNormal[1]*totalNormal[1]+totalNormal[2]*totalNormal[2]);
@@ -199,88 +449,83 @@ std::array<double, 3> computeSelectedCellsNormal(vtkSmartPointer<vtkPolyData> po
     return totalNormal;
 }
 
-std::vector<std::array<double,3>> computeIntersectionPolygon(vtkSmartPointer<vtkPolyData> polydata, vtkSmartPointer<vtkPlane> plane)
+namespace
 {
-	std::vector<std::array<double,3>> ret;
-	auto cutter = vtkSmartPointer<vtkCutter>::New();
-	cutter->SetCutFunction(plane);
-	cutter->SetInputData(polydata);
-	cutter->Update();
+// the BVH is rebuilt only when the polydata, its points or its polys change, so repeated region analyses of one mesh reuse it
+CThicknessAnalyzer& cachedThicknessAnalyzer()
+{
+	static thread_local CThicknessAnalyzer analyzer;
+	return analyzer;
+}
+}
 
-	auto intersectionData = vtkSmartPointer<vtkPolyData>::New();
-	intersectionData->ShallowCopy(cutter->GetOutput());
+bool computeWallThickness(vtkSmartPointer<vtkPolyData> polydata, vtkSmartPointer<vtkIdList> slectRegion, bool perCell)
+{
+	CThicknessAnalyzer& analyzer = cachedThicknessAnalyzer();
+	analyzer.SetMode(perCell ? CThicknessAnalyzer::Mode::Cells : CThicknessAnalyzer::Mode::Points);
+	return analyzer.Analyze(polydata, slectRegion);
+}
 
-	cleanPolydata(intersectionData);
+void releaseWallThickness()
+{
+	cachedThicknessAnalyzer().Clear();
+}
 
-	if(intersectionData->GetNumberOfPoints() > 0)
-	{
-		std::map<vtkIdType, vtkIdType> mpLine;
-		for(vtkIdType i = 0; i < intersectionData->GetNumberOfCells(); ++i)
-		{
-			auto cell = intersectionData->GetCell(i);
-			if(!mpLine.count(cell->GetPointId(0)))
-				mpLine.insert(std::make_pair(cell->GetPointId(0), cell->GetPointId(1)));
-			else
-				mpLine.insert(std::make_pair(cell->GetPointId(1), cell->GetPointId(0)));
-		}
-		std::vector<vtkIdType> vertexs;
-		vertexs.reserve(intersectionData->GetNumberOfPoints());
-		vtkIdType firstVertex(mpLine.cbegin()->first), nextVertex(mpLine.cbegin()->first);
-		do
-		{
-			vertexs.push_back(nextVertex);
-			nextVertex = mpLine[nextVertex];
-		} while(firstVertex != nextVertex);
+std::vector<CMeshSlicer::Layer> computeIntersectionLayers(vtkSmartPointer<vtkPolyData> polydata, const std::array<double, 3>& normal, const std::vector<double>& offsets)
+{
+	CMeshSlicer slicer;
+	return slicer.Slice(polydata, normal, offsets);
+}
 
-		std::array<double,3> xyz = {0.0};
-		for(auto id : vertexs)
-		{
-			intersectionData->GetPoint(id, xyz.data());
-			ret.push_back(xyz);
-		}
-	}
-	return ret;
+std::vector<CMeshSlicer::Contour> computeIntersectionContours(vtkSmartPointer<vtkPolyData> polydata, vtkSmartPointer<vtkPlane> plane)
+{
+	std::array<double, 3> normal, origin;
+	plane->GetNormal(normal.data());
+	plane->GetOrigin(origin.data());
+	const double length = std::sqrt(normal[0]*normal[0] + normal[1]*normal[1] + normal[2]*normal[2]);
+	if(length == 0.0)
+		return std::vector<CMeshSlicer::Contour>();
+	const double offset = (normal[0]*origin[0] + normal[1]*origin[1] + normal[2]*origin[2]) / length;
+
+	auto layers = computeIntersectionLayers(polydata, normal, {offset});
+	return std::move(layers.front().contours);
 }
 
-std::vector<std::array<double,3>> polygonPoints(vtkSmartPointer<vtkPolyData> polydata)
+std::vector<std::array<double,3>> computeIntersectionPolygon(vtkSmartPointer<vtkPolyData> polydata, vtkSmartPointer<vtkPlane> plane)
 {
-	std::vector<std::array<double,3>> ret;
-	vtkSmartPointer<vtkPolyData> pd = vtkSmartPointer<vtkPolyData>::New();
-	pd->DeepCopy(polydata);
-	cleanPolydata(pd);
+	auto contours = computeIntersectionContours(polydata, plane);
+	auto largest = CContourChainer::LargestContour(contours);
+	return largest ? largest->points : std::vector<std::array<double,3>>();
+}
 
-	if(pd->GetNumberOfPoints() > 0)
+std::vector<CContourChainer::Contour> polygonContours(vtkSmartPointer<vtkPolyData> polydata)
+{
+	CContourChainer chainer;
+	if(polydata && polydata->GetLines())
 	{
-		std::map<vtkIdType, vtkIdType> mpLine;
-		for(vtkIdType i = 0; i < pd->GetNumberOfCells(); ++i)
-		{
-			auto cell = pd->GetCell(i);
-			if(!mpLine.count(cell->GetPointId(0)))
-				mpLine.insert(std::make_pair(cell->GetPointId(0), cell->GetPointId(1)));
-			else
-				mpLine.insert(std::make_pair(cell->GetPointId(1), cell->GetPointId(0)));
-		}
-		std::vector<vtkIdType> vertexs;
-		vertexs.reserve(pd->GetNumberOfPoints());
-		vtkIdType firstVertex(mpLine.cbegin()->first), nextVertex(mpLine.cbegin()->first);
-		do
+		auto lines = polydata->GetLines();
+		chainer.Reserve(lines->GetNumberOfConnectivityEntries());
+		std::array<double,3> a, b;
+		vtkIdType nPoints(0);
+		vtkIdType* pts(nullptr);
+		for(lines->InitTraversal(); lines->GetNextCell(nPoints, pts);)
 		{
-			vertexs.push_back(nextVertex);
-			auto itpos = mpLine.find(nextVertex);
-			if(itpos != mpLine.end())
-				nextVertex = itpos->second;
-			else
-				break;
-		} while(firstVertex != nextVertex);
-
-		std::array<double,3> xyz = {0.0};
-		for(auto id : vertexs)
-		{
-			pd->GetPoint(id, xyz.data());
-			ret.push_back(xyz);
+			for(vtkIdType k = 0; k + 1 < nPoints; ++k)
+			{
+				polydata->GetPoint(pts[k], a.data());
+				polydata->GetPoint(pts[k+1], b.data());
+				chainer.AddSegment(a, b);
+			}
 		}
 	}
-	return ret;
+	return chainer.Chain();
+}
+
+std::vector<std::array<double,3>> polygonPoints(vtkSmartPointer<vtkPolyData> polydata)
+{
+	auto contours = polygonContours(polydata);
+	auto largest = CContourChainer::LargestContour(contours);
+	return largest ? largest->points : std::vector<std::array<double,3>>();
 }
 
 void printPolygon(std::ostream& os, vtkSmartPointer<vtkPolyData> polydata)
@@ -302,9 +547,8 @@ vtkSmartPointer<vtkPolyData> createCylinderData(const std::array<double, 3>& pt1
 	tube->SetRadius(radius);
 	tube->Update();
 
-	auto cylinderPd = vtkSmartPointer<vtkPolyData>::New();
-	cylinderPd->DeepCopy(tube->GetOutput());
-	return cylinderPd;
+	// the output outlives the filter through the returned reference
+	return tube->GetOutput();
 }
 
 vtkSmartPointer<vtkPolyData> createPolyLineData(std::vector<std::array<double, 3>>& points)
@@ -329,30 +573,34 @@ vtkSmartPointer<vtkPolyData> createPolyLineData(std::vector<std::array<double, 3
 
 vtkSmartPointer<vtkPolyData> createMultiPointsData(std::vector<std::array<double, 3>>& points, float radius)
 {
-    vtkSmartPointer<vtkFloatArray> scales = vtkSmartPointer<vtkFloatArray>::New();
-    scales->SetName("scales");
+	// merged geometry of every sphere, CCenterMarkerLayer draws the same markers instanced without building it
+	const vtkIdType count = static_cast<vtkIdType>(points.size());
+	vtkSmartPointer<vtkFloatArray> scales = vtkSmartPointer<vtkFloatArray>::New();
+	scales->SetName("scales");
+	scales->SetNumberOfValues(count);
 
 	auto vtkpoints = vtkSmartPointer<vtkPoints>::New();
-	for(const auto& iter : points)
+	vtkpoints->SetNumberOfPoints(count);
+	for(vtkIdType i = 0; i < count; ++i)
 	{
-		vtkpoints->InsertNextPoint(iter.data());
-		scales->InsertNextValue(radius);
+		vtkpoints->SetPoint(i, points[i].data());
+		scales->SetValue(i, radius);
 	}
 
-	vtkSmartPointer<vtkUnstructuredGrid> grid = vtkSmartPointer<vtkUnstructuredGrid>::New();
-	grid->SetPoints(vtkpoints);
-	grid->GetPointData()->AddArray(scales);    
-    grid->GetPointData()->SetActiveScalars("scales"); // !!!to set radius first
+	auto centers = vtkSmartPointer<vtkPolyData>::New();
+	centers->SetPoints(vtkpoints);
+	centers->GetPointData()->AddArray(scales);
+	centers->GetPointData()->SetActiveScalars("scales"); // !!!to set radius first
 
 	vtkSmartPointer<vtkSphereSource> sphereSource = vtkSmartPointer<vtkSphereSource>::New();
 
 	vtkSmartPointer<vtkGlyph3D> glyph3D = vtkSmartPointer<vtkGlyph3D>::New();
-	glyph3D->SetInputData(grid);
-    glyph3D->SetSourceConnection(sphereSource->GetOutputPort());
+	glyph3D->SetInputData(centers);
+	glyph3D->SetSourceConnection(sphereSource->GetOutputPort());
 	glyph3D->Update();
 
-	auto ret = vtkSmartPointer<vtkPolyData>::New();
-	ret->DeepCopy(glyph3D->GetOutput());
+	// the output outlives the filter, no copy needed
+	vtkSmartPointer<vtkPolyData> ret = glyph3D->GetOutput();
 	return ret;
 }
 
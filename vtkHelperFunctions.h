@@ -2,7 +2,10 @@
 
 #include <vector>
 #include <array>
+#include <string>
 #include <vtkSmartPointer.h>
+#include "CMeshSlicer.h"
+#include "CMeshTopology.h"
 
 class vtkPolyData;
 class vtkIdList;
@@ -10,13 +13,33 @@ class vtkPlane;
 
 void printPolydataInformation(std::ostream& os, vtkSmartPointer<vtkPolyData> polydata);
 void printPolydataDetail(std::ostream& os, vtkSmartPointer<vtkPolyData> polydata);
+// binary dump of the mesh, its attributes and an optional selection that loadMeshFile reads back through a memory mapping, see CMeshFile
+bool saveMeshFile(const std::string& path, vtkSmartPointer<vtkPolyData> polydata, vtkSmartPointer<vtkIdList> selection = nullptr);
+vtkSmartPointer<vtkPolyData> loadMeshFile(const std::string& path, vtkSmartPointer<vtkIdList> selection = nullptr);
 void printPolygon(std::ostream& os, vtkSmartPointer<vtkPolyData> polydata);
 void cleanPolydata(vtkSmartPointer<vtkPolyData> polydata);
 bool isManifold(vtkSmartPointer<vtkPolyData> polydata);
-vtkSmartPointer<vtkPolyData> rebuildPolyData(vtkSmartPointer<vtkPolyData> polydata);
+// full report of isManifold, cached against the polydata MTime, see CMeshTopology
+CMeshTopology::Report meshTopology(vtkSmartPointer<vtkPolyData> polydata);
+// the triangles of polydata on their used points only, attributes are not copied
+vtkSmartPointer<vtkPolyData> rebuildPolyData(vtkSmartPointer<vtkPolyData> polydata, bool parallel = true);
+vtkSmartPointer<vtkPolyData> extractCellsPolyData(vtkSmartPointer<vtkPolyData> polydata, vtkSmartPointer<vtkIdList> cellIds, bool compactPoints = false);
+vtkSmartPointer<vtkPolyData> extractCellsPolyData(vtkPolyData* polydata, const vtkIdType* cellIds, vtkIdType count, bool compactPoints = false);
 void computeNormals(vtkSmartPointer<vtkPolyData> polydata);
+// normals in place without changing the topology, only around dirtyCells when given, see CMeshNormals
+void updateNormals(vtkSmartPointer<vtkPolyData> polydata, vtkSmartPointer<vtkIdList> dirtyCells = nullptr);
 
 std::array<double, 3> computeSelectedCellsNormal(vtkSmartPointer<vtkPolyData> polydata, vtkSmartPointer<vtkIdList> slectRegion);
+// "Thickness" point (or cell) array, distance along the inward normal to the opposite wall, see CThicknessAnalyzer
+// the BVH of the last mesh is kept per thread and reused while its points and polys are unchanged
+bool computeWallThickness(vtkSmartPointer<vtkPolyData> polydata, vtkSmartPointer<vtkIdList> slectRegion = nullptr, bool perCell = false);
+// frees the BVH kept by computeWallThickness on this thread, with its reference to the mesh
+void releaseWallThickness();
+// contours of the planes at the distances offsets along the unit normal in one pass, see CMeshSlicer
+std::vector<CMeshSlicer::Layer> computeIntersectionLayers(vtkSmartPointer<vtkPolyData> polydata, const std::array<double, 3>& normal, const std::vector<double>& offsets);
+// every loop and open polyline of the cut or of the lines, the legacy functions below return the largest loop of them
+std::vector<CContourChainer::Contour> computeIntersectionContours(vtkSmartPointer<vtkPolyData> polydata, vtkSmartPointer<vtkPlane> plane);
+std::vector<CContourChainer::Contour> polygonContours(vtkSmartPointer<vtkPolyData> polydata);
 std::vector<std::array<double,3>> computeIntersectionPolygon(vtkSmartPointer<vtkPolyData> polydata, vtkSmartPointer<vtkPlane> plane);
 std::vector<std::array<double,3>> polygonPoints(vtkSmartPointer<vtkPolyData> polydata);
 vtkSmartPointer<vtkPolyData> createCylinderData(const std::array<double, 3>& pt1, const std::array<double, 3>& pt2, float radius);
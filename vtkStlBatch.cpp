@@ -0,0 +1,479 @@
+// Headless batch processing of STL files, no Qt needed.
+// The files of a directory (or listed in a manifest, one path per line) are processed concurrently by a bounded
+// pool of worker threads, every file runs the same job and the results are written as JSON in input order.
+// The meshes in flight are capped by count and by the summed size of their STL files, a worker waits for room
+// before loading, so the peak memory stays proportional to the caps and not to the number of files.
+//
+// usage: vtkStlBatch <directory|manifest> --job job.txt [--threads 4] [--max-meshes 2] [--max-megabytes 2048]
+//        [--cache] [--serial] [--output result.json]
+//
+// job file, one operation per line, '#' starts a comment:
+//   weld <tolerance> [absolute]       CMeshWelder after the exact weld of the reader, relative to the diagonal by default
+//   manifold                          CMeshTopology report
+//   slices <nx> <ny> <nz> <count>     count planes evenly spaced across the bounds along the normal, CMeshSlicer
+//   select <x> <y> <z> <radius>       appended to the selected region, vtkAppendableSelection
+//   normal                            area weighted normal of the selected region
+#include "CMeshCache.h"
+#include "CMeshSlicer.h"
+#include "CMeshTopology.h"
+#include "CMeshWelder.h"
+#include "CPointGridIndex.h"
+#include "CStlReader.h"
+#include "vtkAppendableSelection.h"
+#include "vtkHelperFunctions.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+#include <vtkIdList.h>
+
+namespace
+{
+struct BatchOptions
+{
+	std::string input;
+	std::string job;
+	int threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+	int maxMeshes = 2;
+	std::uint64_t maxBytes = std::uint64_t(2048) << 20;//of STL files in flight
+	bool cache = false;
+	bool parallel = true;
+	std::string output;
+};
+
+struct Job
+{
+	bool weld = false;
+	double weldTolerance = 0.0;
+	bool weldToleranceIsAbsolute = false;
+	bool manifold = false;
+	std::array<double, 3> sliceNormal = {0.0, 0.0, 1.0};
+	int sliceCount = 0;
+	std::vector<std::array<double, 4>> selections;//center and radius
+	bool normal = false;
+};
+
+bool ParseArguments(int argc, char* argv[], BatchOptions& options)
+{
+	for(int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+		if(arg == "--job" && hasValue)
+			options.job = argv[++i];
+		else if(arg == "--threads" && hasValue)
+			options.threads = std::max(1, std::stoi(argv[++i]));
+		else if(arg == "--max-meshes" && hasValue)
+			options.maxMeshes = std::max(1, std::stoi(argv[++i]));
+		else if(arg == "--max-megabytes" && hasValue)
+			options.maxBytes = std::uint64_t(std::max(1LL, std::stoll(argv[++i]))) << 20;
+		else if(arg == "--cache")
+			options.cache = true;
+		else if(arg == "--serial")
+			options.parallel = false;
+		else if(arg == "--output" && hasValue)
+			options.output = argv[++i];
+		else if(options.input.empty() && arg.compare(0, 2, "--") != 0)
+			options.input = arg;
+		else
+		{
+			std::cerr << "unknown argument " << arg << std::endl;
+			return false;
+		}
+	}
+	return !options.input.empty() && !options.job.empty();
+}
+
+bool ParseOptions(int argc, char* argv[], BatchOptions& options)
+{
+	// std::stoi and std::stoll throw on a value that is not a number or out of range
+	try
+	{
+		return ParseArguments(argc, argv, options);
+	}
+	catch(const std::exception&)
+	{
+		std::cerr << "invalid number in the arguments" << std::endl;
+		return false;
+	}
+}
+
+bool ParseJob(const std::string& path, Job& job)
+{
+	std::ifstream file(path);
+	if(!file)
+	{
+		std::cerr << "cannot read " << path << std::endl;
+		return false;
+	}
+	std::string line;
+	for(int lineNumber = 1; std::getline(file, line); ++lineNumber)
+	{
+		line = line.substr(0, line.find('#'));
+		std::istringstream ss(line);
+		std::string operation;
+		if(!(ss >> operation))
+			continue;
+		bool ok(true);
+		if(operation == "weld")
+		{
+			std::string absolute;
+			job.weld = true;
+			ok = static_cast<bool>(ss >> job.weldTolerance);
+			job.weldToleranceIsAbsolute = (ss >> absolute) && absolute == "absolute";
+		}
+		else if(operation == "manifold")
+			job.manifold = true;
+		else if(operation == "slices")
+		{
+			// CMeshSlicer measures the offsets along the unit normal, so do the bounds below
+			ok = static_cast<bool>(ss >> job.sliceNormal[0] >> job.sliceNormal[1] >> job.sliceNormal[2] >> job.sliceCount) && job.sliceCount >= 0;
+			const double length = std::sqrt(job.sliceNormal[0]*job.sliceNormal[0] + job.sliceNormal[1]*job.sliceNormal[1] + job.sliceNormal[2]*job.sliceNormal[2]);
+			ok = ok && length > 0.0 && std::isfinite(length);
+			for(int i = 0; ok && i < 3; ++i)
+				job.sliceNormal[i] /= length;
+		}
+		else if(operation == "select")
+		{
+			std::array<double, 4> selection;
+			ok = static_cast<bool>(ss >> selection[0] >> selection[1] >> selection[2] >> selection[3]) && selection[3] > 0.0;
+			job.selections.push_back(selection);
+		}
+		else if(operation == "normal")
+			job.normal = true;
+		else
+			ok = false;
+		if(!ok)
+		{
+			std::cerr << path << ":" << lineNumber << ": invalid operation " << line << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool IsStlFile(const std::filesystem::path& path)
+{
+	std::string extension = path.extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	return extension == ".stl";
+}
+
+// the STL files of a directory sorted by name, or the lines of a manifest relative to its directory
+std::vector<std::string> CollectFiles(const std::string& input)
+{
+	std::vector<std::string> ret;
+	std::error_code error;
+	if(std::filesystem::is_directory(input, error))
+	{
+		for(const auto& entry : std::filesystem::directory_iterator(input, error))
+		{
+			if(entry.is_regular_file(error) && IsStlFile(entry.path()))
+				ret.push_back(entry.path().string());
+		}
+		std::sort(ret.begin(), ret.end());
+		return ret;
+	}
+	std::ifstream manifest(input);
+	const std::filesystem::path base = std::filesystem::path(input).parent_path();
+	std::string line;
+	while(std::getline(manifest, line))
+	{
+		line.erase(line.find_last_not_of(" \t\r") + 1);
+		line.erase(0, line.find_first_not_of(" \t"));
+		if(line.empty() || line[0] == '#')
+			continue;
+		const std::filesystem::path path(line);
+		ret.push_back(path.is_absolute() ? path.string() : (base / path).string());
+	}
+	return ret;
+}
+
+// counting gate on the meshes in flight and on their STL bytes, a mesh larger than the budget is admitted alone
+class InFlightGate
+{
+public:
+	InFlightGate(int maxMeshes, std::uint64_t maxBytes)
+		: m_maxMeshes(maxMeshes)
+		, m_maxBytes(maxBytes)
+		, m_meshes(0)
+		, m_bytes(0)
+	{
+	}
+
+	void Acquire(std::uint64_t bytes)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_condition.wait(lock, [&]() { return m_meshes == 0 || (m_meshes < m_maxMeshes && m_bytes + bytes <= m_maxBytes); });
+		++m_meshes;
+		m_bytes += bytes;
+	}
+
+	void Release(std::uint64_t bytes)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			--m_meshes;
+			m_bytes -= bytes;
+		}
+		m_condition.notify_all();
+	}
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	const int m_maxMeshes;
+	const std::uint64_t m_maxBytes;
+	int m_meshes;
+	std::uint64_t m_bytes;
+};
+
+std::string JsonString(const std::string& text)
+{
+	std::ostringstream ss;
+	ss << "\"";
+	for(const char c : text)
+	{
+		if(c == '"' || c == '\\')
+			ss << '\\' << c;
+		else if(static_cast<unsigned char>(c) < 0x20)
+			ss << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec;
+		else
+			ss << c;
+	}
+	ss << "\"";
+	return ss.str();
+}
+
+double Seconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// runs job on one file into its JSON object, false when the file could not be read
+bool ProcessFile(const std::string& path, const Job& job, const BatchOptions& options, std::string& result)
+{
+	const auto startTime = std::chrono::steady_clock::now();
+	std::ostringstream json;
+	json << std::setprecision(9);
+	json << "    {\"file\": " << JsonString(path);
+
+	CStlReader reader;
+	reader.SetParallel(options.parallel);
+	CPointGridIndex index;
+	vtkSmartPointer<vtkPolyData> mesh;
+	std::string errorMessage;
+	bool cacheHit(false);
+	if(options.cache)
+	{
+		CMeshCache cache;
+		mesh = cache.Load(path, reader, job.selections.empty() ? nullptr : &index);
+		errorMessage = cache.ErrorMessage();
+		cacheHit = cache.WasCacheHit();
+	}
+	else
+	{
+		mesh = reader.Read(path);
+		errorMessage = reader.ErrorMessage();
+	}
+	if(!mesh)
+	{
+		json << ", \"ok\": false, \"error\": " << JsonString(errorMessage) << ", \"seconds\": " << Seconds(startTime) << "}";
+		result = json.str();
+		return false;
+	}
+	json << ", \"ok\": true, \"cache_hit\": " << (cacheHit ? "true" : "false")
+		<< ", \"load_seconds\": " << Seconds(startTime);
+
+	if(job.weld)
+	{
+		CMeshWelder welder;
+		welder.SetTolerance(job.weldTolerance);
+		welder.SetToleranceIsAbsolute(job.weldToleranceIsAbsolute);
+		welder.SetParallel(options.parallel);
+		auto welded = welder.Weld(mesh);
+		if(welded)
+		{
+			mesh = welded;
+			index.Clear();//over the points before the weld
+		}
+		json << ",\n     \"weld\": {\"duplicates\": " << welder.DuplicateCount() << ", \"degenerates\": " << welder.DegenerateCount()
+			<< ", \"seconds\": " << welder.WeldTime() << "}";
+	}
+	json << ",\n     \"points\": " << mesh->GetNumberOfPoints() << ", \"triangles\": " << mesh->GetNumberOfPolys();
+
+	if(job.manifold)
+	{
+		CMeshTopology topology;
+		topology.SetParallel(options.parallel);
+		const auto& report = topology.Analyze(mesh);
+		json << ",\n     \"topology\": {\"manifold\": " << (report.IsManifold() ? "true" : "false")
+			<< ", \"closed\": " << (report.IsClosed() ? "true" : "false")
+			<< ", \"edges\": " << report.numEdges
+			<< ", \"boundary_edges\": " << report.numBoundaryEdges
+			<< ", \"boundary_loops\": " << report.numBoundaryLoops
+			<< ", \"inconsistent_edges\": " << report.numInconsistentEdges
+			<< ", \"non_manifold_edges\": " << report.nonManifoldEdges.size()
+			<< ", \"non_manifold_points\": " << report.nonManifoldPoints.size()
+			<< ", \"components\": " << report.numComponents
+			<< ", \"genus\": " << report.genus
+			<< ", \"seconds\": " << topology.AnalysisTime() << "}";
+	}
+
+	if(job.sliceCount > 0)
+	{
+		// offsets strictly inside the extent of the bounds along the normal
+		double bounds[6];
+		mesh->GetBounds(bounds);
+		double lower(0.0), upper(0.0);
+		for(int i = 0; i < 3; ++i)
+		{
+			lower += job.sliceNormal[i] * (job.sliceNormal[i] >= 0.0 ? bounds[2*i] : bounds[2*i+1]);
+			upper += job.sliceNormal[i] * (job.sliceNormal[i] >= 0.0 ? bounds[2*i+1] : bounds[2*i]);
+		}
+		std::vector<double> offsets(job.sliceCount);
+		for(int i = 0; i < job.sliceCount; ++i)
+			offsets[i] = lower + (upper - lower) * (i + 0.5) / job.sliceCount;
+		CMeshSlicer slicer;
+		const auto layers = slicer.Slice(mesh, job.sliceNormal, offsets, options.parallel);
+		json << ",\n     \"slices\": {\"seconds\": " << slicer.SliceTime() << ", \"layers\": [";
+		for(std::size_t l = 0; l < layers.size(); ++l)
+		{
+			std::size_t closed(0);
+			double area(0.0);
+			for(const auto& contour : layers[l].contours)
+			{
+				closed += contour.closed ? 1 : 0;
+				area += contour.hole ? -contour.area : contour.area;
+			}
+			json << (l == 0 ? "" : ", ") << "{\"offset\": " << layers[l].offset << ", \"contours\": " << layers[l].contours.size()
+				<< ", \"closed\": " << closed << ", \"area\": " << area << "}";
+		}
+		json << "]}";
+	}
+
+	if(!job.selections.empty() || job.normal)
+	{
+		auto regionIds = vtkSmartPointer<vtkIdList>::New();
+		double selectionSeconds(0.0);
+		if(!job.selections.empty())
+		{
+			const auto selectionStart = std::chrono::steady_clock::now();
+			auto selection = vtkSmartPointer<vtkAppendableSelection>::New();
+			selection->SetInputData(mesh);
+			selection->SetParallelSelection(options.parallel);
+			if(index.IsBuilt())
+				selection->AdoptPointIndex(std::move(index));
+			for(const auto& request : job.selections)
+			{
+				selection->AppendSelection({request[0], request[1], request[2]}, request[3]);
+				selection->Update();
+			}
+			regionIds->DeepCopy(selection->GetAppliedRegionIds());
+			selectionSeconds = Seconds(selectionStart);
+		}
+		json << ",\n     \"selection\": {\"requests\": " << job.selections.size() << ", \"cells\": " << regionIds->GetNumberOfIds()
+			<< ", \"seconds\": " << selectionSeconds;
+		if(job.normal)
+		{
+			const auto normal = computeSelectedCellsNormal(mesh, regionIds);
+			json << ", \"normal\": [" << normal[0] << ", " << normal[1] << ", " << normal[2] << "]";
+		}
+		json << "}";
+	}
+
+	json << ",\n     \"seconds\": " << Seconds(startTime) << "}";
+	result = json.str();
+	return true;
+}
+}
+
+int main(int argc, char* argv[])
+{
+	BatchOptions options;
+	Job job;
+	if(!ParseOptions(argc, argv, options))
+	{
+		std::cerr << "usage: vtkStlBatch <directory|manifest> --job file [--threads n] [--max-meshes n] [--max-megabytes n] [--cache] [--serial] [--output file]" << std::endl;
+		return 1;
+	}
+	if(!ParseJob(options.job, job))
+		return 1;
+	const std::vector<std::string> files = CollectFiles(options.input);
+	if(files.empty())
+	{
+		std::cerr << "no STL file in " << options.input << std::endl;
+		return 1;
+	}
+
+	const auto startTime = std::chrono::steady_clock::now();
+	std::vector<std::string> results(files.size());
+	std::atomic<std::size_t> nextFile(0);
+	std::atomic<std::size_t> failed(0);
+	InFlightGate gate(options.maxMeshes, options.maxBytes);
+	std::mutex logMutex;
+	auto worker = [&]()
+	{
+		for(std::size_t f = nextFile++; f < files.size(); f = nextFile++)
+		{
+			std::error_code error;
+			const std::uint64_t bytes = std::filesystem::file_size(files[f], error);
+			gate.Acquire(error ? 0 : bytes);
+			const bool ok = ProcessFile(files[f], job, options, results[f]);
+			gate.Release(error ? 0 : bytes);
+			failed += ok ? 0 : 1;
+			std::lock_guard<std::mutex> lock(logMutex);
+			std::cerr << (ok ? "done " : "failed ") << files[f] << std::endl;
+		}
+	};
+	const int numThreads = std::min<int>(options.threads, static_cast<int>(files.size()));
+	std::vector<std::thread> pool;
+	for(int t = 0; t < numThreads; ++t)
+		pool.emplace_back(worker);
+	for(auto& thread : pool)
+		thread.join();
+
+	std::ostringstream json;
+	json << std::setprecision(9);
+	json << "{\n  \"batch\": \"vtkStlBatch\",\n  \"unit\": \"seconds\",\n  \"threads\": " << numThreads
+		<< ",\n  \"max_meshes\": " << options.maxMeshes << ",\n  \"max_bytes\": " << options.maxBytes
+		<< ",\n  \"files\": " << files.size() << ",\n  \"failed\": " << failed.load()
+		<< ",\n  \"seconds\": " << Seconds(startTime) << ",\n  \"results\": [";
+	for(std::size_t f = 0; f < results.size(); ++f)
+		json << (f == 0 ? "\n" : ",\n") << results[f];
+	json << "\n  ]\n}\n";
+
+	if(options.output.empty())
+	{
+		std::cout << json.str();
+	}
+	else
+	{
+		std::ofstream file(options.output);
+		if(!file)
+		{
+			std::cerr << "cannot write " << options.output << std::endl;
+			return 1;
+		}
+		file << json.str();
+	}
+	return failed == 0 ? 0 : 2;
+}